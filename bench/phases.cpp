@@ -0,0 +1,257 @@
+// Times each phase of the vectorizer on synthetic IR of growing size, so that
+// a phase that stops scaling shows up as a bent curve. Every iteration parses
+// a fresh module and runs the earlier phases untimed; only the phase under
+// test is measured.
+
+#include "predicatedSSA.h"
+#include "scheduler.h"
+#include "slpVectorizer.h"
+#include "benchmark/benchmark.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include <functional>
+#include <string>
+
+using namespace llvm;
+
+namespace
+{
+
+// n independent c[i] = a[i] + b[i] statements in one block, with the arrays
+// passed as `noalias` arguments or as plain pointers that may alias.
+std::string straightLine(unsigned n, const char *qualifier)
+{
+    std::string ir;
+    raw_string_ostream os(ir);
+    os << "define void @f(float*" << qualifier << " %a, float*" << qualifier << " %b, float*" << qualifier
+       << " %c) {\n"
+       << "entry:\n";
+    for (unsigned i = 0; i < n; i++)
+    {
+        os << "  %pa" << i << " = getelementptr inbounds float, float* %a, i64 " << i << "\n"
+           << "  %la" << i << " = load float, float* %pa" << i << "\n"
+           << "  %pb" << i << " = getelementptr inbounds float, float* %b, i64 " << i << "\n"
+           << "  %lb" << i << " = load float, float* %pb" << i << "\n"
+           << "  %s" << i << " = fadd float %la" << i << ", %lb" << i << "\n"
+           << "  %pc" << i << " = getelementptr inbounds float, float* %c, i64 " << i << "\n"
+           << "  store float %s" << i << ", float* %pc" << i << "\n";
+    }
+    os << "  ret void\n}\n";
+    return os.str();
+}
+
+std::string straightLineNoAlias(unsigned n)
+{
+    return straightLine(n, " noalias");
+}
+
+std::string straightLineMayAlias(unsigned n)
+{
+    return straightLine(n, "");
+}
+
+// n perfectly nested counted loops; the innermost body reads, adds every
+// induction variable and writes back.
+std::string loopNest(unsigned n)
+{
+    std::string ir;
+    raw_string_ostream os(ir);
+    os << "define void @f(i32* noalias %a) {\n"
+       << "entry:\n"
+       << "  br label %h0\n";
+    for (unsigned k = 0; k < n; k++)
+    {
+        os << "h" << k << ":\n"
+           << "  %i" << k << " = phi i32 [ 0, %" << (k ? "h" + std::to_string(k - 1) : std::string("entry"))
+           << " ], [ %i" << k << ".next, %latch" << k << " ]\n";
+        if (k + 1 < n)
+            os << "  br label %h" << k + 1 << "\n";
+    }
+    unsigned inner = n - 1;
+    os << "  %p = getelementptr inbounds i32, i32* %a, i32 %i" << inner << "\n"
+       << "  %v = load i32, i32* %p\n";
+    for (unsigned k = 0; k < n; k++)
+        os << "  %v" << k << " = add i32 %v, %i" << k << "\n";
+    os << "  store i32 %v" << inner << ", i32* %p\n"
+       << "  br label %latch" << inner << "\n";
+    for (unsigned k = n; k-- > 0;)
+    {
+        os << "latch" << k << ":\n"
+           << "  %i" << k << ".next = add i32 %i" << k << ", 1\n"
+           << "  %c" << k << " = icmp slt i32 %i" << k << ".next, 2\n"
+           << "  br i1 %c" << k << ", label %h" << k << ", label %exit" << k << "\n"
+           << "exit" << k << ":\n";
+        if (k)
+            os << "  br label %latch" << k - 1 << "\n";
+        else
+            os << "  ret void\n";
+    }
+    os << "}\n";
+    return os.str();
+}
+
+// A chain of n if/else diamonds, each merging its two arms with a phi.
+std::string diamonds(unsigned n)
+{
+    std::string ir;
+    raw_string_ostream os(ir);
+    os << "define i32 @f(i32 %x) {\n"
+       << "entry:\n"
+       << "  br label %b0\n";
+    for (unsigned i = 0; i < n; i++)
+    {
+        std::string in = i ? "%m" + std::to_string(i - 1) : "%x";
+        os << "b" << i << ":\n"
+           << "  %c" << i << " = icmp sgt i32 " << in << ", " << i % 7 << "\n"
+           << "  br i1 %c" << i << ", label %t" << i << ", label %e" << i << "\n"
+           << "t" << i << ":\n"
+           << "  %a" << i << " = add i32 " << in << ", 3\n"
+           << "  br label %j" << i << "\n"
+           << "e" << i << ":\n"
+           << "  %s" << i << " = sub i32 " << in << ", 1\n"
+           << "  br label %j" << i << "\n"
+           << "j" << i << ":\n"
+           << "  %m" << i << " = phi i32 [ %a" << i << ", %t" << i << " ], [ %s" << i << ", %e" << i << " ]\n"
+           << "  br label %b" << i + 1 << "\n";
+    }
+    os << "b" << n << ":\n"
+       << "  ret i32 %m" << n - 1 << "\n}\n";
+    return os.str();
+}
+
+// n nested ifs: block k runs under the conjunction of k conditions, and the
+// final join has a gate for every level.
+std::string predicates(unsigned n)
+{
+    std::string ir;
+    raw_string_ostream os(ir);
+    os << "define i32 @f(i32 %x) {\n"
+       << "entry:\n"
+       << "  br label %n0\n";
+    for (unsigned k = 0; k < n; k++)
+    {
+        os << "n" << k << ":\n"
+           << "  %v" << k << " = mul i32 %x, " << k + 2 << "\n"
+           << "  %c" << k << " = icmp sgt i32 %v" << k << ", " << k << "\n"
+           << "  br i1 %c" << k << ", label %n" << k + 1 << ", label %join\n";
+    }
+    os << "n" << n << ":\n"
+       << "  br label %join\n"
+       << "join:\n"
+       << "  %r = phi i32 ";
+    for (unsigned k = 0; k < n; k++)
+        os << "[ %v" << k << ", %n" << k << " ], ";
+    os << "[ 0, %n" << n << " ]\n"
+       << "  ret i32 %r\n}\n";
+    return os.str();
+}
+
+enum Phase
+{
+    Convert,
+    Schedule,
+    Pack,
+    Lower
+};
+
+const int LaneWidth = 4;
+
+void runPhases(benchmark::State &state, const std::function<std::string(unsigned)> &generate, Phase phase)
+{
+    unsigned n = state.range(0);
+    std::string ir = generate(n);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        LLVMContext context;
+        SMDiagnostic diagnostic;
+        auto module = parseAssemblyString(ir, diagnostic, context);
+        if (!module)
+        {
+            state.SkipWithError(diagnostic.getMessage().str().c_str());
+            break;
+        }
+        Function &F = *module->getFunction("f");
+
+        // Each phase runs timed when it is the one under test, untimed when
+        // a later phase needs its result.
+        auto timed = [&](Phase current, auto &&run) {
+            if (current == phase)
+                state.ResumeTiming();
+            run();
+            if (current == phase)
+                state.PauseTiming();
+        };
+
+        SSAFunction *function = nullptr;
+        PackSet packs;
+        timed(Convert, [&] { function = convertToPredicatedSSA(F); });
+        if (phase >= Schedule)
+            timed(Schedule, [&] { schedulePredicatedSSA(*function); });
+        if (phase >= Pack)
+            timed(Pack, [&] { packs = SLPPacker().packInstructions(*function, LaneWidth); });
+        if (phase >= Lower)
+            timed(Lower, [&] { lowerToIR(function, F, packs); });
+
+        module.reset();
+        state.ResumeTiming();
+    }
+    state.SetComplexityN(n);
+}
+
+struct Shape
+{
+    const char *name;
+    std::string (*generate)(unsigned);
+    unsigned smallest;
+    unsigned largest;
+};
+
+const Shape Shapes[] = {
+    {"straight_line", straightLineNoAlias, 64, 1024},
+    {"straight_line_may_alias", straightLineMayAlias, 64, 1024},
+    {"loop_nest", loopNest, 2, 64},
+    {"diamonds", diamonds, 16, 1024},
+    {"predicates", predicates, 16, 512},
+};
+
+const std::pair<const char *, Phase> Phases[] = {
+    {"convert", Convert},
+    {"schedule", Schedule},
+    {"pack", Pack},
+    {"lower", Lower},
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    for (auto &shape : Shapes)
+    {
+        for (auto &[phaseName, phase] : Phases)
+        {
+            std::string name = std::string(phaseName) + "/" + shape.name;
+            auto generate = shape.generate;
+            Phase selected = phase;
+            benchmark::RegisterBenchmark(name.c_str(),
+                                         [generate, selected](benchmark::State &state) {
+                                             runPhases(state, generate, selected);
+                                         })
+                ->RangeMultiplier(4)
+                ->Range(shape.smallest, shape.largest)
+                ->Unit(benchmark::kMicrosecond)
+                ->Complexity();
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
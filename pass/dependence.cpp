@@ -0,0 +1,73 @@
+#include "dependence.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+using namespace llvm;
+
+bool getConstantOffset(Value *ptr, const DataLayout &DL, const Value *&base, int64_t &offset)
+{
+    APInt accumulated(DL.getIndexTypeSizeInBits(ptr->getType()), 0);
+    base = ptr->stripAndAccumulateConstantOffsets(DL, accumulated, true);
+    if (accumulated.getMinSignedBits() > 64)
+        return false;
+    offset = accumulated.getSExtValue();
+    return true;
+}
+
+// Every scope `a` belongs to is one `b` is declared not to alias. This is
+// stricter than the per-domain rule of scoped noalias metadata, so it never
+// claims more than the metadata does.
+static bool outOfScope(Instruction *a, Instruction *b)
+{
+    auto *scopes = a->getMetadata(LLVMContext::MD_alias_scope);
+    auto *noalias = b->getMetadata(LLVMContext::MD_noalias);
+    if (!scopes || !noalias || scopes->getNumOperands() == 0)
+        return false;
+    for (const MDOperand &scope : scopes->operands())
+    {
+        if (!is_contained(noalias->operands(), scope))
+            return false;
+    }
+    return true;
+}
+
+bool mayConflict(Instruction *a, Instruction *b)
+{
+    if (!a->mayReadOrWriteMemory() || !b->mayReadOrWriteMemory())
+        return false;
+    if (!a->mayWriteToMemory() && !b->mayWriteToMemory())
+        return false;
+    if (outOfScope(a, b) || outOfScope(b, a))
+        return false;
+
+    Value *ptrA = getLoadStorePointerOperand(a);
+    Value *ptrB = getLoadStorePointerOperand(b);
+    if (!ptrA || !ptrB)
+        return true;
+
+    const DataLayout &DL = a->getModule()->getDataLayout();
+    const Value *baseA, *baseB;
+    int64_t offsetA, offsetB;
+    if (getConstantOffset(ptrA, DL, baseA, offsetA) && getConstantOffset(ptrB, DL, baseB, offsetB) && baseA == baseB)
+    {
+        int64_t sizeA = DL.getTypeStoreSize(getLoadStoreType(a));
+        int64_t sizeB = DL.getTypeStoreSize(getLoadStoreType(b));
+        return offsetA < offsetB + sizeB && offsetB < offsetA + sizeA;
+    }
+
+    const Value *objA = getUnderlyingObject(ptrA);
+    const Value *objB = getUnderlyingObject(ptrB);
+    return objA == objB || !isIdentifiedObject(objA) || !isIdentifiedObject(objB);
+}
+
+bool mayConflictAcrossObjects(Instruction *a, Instruction *b)
+{
+    Value *ptrA = getLoadStorePointerOperand(a);
+    Value *ptrB = getLoadStorePointerOperand(b);
+    if (!ptrA || !ptrB || !mayConflict(a, b))
+        return false;
+    return getUnderlyingObject(ptrA) != getUnderlyingObject(ptrB);
+}
@@ -0,0 +1,22 @@
+#ifndef DEPENDENCE_H
+#define DEPENDENCE_H
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instruction.h"
+#include "predicatedSSA.h"
+#include <vector>
+
+// Splits `ptr` into a base pointer and a constant byte offset from it.
+bool getConstantOffset(llvm::Value *ptr, const llvm::DataLayout &DL, const llvm::Value *&base, int64_t &offset);
+
+// Conservative memory dependence test: false only when `a` and `b` provably
+// cannot touch the same memory in a conflicting way. Accesses whose alias
+// scopes rule each other out, as in a copy of a function versioned on a
+// runtime overlap check, are taken not to conflict.
+bool mayConflict(llvm::Instruction *a, llvm::Instruction *b);
+
+// True when `a` and `b` may conflict only because they access two different
+// underlying objects that might overlap, which a runtime check can rule out.
+bool mayConflictAcrossObjects(llvm::Instruction *a, llvm::Instruction *b);
+
+#endif
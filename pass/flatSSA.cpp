@@ -0,0 +1,84 @@
+#include "flatSSA.h"
+
+using namespace llvm;
+
+FlatSSA::FlatSSA(const SSAFunction &function)
+{
+    addScope(function.items, None);
+}
+
+void FlatSSA::addScope(const std::vector<Item> &items, unsigned parent)
+{
+    for (const auto &item : items)
+    {
+        unsigned id = itemInstructions.size();
+        itemPredicates.push_back(internPredicate(item.Predicate));
+        itemParents.push_back(parent);
+        itemEnds.push_back(id + 1);
+
+        if (auto inst = std::get_if<Instruction *>(&item.content))
+        {
+            itemInstructions.push_back(*inst);
+            itemLoops.push_back(None);
+            instructionItems[*inst] = id;
+            continue;
+        }
+
+        auto *loopNode = std::get<SSALoop *>(item.content);
+        unsigned loop = loopNodes.size();
+        itemInstructions.push_back(nullptr);
+        itemLoops.push_back(loop);
+        loopNodes.push_back(loopNode);
+        loopItems.push_back(id);
+        loopIds[loopNode] = loop;
+
+        internPredicate(loopNode->whileCondition);
+        addScope(loopNode->bodyItems, loop);
+        itemEnds[id] = itemInstructions.size();
+    }
+}
+
+unsigned FlatSSA::itemOf(Instruction *inst) const
+{
+    auto it = instructionItems.find(inst);
+    return it == instructionItems.end() ? None : it->second;
+}
+
+unsigned FlatSSA::itemOf(const Item &item) const
+{
+    if (auto inst = std::get_if<Instruction *>(&item.content))
+        return itemOf(*inst);
+    auto it = loopIds.find(std::get<SSALoop *>(item.content));
+    return it == loopIds.end() ? None : loopItems[it->second];
+}
+
+unsigned FlatSSA::internPredicate(SSAPredicate *pred)
+{
+    auto known = predicateIds.find(pred);
+    if (known != predicateIds.end())
+        return known->second;
+
+    // A missing predicate is kept apart from True, matching predicatesEqual.
+    int kind = -1;
+    Value *condition = nullptr;
+    unsigned left = None;
+    unsigned right = None;
+    if (pred)
+    {
+        kind = pred->kind;
+        if (pred->kind == SSAPredicate::Condition)
+            condition = pred->condition;
+        if (pred->left)
+            left = internPredicate(pred->left);
+        if (pred->right)
+            right = internPredicate(pred->right);
+        if ((pred->kind == SSAPredicate::And || pred->kind == SSAPredicate::Or) && right < left)
+            std::swap(left, right);
+    }
+
+    auto [it, added] = predicateKeys.try_emplace(std::make_tuple(kind, condition, left, right), predicateNodes.size());
+    if (added)
+        predicateNodes.push_back(pred);
+    predicateIds[pred] = it->second;
+    return it->second;
+}
@@ -0,0 +1,73 @@
+#ifndef FLATSSA_H
+#define FLATSSA_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "predicatedSSA.h"
+#include <tuple>
+#include <vector>
+
+// Index view of a predicated SSA function: items, loops and predicates get
+// dense integer ids, and the per-item fields the packer and the scheduler
+// ask about most are kept in parallel arrays. The tree stays the storage that
+// conversion, packing and lowering work on; the view is built over it once
+// per phase and answers lookups by id.
+//
+// Items are numbered in pre-order: a loop item is followed by its whole body,
+// so the items nested in item i are exactly (i, subtreeEnd(i)). Structurally
+// equal predicates share one id, which makes predicate comparison an integer
+// compare. Reordering items inside a scope keeps every id valid, but adding
+// or removing items needs a new view.
+class FlatSSA
+{
+public:
+    static constexpr unsigned None = ~0u;
+
+    explicit FlatSSA(const SSAFunction &function);
+
+    unsigned numItems() const { return itemInstructions.size(); }
+    unsigned numLoops() const { return loopNodes.size(); }
+    unsigned numPredicates() const { return predicateNodes.size(); }
+
+    // Null for loop items.
+    llvm::Instruction *instruction(unsigned item) const { return itemInstructions[item]; }
+    // Loop id of a loop item, None for instructions.
+    unsigned loop(unsigned item) const { return itemLoops[item]; }
+    unsigned predicate(unsigned item) const { return itemPredicates[item]; }
+    // Innermost loop holding the item, None at function level.
+    unsigned parent(unsigned item) const { return itemParents[item]; }
+    unsigned subtreeEnd(unsigned item) const { return itemEnds[item]; }
+
+    SSALoop *loopNode(unsigned loop) const { return loopNodes[loop]; }
+    unsigned loopItem(unsigned loop) const { return loopItems[loop]; }
+    SSAPredicate *predicateNode(unsigned predicate) const { return predicateNodes[predicate]; }
+
+    // Id of the item holding `inst`, None when it is not part of the function.
+    unsigned itemOf(llvm::Instruction *inst) const;
+    unsigned itemOf(const Item &item) const;
+
+    // Interns predicates created after the view was built.
+    unsigned internPredicate(SSAPredicate *pred);
+
+private:
+    std::vector<llvm::Instruction *> itemInstructions;
+    std::vector<unsigned> itemLoops;
+    std::vector<unsigned> itemPredicates;
+    std::vector<unsigned> itemParents;
+    std::vector<unsigned> itemEnds;
+
+    std::vector<SSALoop *> loopNodes;
+    std::vector<unsigned> loopItems;
+
+    std::vector<SSAPredicate *> predicateNodes;
+    llvm::DenseMap<SSAPredicate *, unsigned> predicateIds;
+    // Kind, condition and child ids; And/Or children are sorted so that
+    // operand order does not matter.
+    llvm::DenseMap<std::tuple<int, llvm::Value *, unsigned, unsigned>, unsigned> predicateKeys;
+
+    llvm::DenseMap<llvm::Instruction *, unsigned> instructionItems;
+    llvm::DenseMap<SSALoop *, unsigned> loopIds;
+
+    void addScope(const std::vector<Item> &items, unsigned parent);
+};
+
+#endif
@@ -1,30 +1,356 @@
 #include "llvm/Pass.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Utils/InjectTLIMappings.h"
 #include "predicatedSSA.h"
 #include "slpVectorizer.h"
+#include "scheduler.h"
+#include "ssaFormat.h"
+#include "planCache.h"
+#include "runtimeChecks.h"
+#include "tailFolding.h"
+#include "simdClones.h"
 
 using namespace llvm;
 
+#define DEBUG_TYPE "super-vectorization"
+
+static cl::opt<bool> EnableSuperVectorization(
+    "sv-enable", cl::init(true),
+    cl::desc("Run super-vectorization at the vectorizer extension point of "
+             "the default O2/O3 pipelines"));
+
+static cl::opt<unsigned> LaneWidth(
+    "sv-lane-width", cl::init(4),
+    cl::desc("Maximum number of lanes in a vector pack"));
+
+static cl::opt<int> CostThreshold(
+    "sv-cost-threshold", cl::init(0),
+    cl::desc("Only commit packs that save more than this many cost units "
+             "over the scalar code"));
+
+static cl::opt<bool> ProfileGuided(
+    "sv-profile-guided", cl::init(true),
+    cl::desc("With a profile, skip cold functions and leave packs in cold "
+             "blocks scalar"));
+
+static cl::opt<unsigned> SpeculationThreshold(
+    "sv-speculation-threshold", cl::init(0), cl::Hidden,
+    cl::desc("Run predicated regions up to this cost unconditionally and "
+             "merge their results with selects (0 keeps every branch)"));
+
+static cl::opt<bool> RuntimeChecks(
+    "sv-runtime-checks", cl::init(true),
+    cl::desc("When possible overlap between objects keeps packs from being "
+             "formed, version the function on runtime overlap checks"));
+
+static cl::opt<bool> FoldTails(
+    "sv-fold-tails", cl::init(true),
+    cl::desc("Vectorize simple loops with unknown trip counts, search loops "
+             "and outer loops around one inner loop, across iterations, "
+             "masking off the lanes past the last iteration instead of "
+             "running a scalar epilogue"));
+
+static cl::opt<bool> SimdClones(
+    "sv-simd-clones", cl::init(true),
+    cl::desc("Give small pure functions vector variants, so that isomorphic "
+             "calls to them can be packed into one vector call"));
+
+static cl::opt<std::string> DumpPredicatedSSA(
+    "sv-dump-predicated-ssa", cl::Hidden, cl::value_desc("filename"),
+    cl::desc("Write the module and the scheduled predicated SSA of its "
+             "functions to this file, before packing"));
+
+static cl::opt<std::string> PlanCacheDir(
+    "sv-plan-cache-dir", cl::Hidden, cl::value_desc("directory"),
+    cl::desc("Keep the pack plans of compiled functions in this directory "
+             "and reuse them when the same function is compiled again"));
+
+static cl::opt<std::string> PlanCachePolicy(
+    "sv-plan-cache-policy", cl::Hidden, cl::init("cache_size_bytes=64m"),
+    cl::desc("Pruning policy of the plan cache, in the syntax of "
+             "--thinlto-cache-policy"));
+
 namespace {
 
+void dumpPredicatedSSA(Module &M, const SSAFunctionList &functions) {
+    std::error_code EC;
+    raw_fd_ostream os(DumpPredicatedSSA, EC, sys::fs::OF_Text);
+    std::string error;
+    if (EC)
+        errs() << "sv-dump-predicated-ssa: " << EC.message() << "\n";
+    else if (!writePredicatedSSA(M, functions, os, error))
+        errs() << "sv-dump-predicated-ssa: " << error << "\n";
+}
+
+Optional<PlanCache> openPlanCache() {
+    if (PlanCacheDir.empty())
+        return None;
+    auto policy = parseCachePruningPolicy(PlanCachePolicy);
+    if (!policy) {
+        errs() << "sv-plan-cache-policy: " << toString(policy.takeError()) << "\n";
+        return None;
+    }
+    return PlanCache(PlanCacheDir, *policy);
+}
+
+// Runs before conversion: folded loops are plain IR that the packer then
+// leaves alone, since their values are vectors already.
+void foldTails(Function &F, FunctionAnalysisManager &FAM) {
+    if (!FoldTails)
+        return;
+    auto fold = [&](ObjectPairs &blocking) {
+        bool folded = foldLoopTails(F, FAM.getResult<LoopAnalysis>(F), FAM.getResult<DominatorTreeAnalysis>(F),
+                                    FAM.getResult<ScalarEvolutionAnalysis>(F), FAM.getResult<TargetIRAnalysis>(F),
+                                    LaneWidth, blocking);
+        if (folded)
+            FAM.invalidate(F, PreservedAnalyses::none());
+        return folded;
+    };
+    // Loops held back by possible overlap between objects get one more try
+    // in a copy of the function that runs when the objects are disjoint. The
+    // copy is dropped again unless some loop of it folds after all.
+    ObjectPairs blocking;
+    fold(blocking);
+    if (!RuntimeChecks || blocking.empty())
+        return;
+    // Folding does not price its loops, so only the folding itself decides.
+    InstructionCost cost;
+    auto versioning = versionOnOverlapChecks(F, FAM.getResult<ScalarEvolutionAnalysis>(F),
+                                             FAM.getResult<TargetIRAnalysis>(F), blocking,
+                                             InstructionCost::getMax(), cost);
+    if (!versioning)
+        return;
+    FAM.invalidate(F, PreservedAnalyses::none());
+    ObjectPairs remaining;
+    if (!fold(remaining)) {
+        undoOverlapVersioning(F, *versioning);
+        FAM.invalidate(F, PreservedAnalyses::none());
+    }
+}
+
+// Library calls that TargetLibraryInfo can vectorize, e.g. under
+// -vector-library, name their vector functions in the same attribute as the
+// calls of SIMD clones, so the packer finds both the same way.
+void mapLibraryCalls(Function &F, FunctionAnalysisManager &FAM) {
+    InjectTLIMappings().run(F, FAM);
+}
+
+SSAFunction *convertAndSchedule(Function &F, FunctionAnalysisManager &FAM) {
+    SSAFunction* PredF = convertToPredicatedSSA(F, &FAM.getResult<LazyValueAnalysis>(F));
+    schedulePredicatedSSA(*PredF);
+    //PredicatedSSAPrinter::print(PredF, errs());
+    return PredF;
+}
+
+// Null unless profile-guided packing is on and the module has a profile.
+ProfileSummaryInfo *profileOf(ProfileSummaryInfo *PSI) {
+    return ProfileGuided && PSI && PSI->hasProfileSummary() ? PSI : nullptr;
+}
+
+// Cold functions are left alone entirely: converting and lowering them costs
+// compile time and code size for nothing.
+bool isColdFunction(Function &F, ProfileSummaryInfo *PSI) {
+    return PSI && PSI->isFunctionEntryCold(&F);
+}
+
+PackingOptions packingOptions(Function &F, FunctionAnalysisManager &FAM, ProfileSummaryInfo *PSI) {
+    PackingOptions packing;
+    packing.costThreshold = CostThreshold;
+    packing.TTI = &FAM.getResult<TargetIRAnalysis>(F);
+    packing.TLI = &FAM.getResult<TargetLibraryAnalysis>(F);
+    packing.ORE = &FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+    if (PSI) {
+        packing.PSI = PSI;
+        packing.BFI = &FAM.getResult<BlockFrequencyAnalysis>(F);
+    }
+    return packing;
+}
+
+// What the packs whose first lane is in one of `blocks` save per run of
+// `start`, each weighted by how often its block runs per run of `start`.
+double weightedSavings(const std::unordered_map<const Instruction *, InstructionCost> &savings,
+                       BlockFrequencyInfo &BFI, const BasicBlock *start, ArrayRef<BasicBlock *> blocks) {
+    double startFrequency = std::max<uint64_t>(BFI.getBlockFreq(start).getFrequency(), 1);
+    double total = 0;
+    for (auto &[inst, saving] : savings) {
+        if (!saving.isValid() || (!blocks.empty() && !is_contained(blocks, inst->getParent())))
+            continue;
+        total += *saving.getValue() * (BFI.getBlockFreq(inst->getParent()).getFrequency() / startFrequency);
+    }
+    return total;
+}
+
+// Versions `F` on overlap checks for `blocking` and repacks it. The versioned
+// function, its predicated SSA and its packs replace the original ones only if
+// the packs of the copy save more than the original packs by more than the
+// checks and the copied code cost; otherwise `F` is restored. Savings are
+// weighted by block frequency, so packs in loops count once per iteration.
+// Returns whether the version was kept. Its plan is cached under its own key,
+// and the original key keeps missing and leads to the same versioning.
+bool versionAndRepack(Function &F, SSAFunction *&PredF, PackSet &packs, PackingOptions &packing,
+                      const SLPPacker &packer, FunctionAnalysisManager &FAM, ProfileSummaryInfo *PSI,
+                      const Optional<PlanCache> &cache) {
+    auto &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
+    double original = weightedSavings(packer.packSavings(), BFI, &F.getEntryBlock(), {});
+    // The copy can hardly gain more than the packs the overlaps blocked, so
+    // checks that cost as much are not worth copying the function for.
+    InstructionCost blocked = static_cast<InstructionCost::CostType>(
+        std::lround(weightedSavings(packer.blockedPackSavings(), BFI, &F.getEntryBlock(), {})));
+    InstructionCost cost;
+    Instruction *first = &F.getEntryBlock().front();
+    auto versioning = versionOnOverlapChecks(F, FAM.getResult<ScalarEvolutionAnalysis>(F), *packing.TTI,
+                                             packer.blockingObjectPairs(), blocked, cost);
+    if (!versioning) {
+        if (cost.isValid())
+            packing.ORE->emit([&]() {
+                return OptimizationRemarkMissed(DEBUG_TYPE, "VersioningUnprofitable", first)
+                       << "not versioned on overlap checks: the blocked packs save at most "
+                       << ore::NV("Gain", blocked) << ", the checks and the copied code cost "
+                       << ore::NV("Cost", cost);
+            });
+        return false;
+    }
+    FAM.invalidate(F, PreservedAnalyses::none());
+    SSAFunction *versionedF = convertAndSchedule(F, FAM);
+    PackingOptions versionedPacking = packingOptions(F, FAM, PSI);
+    std::string key = cache ? PlanCache::key(F, *versionedF, LaneWidth, versionedPacking) : "";
+    PackSet versionedPacks;
+    // Only kept versions are cached.
+    bool kept = !key.empty() && cache->lookup(key, F, *versionedF, versionedPacks);
+    if (!kept) {
+        SLPPacker versionedPacker(versionedPacking);
+        versionedPacks = versionedPacker.packInstructions(*versionedF, LaneWidth);
+        double copy = weightedSavings(versionedPacker.packSavings(), FAM.getResult<BlockFrequencyAnalysis>(F),
+                                      versioning->clones.front(), versioning->clones);
+        InstructionCost gain = static_cast<InstructionCost::CostType>(std::lround(copy - original));
+        kept = gain > cost;
+
+        first = &F.getEntryBlock().front();
+        auto describe = [&](auto remark) {
+            return remark << " on overlap checks: the copy saves " << ore::NV("Gain", gain)
+                          << " over the original packs, the checks and the copied code cost "
+                          << ore::NV("Cost", cost);
+        };
+        if (kept)
+            versionedPacking.ORE->emit(
+                [&]() { return describe(OptimizationRemark(DEBUG_TYPE, "Versioned", first) << "versioned"); });
+        else
+            versionedPacking.ORE->emit([&]() {
+                return describe(OptimizationRemarkMissed(DEBUG_TYPE, "VersioningUnprofitable", first)
+                                << "not versioned");
+            });
+        if (kept && !key.empty())
+            cache->store(key, F, *versionedF, versionedPacks);
+    }
+    if (!kept) {
+        undoOverlapVersioning(F, *versioning);
+        FAM.invalidate(F, PreservedAnalyses::none());
+        packing = packingOptions(F, FAM, PSI);
+        return false;
+    }
+    PredF = versionedF;
+    packs = std::move(versionedPacks);
+    packing = versionedPacking;
+    return true;
+}
+
+void packAndLower(Function &F, SSAFunction *PredF, FunctionAnalysisManager &FAM,
+                  ProfileSummaryInfo *PSI, const Optional<PlanCache> &cache) {
+    PackingOptions packing = packingOptions(F, FAM, PSI);
+    std::string key = cache ? PlanCache::key(F, *PredF, LaneWidth, packing) : "";
+    PackSet packs;
+    if (key.empty() || !cache->lookup(key, F, *PredF, packs)) {
+        SLPPacker packer(packing);
+        packs = packer.packInstructions(*PredF, LaneWidth);
+        bool versioned = RuntimeChecks && !packer.blockingObjectPairs().empty() &&
+                         versionAndRepack(F, PredF, packs, packing, packer, FAM, PSI, cache);
+        if (!versioned && !key.empty())
+            cache->store(key, F, *PredF, packs);
+    }
+    LLVM_DEBUG(dbgs() << "Found " << packs.size() << " vector packs in " << F.getName() << "\n");
+    LoweringOptions options;
+    options.speculationThreshold = SpeculationThreshold;
+    options.TTI = packing.TTI;
+    options.TLI = packing.TLI;
+    lowerToIR(PredF, F, packs, options);
+}
+
+// Runs through the explicit `-passes=super-vectorization` pipeline.
 struct SuperVectorizationPass : public PassInfoMixin<SuperVectorizationPass> {
     PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM) {
+        auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        ProfileSummaryInfo *PSI = profileOf(&AM.getResult<ProfileSummaryAnalysis>(M));
+        // Only a module pass may add functions; the default pipelines have
+        // usually inlined such small callees by the time they vectorize.
+        std::vector<Function *> clones;
+        if (SimdClones)
+            clones = createSimdClones(M, LaneWidth);
+        SSAFunctionList functions;
         for (auto &F : M) {
-            SSAFunction* PredF = convertToPredicatedSSA(F);
-            //PredicatedSSAPrinter::print(PredF, errs());
-            SLPPacker packer;
-            auto packs = packer.packInstructions(*PredF, 4);
-            errs() << "Found " << packs.size() << " vector packs\n";
-            lowerToIR(PredF, F);
+            if (F.isDeclaration() || isColdFunction(F, PSI) || is_contained(clones, &F))
+                continue;
+            foldTails(F, FAM);
+            mapLibraryCalls(F, FAM);
+            functions.push_back({&F, convertAndSchedule(F, FAM)});
         }
-        return PreservedAnalyses::all();
+
+        // Lowering rewrites the IR, so the dump has to happen before any
+        // function is lowered.
+        if (!DumpPredicatedSSA.empty())
+            dumpPredicatedSSA(M, functions);
+
+        Optional<PlanCache> cache = openPlanCache();
+        for (auto &[F, PredF] : functions)
+            packAndLower(*F, PredF, FAM, PSI, cache);
+        if (cache)
+            cache->prune();
+        dropUnusedSimdClones(M, clones);
+        return PreservedAnalyses::none();
     };
 };
 
+// Runs inside the default pipelines, one function at a time.
+struct SuperVectorizationFunctionPass : public PassInfoMixin<SuperVectorizationFunctionPass> {
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+        // The default pipelines compute the profile summary up front.
+        auto &MAMProxy = FAM.getResult<ModuleAnalysisManagerFunctionProxy>(F);
+        ProfileSummaryInfo *PSI = profileOf(
+            MAMProxy.getCachedResult<ProfileSummaryAnalysis>(*F.getParent()));
+        if (isColdFunction(F, PSI))
+            return PreservedAnalyses::all();
+
+        foldTails(F, FAM);
+        mapLibraryCalls(F, FAM);
+        if (!cacheOpened) {
+            cache = openPlanCache();
+            cacheOpened = true;
+        }
+        packAndLower(F, convertAndSchedule(F, FAM), FAM, PSI, cache);
+        if (cache)
+            cache->prune();
+        return PreservedAnalyses::none();
+    }
+
+    // Opened on the first function the pipeline runs on; prune() holds off
+    // until the policy's interval has passed.
+    Optional<PlanCache> cache;
+    bool cacheOpened = false;
+};
+
 }
 
 extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
@@ -43,15 +369,21 @@ llvmGetPassPluginInfo() {
                         MPM.addPass(SuperVectorizationPass());
                         MPM.addPass(createModuleToFunctionPassAdaptor(
                             LoopSimplifyPass()));
-                        FunctionPassManager FPM;
-
-                        
-                        return true;   
+                        return true;
                     }
                     return false;
                 });
-            
-            PB.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
+
+            // After inlining and before the cleanup that follows the
+            // vectorizers. Conversion expects loops in simplified form.
+            PB.registerVectorizerStartEPCallback(
+                [](FunctionPassManager &FPM, OptimizationLevel Level) {
+                    if (!EnableSuperVectorization)
+                        return;
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(SuperVectorizationFunctionPass());
+                    FPM.addPass(LoopSimplifyPass());
+                });
         }
     };
-}
\ No newline at end of file
+}
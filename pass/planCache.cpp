@@ -0,0 +1,271 @@
+#include "planCache.h"
+#include "flatSSA.h"
+#include "slpVectorizer.h"
+#include "ssaFormat.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_sha1_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+using namespace llvm;
+
+// Bump whenever the packer or the plan format changes what a key stands for.
+static const char *const PlanVersion = "sv-plan 5";
+
+std::string PlanCache::key(Function &F, SSAFunction &function, int laneWidth, const PackingOptions &options)
+{
+    raw_sha1_ostream hash;
+    const Module *M = F.getParent();
+    hash << PlanVersion << "\n"
+         << M->getTargetTriple() << "\n"
+         << M->getDataLayoutStr() << "\n"
+         << F.getAttributes().getFnAttrs().getAsString() << "\n"
+         << laneWidth << " " << options.costThreshold << "\n";
+    // The profile only reaches the packer through the cold blocks it skips.
+    for (auto &BB : F)
+        hash << (options.isCold(&BB) ? 'c' : '.');
+    hash << "\n";
+    F.print(hash);
+
+    std::string error;
+    if (!writePredicatedSSAFunction(F, function, hash, error))
+        return "";
+    return toHex(hash.sha1(), /*LowerCase=*/true);
+}
+
+// pruneCache only looks at files named "llvm-*".
+std::string PlanCache::entryPath(const std::string &key) const
+{
+    SmallString<128> path(directory);
+    sys::path::append(path, "llvm-sv-" + key);
+    return std::string(path);
+}
+
+namespace
+{
+
+using InstructionIds = DenseMap<const Instruction *, unsigned>;
+
+// Loops are named after the first instruction of their body in function
+// order, which the packer's reordering does not change.
+unsigned firstInstruction(const std::vector<Item> &items, const InstructionIds &ids)
+{
+    unsigned first = ~0u;
+    for (auto &item : items)
+    {
+        if (auto inst = std::get_if<Instruction *>(&item.content))
+            first = std::min(first, ids.lookup(*inst));
+        else
+            first = std::min(first, firstInstruction(std::get<SSALoop *>(item.content)->bodyItems, ids));
+    }
+    return first;
+}
+
+std::string itemName(const Item &item, const InstructionIds &ids)
+{
+    if (auto inst = std::get_if<Instruction *>(&item.content))
+        return "i" + std::to_string(ids.lookup(*inst));
+    return "l" + std::to_string(firstInstruction(std::get<SSALoop *>(item.content)->bodyItems, ids));
+}
+
+// The item lists of `items` and of the loops in it, by scope name: "-" for
+// the function, the loop's name for a loop body.
+void collectScopes(std::vector<Item> &items, const std::string &name, const InstructionIds &ids,
+                   std::map<std::string, std::vector<Item> *> &scopes)
+{
+    scopes[name] = &items;
+    for (auto &item : items)
+    {
+        if (auto loop = std::get_if<SSALoop *>(&item.content))
+            collectScopes((*loop)->bodyItems, itemName(item, ids), ids, scopes);
+    }
+}
+
+// One "order <scope> <item>..." line per scope.
+void writeOrder(const std::vector<Item> &items, const std::string &name, const InstructionIds &ids,
+                std::vector<std::string> &lines)
+{
+    std::string line = "order " + name;
+    for (auto &item : items)
+        line += " " + itemName(item, ids);
+    lines.push_back(line);
+    for (auto &item : items)
+    {
+        if (auto loop = std::get_if<SSALoop *>(&item.content))
+            writeOrder((*loop)->bodyItems, itemName(item, ids), ids, lines);
+    }
+}
+
+// The items of `scope` in the order `tokens` names them; false unless the
+// tokens name every item exactly once.
+bool reorder(const std::vector<Item> &scope, ArrayRef<StringRef> tokens, const InstructionIds &ids,
+             std::vector<Item> &ordered)
+{
+    if (tokens.size() != scope.size())
+        return false;
+    StringMap<const Item *> byName;
+    for (auto &item : scope)
+        byName[itemName(item, ids)] = &item;
+    for (StringRef token : tokens)
+    {
+        auto it = byName.find(token);
+        if (it == byName.end() || !it->second)
+            return false;
+        ordered.push_back(*it->second);
+        it->second = nullptr;
+    }
+    return true;
+}
+
+} // namespace
+
+bool PlanCache::lookup(const std::string &key, Function &F, SSAFunction &function, PackSet &packs) const
+{
+    auto buffer = MemoryBuffer::getFile(entryPath(key));
+    if (!buffer)
+        return false;
+
+    std::vector<Instruction *> instructionList;
+    InstructionIds instructionIds;
+    for (auto &I : instructions(F))
+    {
+        instructionIds[&I] = instructionList.size();
+        instructionList.push_back(&I);
+    }
+    FlatSSA flat(function);
+    std::map<std::string, std::vector<Item> *> scopes;
+    collectScopes(function.items, "-", instructionIds, scopes);
+    std::map<std::vector<Item> *, std::vector<Item>> orders;
+
+    SmallVector<StringRef, 16> lines;
+    (*buffer)->getBuffer().split(lines, '\n', -1, false);
+    if (lines.empty() || lines[0] != PlanVersion)
+        return false;
+
+    PackSet plan;
+    for (StringRef line : makeArrayRef(lines).drop_front())
+    {
+        SmallVector<StringRef, 8> tokens;
+        line.split(tokens, ' ', -1, false);
+        if (tokens.size() >= 2 && tokens[0] == "order")
+        {
+            auto scope = scopes.find(tokens[1].str());
+            if (scope == scopes.end() || orders.count(scope->second) ||
+                !reorder(*scope->second, makeArrayRef(tokens).drop_front(2), instructionIds, orders[scope->second]))
+                return false;
+            continue;
+        }
+        unsigned stride;
+        if (tokens.size() < 5 || tokens[0] != "pack" || tokens[1].getAsInteger(10, stride) ||
+            (tokens[2] != "0" && tokens[2] != "1"))
+            return false;
+
+        // The first field is the element stride between lanes: 1 for
+        // contiguous packs, 0 for packs without a constant one.
+        VectorPack pack;
+        pack.contiguous = stride == 1;
+        pack.stride = stride > 1 ? stride : 0;
+        pack.padded = tokens[2] == "1";
+        if (tokens[3] != "-")
+        {
+            if (tokens[3].size() != tokens.size() - 4 || tokens[3].find_first_not_of("01") != StringRef::npos)
+                return false;
+            for (char swap : tokens[3])
+                pack.swapped.push_back(swap == '1');
+        }
+        for (StringRef token : makeArrayRef(tokens).drop_front(4))
+        {
+            unsigned index;
+            if (token.getAsInteger(10, index) || index >= instructionList.size() ||
+                flat.itemOf(instructionList[index]) == FlatSSA::None)
+                return false;
+            pack.instructions.push_back(instructionList[index]);
+        }
+        pack.predicate = flat.predicateNode(flat.predicate(flat.itemOf(pack.instructions[0])));
+        plan.insert(pack);
+    }
+    if (orders.size() != scopes.size())
+        return false;
+    for (auto &[scope, order] : orders)
+        *scope = std::move(order);
+    packs = std::move(plan);
+    return true;
+}
+
+void PlanCache::store(const std::string &key, Function &F, const SSAFunction &function, const PackSet &packs) const
+{
+    InstructionIds instructionIds;
+    for (auto &I : instructions(F))
+        instructionIds[&I] = instructionIds.size();
+
+    // Packs are kept in an unordered set; sort them so that equal plans give
+    // equal files.
+    std::vector<std::string> lines;
+    for (auto &pack : packs)
+    {
+        std::string line = "pack " + std::to_string(pack.contiguous ? 1 : pack.stride) + " ";
+        line += pack.padded ? "1 " : "0 ";
+        if (pack.swapped.empty())
+            line += "-";
+        for (bool swap : pack.swapped)
+            line += swap ? '1' : '0';
+        for (auto *inst : pack.instructions)
+            line += " " + std::to_string(instructionIds.lookup(inst));
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    writeOrder(function.items, "-", instructionIds, lines);
+
+    if (sys::fs::create_directories(directory))
+        return;
+    SmallString<128> model(directory);
+    sys::path::append(model, "sv-tmp-%%%%%%%%");
+    int fd;
+    SmallString<128> tempPath;
+    if (sys::fs::createUniqueFile(model, fd, tempPath))
+        return;
+
+    {
+        raw_fd_ostream os(fd, /*shouldClose=*/true);
+        os << PlanVersion << "\n";
+        for (auto &line : lines)
+            os << line << "\n";
+        os.close();
+        if (os.has_error())
+        {
+            os.clear_error();
+            sys::fs::remove(tempPath);
+            return;
+        }
+    }
+    if (sys::fs::rename(tempPath, entryPath(key)))
+        sys::fs::remove(tempPath);
+}
+
+// pruneCache keeps its own timestamp file, but reading it on every function
+// compiled is wasted work; the process remembers when it last pruned each
+// directory.
+void PlanCache::prune() const
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::chrono::steady_clock::time_point> lastPruned;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        auto last = lastPruned.find(directory);
+        if (last != lastPruned.end() && policy.Interval && now - last->second < *policy.Interval)
+            return;
+        lastPruned[directory] = now;
+    }
+    pruneCache(directory, policy);
+}
@@ -0,0 +1,51 @@
+#ifndef PLANCACHE_H
+#define PLANCACHE_H
+
+#include "llvm/Support/CachePruning.h"
+#include "predicatedSSA.h"
+#include <string>
+
+struct PackingOptions;
+
+// On-disk cache of the packs chosen for a function. Entries are keyed by a
+// hash of everything the packer reads: the target, the packing options, the
+// IR and the scheduled predicated SSA of the function. A hit replaces seeding,
+// pack search and legality checks; conversion and scheduling still run,
+// because lowering needs their result anyway.
+//
+// Plans name instructions by position, so an entry is only ever applied to
+// the function it was computed for. Besides the packs, a plan records the
+// order the packer left the items of each scope in: a pack that could only be
+// placed by moving its lanes past other items is lowered where it was placed. Entries are written to a temporary file
+// and renamed into place, so concurrent compilers sharing the directory see
+// either a whole entry or none; a lost race just means one of two identical
+// plans wins.
+class PlanCache
+{
+public:
+    PlanCache(std::string directory, llvm::CachePruningPolicy policy)
+        : directory(std::move(directory)), policy(policy)
+    {
+    }
+
+    // Empty when the function cannot be fingerprinted.
+    static std::string key(llvm::Function &F, SSAFunction &function, int laneWidth, const PackingOptions &options);
+
+    // False on a miss, or when the entry does not fit `function`. On a hit the
+    // items of `function` are put in the order the plan was made with.
+    bool lookup(const std::string &key, llvm::Function &F, SSAFunction &function, PackSet &packs) const;
+    // `function` is the predicated SSA as the packer left it.
+    void store(const std::string &key, llvm::Function &F, const SSAFunction &function, const PackSet &packs) const;
+
+    // Evicts entries as the policy asks. Calls within the policy's interval
+    // of the last one from this process return without touching the disk.
+    void prune() const;
+
+private:
+    std::string directory;
+    llvm::CachePruningPolicy policy;
+
+    std::string entryPath(const std::string &key) const;
+};
+
+#endif
@@ -0,0 +1,526 @@
+#include "predicateSimplifier.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/KnownBits.h"
+#include <algorithm>
+
+using namespace llvm;
+
+static SSAPredicate *makePredicate(SSAPredicate::Kind kind, SSAPredicate *left = nullptr, SSAPredicate *right = nullptr)
+{
+    SSAPredicate *pred = new SSAPredicate();
+    pred->kind = kind;
+    pred->left = left;
+    pred->right = right;
+    return pred;
+}
+
+SSAPredicate *PredicateSimplifier::truth()
+{
+    return makePredicate(SSAPredicate::True);
+}
+
+SSAPredicate *PredicateSimplifier::falsity()
+{
+    return makePredicate(SSAPredicate::Not, truth());
+}
+
+bool PredicateSimplifier::isTrue(SSAPredicate *pred)
+{
+    return !pred || pred->kind == SSAPredicate::True;
+}
+
+bool PredicateSimplifier::isFalse(SSAPredicate *pred)
+{
+    return pred && pred->kind == SSAPredicate::Not && isTrue(pred->left);
+}
+
+static SSAPredicate *negate(SSAPredicate *pred)
+{
+    if (pred->kind == SSAPredicate::Not)
+        return pred->left;
+    return makePredicate(SSAPredicate::Not, pred);
+}
+
+static void flatten(SSAPredicate *pred, SSAPredicate::Kind kind, std::vector<SSAPredicate *> &terms)
+{
+    if (pred->kind == kind)
+    {
+        flatten(pred->left, kind, terms);
+        flatten(pred->right, kind, terms);
+    }
+    else
+    {
+        terms.push_back(pred);
+    }
+}
+
+// Splits a literal into its condition value and polarity.
+static bool asLiteral(SSAPredicate *pred, Value *&cond, bool &polarity)
+{
+    polarity = true;
+    if (pred->kind == SSAPredicate::Not)
+    {
+        polarity = false;
+        pred = pred->left;
+    }
+    if (pred->kind != SSAPredicate::Condition)
+        return false;
+    cond = pred->condition;
+    return true;
+}
+
+SSAPredicate *PredicateSimplifier::node(SSAPredicate::Kind kind, SSAPredicate *left, SSAPredicate *right,
+                                        Value *condition)
+{
+    SSAPredicate *&pred = nodes[std::make_tuple(static_cast<int>(kind), left, right, condition)];
+    if (!pred)
+    {
+        pred = makePredicate(kind, left, right);
+        pred->condition = condition;
+        // Already as simple as it gets.
+        cache[pred] = pred;
+        if (kind == SSAPredicate::And)
+            addConjunction(pred);
+    }
+    return pred;
+}
+
+static bool isCmpLiteral(SSAPredicate *pred)
+{
+    if (pred->kind == SSAPredicate::Not)
+        pred = pred->left;
+    return pred->kind == SSAPredicate::Condition && isa<CmpInst>(pred->condition);
+}
+
+void PredicateSimplifier::addConjunction(SSAPredicate *pred)
+{
+    Conjunction info;
+    auto shorter = conjunctions.find(pred->left);
+    if (shorter == conjunctions.end())
+    {
+        info.length = 2;
+        info.literalsOnly = isCmpLiteral(pred->left) && isCmpLiteral(pred->right);
+        addedBy[pred->left].push_back(pred);
+    }
+    else
+    {
+        info.length = shorter->second.length + 1;
+        info.literalsOnly = shorter->second.literalsOnly && isCmpLiteral(pred->right);
+        info.prefixes.push_back(pred->left);
+        for (size_t i = 0; i < info.prefixes.size(); i++)
+        {
+            auto &prefix = conjunctions[info.prefixes[i]].prefixes;
+            if (i >= prefix.size())
+                break;
+            info.prefixes.push_back(prefix[i]);
+        }
+    }
+    addedBy[pred->right].push_back(pred);
+    conjunctions[pred] = std::move(info);
+}
+
+// Whether `term` is one of the terms of a conjunction built by node(): it is
+// if a node adding it is on the left spine of the conjunction.
+bool PredicateSimplifier::hasConjunct(SSAPredicate *conjunction, SSAPredicate *term)
+{
+    auto adders = addedBy.find(term);
+    if (adders == addedBy.end())
+        return false;
+    unsigned length = conjunctions[conjunction].length;
+    for (SSAPredicate *adder : adders->second)
+    {
+        unsigned adderLength = conjunctions[adder].length;
+        if (adderLength > length)
+            continue;
+        SSAPredicate *ancestor = conjunction;
+        for (unsigned distance = length - adderLength, bit = 0; distance; distance >>= 1, bit++)
+        {
+            if (distance & 1)
+                ancestor = conjunctions[ancestor].prefixes[bit];
+        }
+        if (ancestor == adder)
+            return true;
+    }
+    return false;
+}
+
+// The node of a literal, or null when the simplifier has not built it.
+SSAPredicate *PredicateSimplifier::literal(Value *cond, bool polarity)
+{
+    auto it = nodes.find(std::make_tuple(static_cast<int>(SSAPredicate::Condition), nullptr, nullptr, cond));
+    if (it == nodes.end() || polarity)
+        return it == nodes.end() ? nullptr : it->second;
+    it = nodes.find(std::make_tuple(static_cast<int>(SSAPredicate::Not), it->second, nullptr, nullptr));
+    return it == nodes.end() ? nullptr : it->second;
+}
+
+// simplifyAnd of a conjunction of compare literals and one more compare
+// literal, without comparing the literal to every conjunct: only compares
+// sharing an operand with it can imply or refute it, and those are found
+// through the users of its operands. Returns null when the new literal
+// makes a conjunct redundant, which the general path handles.
+SSAPredicate *PredicateSimplifier::conjoinLiteral(SSAPredicate *conjunction, SSAPredicate *term)
+{
+    Value *cond;
+    bool polarity;
+    asLiteral(term, cond, polarity);
+    if (hasConjunct(conjunction, term))
+        return conjunction;
+    SSAPredicate *complement = literal(cond, !polarity);
+    if (complement && hasConjunct(conjunction, complement))
+        return falsity();
+
+    SmallSetVector<Value *, 8> related;
+    for (Value *operand : cast<CmpInst>(cond)->operands())
+    {
+        if (isa<Constant>(operand))
+            continue;
+        for (User *user : operand->users())
+        {
+            if (user != cond && isa<CmpInst>(user))
+                related.insert(user);
+        }
+    }
+    for (Value *other : related)
+    {
+        for (bool otherPolarity : {true, false})
+        {
+            SSAPredicate *conjunct = literal(other, otherPolarity);
+            if (!conjunct || !hasConjunct(conjunction, conjunct))
+                continue;
+            int implied = implies(conjunct, term, true);
+            if (implied == 0)
+                return falsity();
+            if (implied == 1)
+                return conjunction;
+            if (implies(term, conjunct, true) == 1)
+                return nullptr;
+        }
+    }
+    return node(SSAPredicate::And, conjunction, term);
+}
+
+// Left-nested, so that the terms of a conjunction extended by one term are
+// the node of the shorter conjunction and that term.
+SSAPredicate *PredicateSimplifier::rebuild(const std::vector<SSAPredicate *> &terms, SSAPredicate::Kind kind)
+{
+    SSAPredicate *result = terms[0];
+    for (size_t i = 1; i < terms.size(); i++)
+        result = node(kind, result, terms[i]);
+    return result;
+}
+
+static bool contains(const std::vector<SSAPredicate *> &terms, SSAPredicate *pred)
+{
+    return std::any_of(terms.begin(), terms.end(), [&](SSAPredicate *term)
+                       { return predicatesEqual(term, pred); });
+}
+
+SSAPredicate *PredicateSimplifier::simplify(SSAPredicate *pred)
+{
+    if (!pred)
+        return truth();
+    auto it = cache.find(pred);
+    if (it != cache.end())
+        return it->second;
+    SSAPredicate *result = simplifyUncached(pred);
+    cache[pred] = result;
+    return result;
+}
+
+SSAPredicate *PredicateSimplifier::simplifyUncached(SSAPredicate *pred)
+{
+    switch (pred->kind)
+    {
+    case SSAPredicate::True:
+        return pred;
+    case SSAPredicate::Condition:
+        return foldCondition(pred);
+    case SSAPredicate::Not:
+    {
+        SSAPredicate *inner = simplify(pred->left);
+        if (inner->kind == SSAPredicate::Not)
+            return inner->left;
+        if (isTrue(inner))
+            return falsity();
+        return node(SSAPredicate::Not, inner);
+    }
+    case SSAPredicate::And:
+    case SSAPredicate::Or:
+    {
+        // The operands are simplified on their own first: block predicates
+        // extend the predicate of a dominating block by one condition, and
+        // only that condition is new.
+        SSAPredicate *left = simplify(pred->left);
+        SSAPredicate *right = simplify(pred->right);
+        if (pred->kind == SSAPredicate::And && isCmpLiteral(right))
+        {
+            auto conjunction = conjunctions.find(left);
+            if (conjunction != conjunctions.end() && conjunction->second.literalsOnly)
+            {
+                if (SSAPredicate *result = conjoinLiteral(left, right))
+                    return result;
+            }
+        }
+        std::vector<SSAPredicate *> terms;
+        flatten(left, pred->kind, terms);
+        size_t clean = terms.size();
+        flatten(right, pred->kind, terms);
+        return pred->kind == SSAPredicate::And ? simplifyAnd(terms, clean) : simplifyOr(terms, clean);
+    }
+    }
+    return pred;
+}
+
+// A condition that has the same value wherever it is computed can be replaced
+// by that value: predicates only read it on paths where it was computed.
+SSAPredicate *PredicateSimplifier::foldCondition(SSAPredicate *pred)
+{
+    Value *cond = pred->condition;
+    if (auto *constant = dyn_cast<ConstantInt>(cond))
+        return constant->isOne() ? truth() : falsity();
+
+    auto *inst = dyn_cast<Instruction>(cond);
+    if (!inst)
+        return node(SSAPredicate::Condition, nullptr, nullptr, cond);
+
+    KnownBits known = computeKnownBits(cond, DL, 0, nullptr, inst, DT);
+    if (known.isConstant())
+        return known.getConstant().isOne() ? truth() : falsity();
+
+    if (Optional<bool> implied = isImpliedByDomCondition(cond, inst, DL))
+        return *implied ? truth() : falsity();
+
+    if (LVI)
+    {
+        if (auto *cmp = dyn_cast<ICmpInst>(inst))
+        {
+            auto result = LVI->getPredicateAt(cmp->getPredicate(), cmp->getOperand(0), cmp->getOperand(1), cmp, true);
+            if (result == LazyValueInfo::True)
+                return truth();
+            if (result == LazyValueInfo::False)
+                return falsity();
+        }
+    }
+    return node(SSAPredicate::Condition, nullptr, nullptr, cond);
+}
+
+// isImpliedCondition relates compares through their operands; compares that
+// share no operand other than a constant are not worth asking about.
+static bool mayRelate(Value *a, Value *b)
+{
+    auto *cmpA = dyn_cast<CmpInst>(a);
+    auto *cmpB = dyn_cast<CmpInst>(b);
+    if (!cmpA || !cmpB)
+        return true;
+    for (Value *x : cmpA->operands())
+    {
+        if (!isa<Constant>(x) && is_contained(cmpB->operands(), x))
+            return true;
+    }
+    return false;
+}
+
+// 1 when `b` must hold given that `a` has value `aHolds`, 0 when `b` must
+// not hold, -1 when unknown.
+int PredicateSimplifier::implies(SSAPredicate *a, SSAPredicate *b, bool aHolds)
+{
+    Value *condA, *condB;
+    bool polarityA, polarityB;
+    if (!asLiteral(a, condA, polarityA) || !asLiteral(b, condB, polarityB) || !mayRelate(condA, condB))
+        return -1;
+    Optional<bool> implied = isImpliedCondition(condA, condB, DL, polarityA == aHolds);
+    if (!implied)
+        return -1;
+    return *implied == polarityB ? 1 : 0;
+}
+
+// The first term that term `i` has to be compared with: terms of the
+// simplified predicate the new ones are added to, the first `clean`, were
+// compared with each other already.
+static size_t firstToCompare(size_t i, size_t clean)
+{
+    return i < clean ? clean : 0;
+}
+
+SSAPredicate *PredicateSimplifier::simplifyAnd(std::vector<SSAPredicate *> terms, size_t clean)
+{
+    std::vector<SSAPredicate *> kept;
+    size_t keptClean = 0;
+    for (size_t i = 0; i < terms.size(); i++)
+    {
+        SSAPredicate *term = terms[i];
+        if (isFalse(term))
+            return falsity();
+        if (isTrue(term))
+            continue;
+        if (i < clean)
+        {
+            kept.push_back(term);
+            keptClean++;
+            continue;
+        }
+        if (contains(kept, term))
+            continue;
+        if (contains(kept, negate(term)))
+            return falsity();
+        kept.push_back(term);
+    }
+
+    // Absorption: a && (a || b) == a.
+    std::vector<SSAPredicate *> absorbed;
+    size_t absorbedClean = 0;
+    for (size_t i = 0; i < kept.size(); i++)
+    {
+        std::vector<SSAPredicate *> disjuncts;
+        if (kept[i]->kind == SSAPredicate::Or)
+            flatten(kept[i], SSAPredicate::Or, disjuncts);
+        bool redundant = false;
+        for (size_t j = firstToCompare(i, keptClean); j < kept.size() && !redundant; j++)
+            redundant = j != i && contains(disjuncts, kept[j]);
+        if (!redundant)
+        {
+            absorbed.push_back(kept[i]);
+            absorbedClean += i < keptClean;
+        }
+    }
+
+    // Literals implied by another conjunct are redundant; literals refuted by
+    // one make the whole conjunction false.
+    std::vector<SSAPredicate *> result;
+    for (size_t i = 0; i < absorbed.size(); i++)
+    {
+        bool redundant = false;
+        for (size_t j = firstToCompare(i, absorbedClean); j < absorbed.size() && !redundant; j++)
+        {
+            if (i == j)
+                continue;
+            int implied = implies(absorbed[j], absorbed[i], true);
+            if (implied == 0)
+                return falsity();
+            // Of two literals implying each other, keep the first.
+            redundant = implied == 1 && (j < i || implies(absorbed[i], absorbed[j], true) != 1);
+        }
+        if (!redundant)
+            result.push_back(absorbed[i]);
+    }
+
+    if (result.empty())
+        return truth();
+    return rebuild(result, SSAPredicate::And);
+}
+
+SSAPredicate *PredicateSimplifier::simplifyOr(std::vector<SSAPredicate *> terms, size_t clean)
+{
+    std::vector<SSAPredicate *> kept;
+    size_t keptClean = 0;
+    for (size_t i = 0; i < terms.size(); i++)
+    {
+        SSAPredicate *term = terms[i];
+        if (isTrue(term))
+            return truth();
+        if (isFalse(term))
+            continue;
+        if (i < clean)
+        {
+            kept.push_back(term);
+            keptClean++;
+            continue;
+        }
+        if (contains(kept, term))
+            continue;
+        if (contains(kept, negate(term)))
+            return truth();
+        kept.push_back(term);
+    }
+
+    // Absorption: a || (a && b) == a.
+    std::vector<SSAPredicate *> absorbed;
+    size_t absorbedClean = 0;
+    for (size_t i = 0; i < kept.size(); i++)
+    {
+        std::vector<SSAPredicate *> conjuncts;
+        if (kept[i]->kind == SSAPredicate::And)
+            flatten(kept[i], SSAPredicate::And, conjuncts);
+        bool redundant = false;
+        for (size_t j = firstToCompare(i, keptClean); j < kept.size() && !redundant; j++)
+            redundant = j != i && contains(conjuncts, kept[j]);
+        if (!redundant)
+        {
+            absorbed.push_back(kept[i]);
+            absorbedClean += i < keptClean;
+        }
+    }
+
+    // A literal implying another disjunct is redundant; a literal whose
+    // failure implies another disjunct makes the whole disjunction true.
+    std::vector<SSAPredicate *> result;
+    for (size_t i = 0; i < absorbed.size(); i++)
+    {
+        bool redundant = false;
+        for (size_t j = firstToCompare(i, absorbedClean); j < absorbed.size() && !redundant; j++)
+        {
+            if (i == j)
+                continue;
+            if (implies(absorbed[i], absorbed[j], false) == 1)
+                return truth();
+            redundant = implies(absorbed[i], absorbed[j], true) == 1 &&
+                        (j < i || implies(absorbed[j], absorbed[i], true) != 1);
+        }
+        if (!redundant)
+            result.push_back(absorbed[i]);
+    }
+
+    if (result.empty())
+        return falsity();
+    if (result.size() == 1)
+        return result[0];
+    if (SSAPredicate *factored = factorOr(result))
+        return factored;
+    return rebuild(result, SSAPredicate::Or);
+}
+
+// (a && b) || (a && c) == a && (b || c). Returns null when the disjuncts
+// share no conjunct.
+SSAPredicate *PredicateSimplifier::factorOr(const std::vector<SSAPredicate *> &terms)
+{
+    std::vector<std::vector<SSAPredicate *>> conjuncts(terms.size());
+    for (size_t i = 0; i < terms.size(); i++)
+        flatten(terms[i], SSAPredicate::And, conjuncts[i]);
+
+    std::vector<SSAPredicate *> common;
+    for (auto *candidate : conjuncts[0])
+    {
+        bool shared = std::all_of(conjuncts.begin() + 1, conjuncts.end(), [&](const std::vector<SSAPredicate *> &c)
+                                  { return contains(c, candidate); });
+        if (shared && !contains(common, candidate))
+            common.push_back(candidate);
+    }
+    if (common.empty())
+        return nullptr;
+
+    std::vector<SSAPredicate *> remainders;
+    for (auto &c : conjuncts)
+    {
+        std::vector<SSAPredicate *> rest;
+        for (auto *conjunct : c)
+        {
+            if (!contains(common, conjunct))
+                rest.push_back(conjunct);
+        }
+        // One disjunct is exactly the common part, which absorbs the rest.
+        if (rest.empty())
+            return simplifyAnd(common);
+        remainders.push_back(rebuild(rest, SSAPredicate::And));
+    }
+
+    std::vector<SSAPredicate *> disjuncts;
+    for (auto *remainder : remainders)
+        flatten(remainder, SSAPredicate::Or, disjuncts);
+    std::vector<SSAPredicate *> terms2 = common;
+    flatten(simplifyOr(disjuncts), SSAPredicate::And, terms2);
+    return simplifyAnd(terms2);
+}
@@ -0,0 +1,80 @@
+#ifndef PREDICATESIMPLIFIER_H
+#define PREDICATESIMPLIFIER_H
+
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "predicatedSSA.h"
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Boolean simplification of predicates. And/Or chains are flattened and
+// cleaned up with constant folding, deduplication, complement detection,
+// absorption, implication between literals and factoring of conjuncts shared
+// by every disjunct. Condition leaves are folded when known bits, LazyValueInfo
+// or a dominating branch decide them at their definition.
+//
+// Results are nodes of the simplifier, which are never modified, so shared
+// sub-predicates stay valid; it builds one node per distinct kind and operands,
+// so the simplified forms of predicates that share a part share its node.
+// Conjoining a term to a simplified conjunction, or disjoining one to a
+// simplified disjunction, only compares the new term against the old ones;
+// conjoining a literal to a conjunction of literals, as block predicates do
+// along a chain of nested branches, only looks up the literals it may
+// interact with. False is represented as Not(True).
+class PredicateSimplifier
+{
+public:
+    PredicateSimplifier(const llvm::DataLayout &DL, llvm::DominatorTree *DT = nullptr,
+                        llvm::LazyValueInfo *LVI = nullptr)
+        : DL(DL), DT(DT), LVI(LVI)
+    {
+    }
+
+    SSAPredicate *simplify(SSAPredicate *pred);
+
+    static SSAPredicate *truth();
+    static SSAPredicate *falsity();
+    static bool isTrue(SSAPredicate *pred);
+    static bool isFalse(SSAPredicate *pred);
+
+private:
+    const llvm::DataLayout &DL;
+    llvm::DominatorTree *DT;
+    llvm::LazyValueInfo *LVI;
+    std::unordered_map<SSAPredicate *, SSAPredicate *> cache;
+    std::map<std::tuple<int, SSAPredicate *, SSAPredicate *, llvm::Value *>, SSAPredicate *> nodes;
+
+    // A conjunction node built by the simplifier: a left-nested chain of
+    // And nodes, each adding one term to the conjunction on its left.
+    struct Conjunction
+    {
+        unsigned length;
+        bool literalsOnly;
+        // The 1st, 2nd, 4th, ... shorter conjunctions on the left spine.
+        std::vector<SSAPredicate *> prefixes;
+    };
+    std::unordered_map<SSAPredicate *, Conjunction> conjunctions;
+    // The conjunction nodes that add each term.
+    std::unordered_map<SSAPredicate *, std::vector<SSAPredicate *>> addedBy;
+
+    SSAPredicate *node(SSAPredicate::Kind kind, SSAPredicate *left = nullptr, SSAPredicate *right = nullptr,
+                       llvm::Value *condition = nullptr);
+    SSAPredicate *rebuild(const std::vector<SSAPredicate *> &terms, SSAPredicate::Kind kind);
+    void addConjunction(SSAPredicate *pred);
+    bool hasConjunct(SSAPredicate *conjunction, SSAPredicate *term);
+    SSAPredicate *literal(llvm::Value *cond, bool polarity);
+    SSAPredicate *conjoinLiteral(SSAPredicate *conjunction, SSAPredicate *term);
+    SSAPredicate *simplifyUncached(SSAPredicate *pred);
+    SSAPredicate *foldCondition(SSAPredicate *pred);
+    // The first `clean` terms are those of an already simplified predicate
+    // and are not compared with each other again.
+    SSAPredicate *simplifyAnd(std::vector<SSAPredicate *> terms, size_t clean = 0);
+    SSAPredicate *simplifyOr(std::vector<SSAPredicate *> terms, size_t clean = 0);
+    SSAPredicate *factorOr(const std::vector<SSAPredicate *> &terms);
+    int implies(SSAPredicate *a, SSAPredicate *b, bool aHolds);
+};
+
+#endif
@@ -1,13 +1,25 @@
 #include "predicatedSSA.h"
-#include "llvm/Analysis/PostDominators.h"
-#include "llvm/Analysis/DominanceFrontier.h"
+#include "predicateSimplifier.h"
+#include "vectorCalls.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include <algorithm>
+#include <map>
 #include <queue>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -15,6 +27,8 @@ using namespace llvm;
 
 bool predicatesEqual(SSAPredicate *A, SSAPredicate *B)
 {
+    if (A == B)
+        return true;
     if (A->kind != B->kind)
         return false;
 
@@ -39,119 +53,239 @@ bool predicatesEqual(SSAPredicate *A, SSAPredicate *B)
     return false;
 }
 
+// Immediate dominators of the blocks lowering creates. The lowered CFG is
+// structured, so each block's idom is known the moment it is created. Each
+// block also keeps its dominators 1, 2, 4, ... levels up, so a query climbs
+// a deep chain of nested regions in logarithmic time.
+class LoweredDominance
+{
+private:
+    struct Node
+    {
+        unsigned depth;
+        std::vector<BasicBlock *> ancestors;
+    };
+    std::unordered_map<BasicBlock *, Node> nodes;
+
+public:
+    void add(BasicBlock *block, BasicBlock *idom)
+    {
+        Node node{0, {}};
+        auto parent = idom ? nodes.find(idom) : nodes.end();
+        if (parent != nodes.end())
+        {
+            node.depth = parent->second.depth + 1;
+            node.ancestors.push_back(idom);
+            for (size_t i = 0; i < node.ancestors.size(); i++)
+            {
+                auto &up = nodes[node.ancestors[i]].ancestors;
+                if (i >= up.size())
+                    break;
+                node.ancestors.push_back(up[i]);
+            }
+        }
+        nodes[block] = std::move(node);
+    }
+
+    bool dominates(BasicBlock *a, BasicBlock *b)
+    {
+        auto nodeA = nodes.find(a);
+        auto nodeB = nodes.find(b);
+        if (nodeA == nodes.end() || nodeB == nodes.end() || nodeA->second.depth > nodeB->second.depth)
+            return false;
+        unsigned distance = nodeB->second.depth - nodeA->second.depth;
+        for (unsigned bit = 0; distance; distance >>= 1, bit++)
+        {
+            if (distance & 1)
+                b = nodes[b].ancestors[bit];
+        }
+        return a == b;
+    }
+};
+
+// Conjunct-wise implication: every conjunct of `outer` appears in `pred`.
+static bool impliesPredicate(SSAPredicate *pred, SSAPredicate *outer)
+{
+    if (!outer || outer->kind == SSAPredicate::True || predicatesEqual(pred, outer))
+        return true;
+    std::vector<SSAPredicate *> conjuncts, required, stack = {pred};
+    while (!stack.empty())
+    {
+        SSAPredicate *p = stack.back();
+        stack.pop_back();
+        if (p->kind == SSAPredicate::And)
+        {
+            stack.push_back(p->left);
+            stack.push_back(p->right);
+        }
+        else
+        {
+            conjuncts.push_back(p);
+        }
+    }
+    stack = {outer};
+    while (!stack.empty())
+    {
+        SSAPredicate *p = stack.back();
+        stack.pop_back();
+        if (p->kind == SSAPredicate::And)
+        {
+            stack.push_back(p->left);
+            stack.push_back(p->right);
+            continue;
+        }
+        bool found = false;
+        for (auto *c : conjuncts)
+            found = found || predicatesEqual(c, p);
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
 class BlockBuilder
 {
 private:
-    // std::unordered_map<SSAPredicate *, BasicBlock*> predicateBlockMap;
-    BasicBlock *entryBlock;
-    BasicBlock *trueBlock;
+    BasicBlock *current;
+    // Continuation of the open predicate region, or null while unguarded.
+    BasicBlock *join = nullptr;
     SSAPredicate *activePredicate;
-    BasicBlock *last;
     Function *currentFunction;
     ValueToValueMapTy *VMap;
+    LoweredDominance *dominance;
+    // Values of the predicates materialized so far, with the block each was
+    // emitted in. Predicates share sub-predicates, so a value emitted in a
+    // block that dominates the requesting one is reused rather than emitted
+    // again for every predicate that refers to it.
+    std::unordered_map<SSAPredicate *, std::vector<std::pair<BasicBlock *, Value *>>> materialized;
+
+    BasicBlock *createBlock(const char *name, BasicBlock *idom)
+    {
+        BasicBlock *block = BasicBlock::Create(currentFunction->getContext(), name, currentFunction);
+        dominance->add(block, idom);
+        return block;
+    }
+
+    Value *remap(Value *value)
+    {
+        auto it = VMap->find(value);
+        return it != VMap->end() ? (Value *)it->second : value;
+    }
 
 public:
-    BlockBuilder(llvm::BasicBlock *entry, ValueToValueMapTy *vmap)
-        : entryBlock(entry), last(entry), trueBlock(entry), currentFunction(entry->getParent()), VMap(vmap)
+    BlockBuilder(llvm::BasicBlock *entry, ValueToValueMapTy *vmap, LoweredDominance *dominance)
+        : current(entry), currentFunction(entry->getParent()), VMap(vmap), dominance(dominance)
     {
         activePredicate = new SSAPredicate();
         activePredicate->kind = SSAPredicate::True;
     }
 
-    BasicBlock *get_block(SSAPredicate *pred)
+    // Emits the i1 value of `pred` at the end of `block`. And/Or use selects so
+    // a condition that was never computed on the current path cannot leak
+    // poison into the result.
+    Value *materialize(SSAPredicate *pred, BasicBlock *block)
     {
-        // Simplified version without caching for expediency
-        if (predicatesEqual(pred, activePredicate))
-        {
-            return last;
-        }
-        if (pred->kind == SSAPredicate::True)
-        {
-            return last;
-        }
-        BasicBlock *newBlock = BasicBlock::Create(entryBlock->getContext(),
-                                                  "pred_block",
-                                                  currentFunction);
-        BasicBlock *newTrue = BasicBlock::Create(entryBlock->getContext(),
-                                                 "true_block",
-                                                 currentFunction);
-
+        IRBuilder<> builder(block);
         switch (pred->kind)
         {
+        case SSAPredicate::True:
+            return builder.getTrue();
         case SSAPredicate::Condition:
-        {
-            Value *remapped_cond;
-            auto it = VMap->find(pred->condition);
-            if (it != VMap->end())
-            {
-                remapped_cond = (Value *)it->second;
-            }
-            else
-            {
-                remapped_cond = pred->condition;
-            }
-            //errs() << "Condition is " << *remapped_cond << "\n";
-            if(!last->getTerminator()) BranchInst::Create(newBlock, newTrue, remapped_cond, last);
-            if(!trueBlock->getTerminator()) BranchInst::Create(newBlock, newTrue, remapped_cond, trueBlock);
-            last = newBlock;
-            trueBlock = newTrue;
-            return last;
+            return remap(pred->condition);
+        default:
             break;
         }
-        case SSAPredicate::Not:
+
+        auto &values = materialized[pred];
+        for (auto it = values.rbegin(); it != values.rend(); ++it)
         {
-            SSAPredicate *inner = pred->left;
-            get_block(inner);
-            return trueBlock;
-            break;
+            if (it->first == block || dominance->dominates(it->first, block))
+                return it->second;
         }
-        case SSAPredicate::And:
+        Value *value;
+        if (pred->kind == SSAPredicate::Not)
         {
-            BasicBlock *leftBlock = get_block(pred->left);
-            BasicBlock *rightBlock = get_block(pred->right);
-            if (!rightBlock->getTerminator()) BranchInst::Create(newBlock, rightBlock);
-            last = newBlock;
-            return newBlock;
-            break;
+            value = builder.CreateNot(materialize(pred->left, block));
         }
-        case SSAPredicate::Or:
+        else
         {
-            BasicBlock *leftBlock = get_block(pred->left);
-            BasicBlock *rightBlock = get_block(pred->right);
-            if (!leftBlock->getTerminator()) BranchInst::Create(newBlock, leftBlock);
-            if (!rightBlock->getTerminator()) BranchInst::Create(newBlock, rightBlock);
-            last = newBlock;
-            return newBlock;
-            break;
-        }
-        default:
-            break;
+            Value *left = materialize(pred->left, block);
+            Value *right = materialize(pred->right, block);
+            if (pred->kind == SSAPredicate::And)
+                value = builder.CreateSelect(left, right, builder.getFalse());
+            else
+                value = builder.CreateSelect(left, builder.getTrue(), right);
         }
+        values.push_back({block, value});
+        return value;
+    }
 
-        return last;
+    // Returns the block items guarded by `pred` go into. Consecutive items with
+    // equal predicates share one region; a change of predicate closes the open
+    // region and branches around a fresh one.
+    BasicBlock *get_block(SSAPredicate *pred)
+    {
+        if (pred && !predicatesEqual(pred, activePredicate))
+        {
+            close();
+            if (pred->kind != SSAPredicate::True)
+            {
+                Value *cond = materialize(pred, current);
+                BasicBlock *predBlock = createBlock("pred_block", current);
+                join = createBlock("join_block", current);
+                BranchInst::Create(predBlock, join, cond, current);
+                current = predBlock;
+                activePredicate = pred;
+            }
+        }
+        return openBlock();
     }
 
-    void append(BasicBlock *block, SSAPredicate *pred)
+    // Returns the block for items under `pred` without branching: the open
+    // region when `pred` implies its predicate, else the unguarded code
+    // after it. Items placed there run whether or not `pred` holds.
+    BasicBlock *speculation_block(SSAPredicate *pred)
     {
-        BasicBlock *predBlock = get_block(pred);
-        if(!predBlock->getTerminator()) BranchInst::Create(block, predBlock);
-        last = block;
+        if (!impliesPredicate(pred, activePredicate))
+            close();
+        return openBlock();
     }
 
-    BasicBlock *getTrueBlock()
+    BasicBlock *openBlock()
     {
-        return trueBlock;
+        if (current->getTerminator())
+        {
+            // Whatever follows a return on this path is dead.
+            current = createBlock("dead_block", nullptr);
+        }
+        return current;
     }
 
-    void seal_off(BasicBlock *target)
+    // Ends the open predicate region, if any, and returns the block that
+    // unguarded code continues in.
+    BasicBlock *close()
     {
-        for (auto &block : *currentFunction)
+        if (join)
         {
-            if (!block.getTerminator())
-            {
-                BranchInst::Create(target, &block);
-            }
+            if (!current->getTerminator())
+                BranchInst::Create(join, current);
+            current = join;
+            join = nullptr;
+            activePredicate = new SSAPredicate();
+            activePredicate->kind = SSAPredicate::True;
         }
+        return current;
+    }
+
+    bool inRegion(SSAPredicate *pred)
+    {
+        return pred && predicatesEqual(pred, activePredicate);
+    }
+
+    // Continues the active region in `block`, e.g. the exit of a lowered loop.
+    void continueIn(BasicBlock *block)
+    {
+        current = block;
     }
 };
 
@@ -160,77 +294,94 @@ class SSAPredicatedSSAConverter
 private:
     llvm::Function &llvmFunc;
     llvm::DominatorTree DT;
-    llvm::PostDominatorTree PDT;
     llvm::LoopInfo LI;
     ValueToValueMapTy VMap;
 
-    std::unordered_map<llvm::BasicBlock *, SSAPredicate *> predicateCache;
+    PredicateSimplifier simplifier;
 
     SSAPredicate *simplifyPredicate(SSAPredicate *pred)
     {
-        if (!pred)
-        {
-            SSAPredicate *truePred = new SSAPredicate();
-            truePred->kind = SSAPredicate::True;
-            return truePred;
-        }
+        return simplifier.simplify(pred);
+    }
 
-        switch (pred->kind)
-        {
-        case SSAPredicate::And:
-        case SSAPredicate::Or:
-        {
-            pred->left = simplifyPredicate(pred->left);
-            pred->right = simplifyPredicate(pred->right);
+    SSAPredicate *truth()
+    {
+        SSAPredicate *truth = new SSAPredicate();
+        truth->kind = SSAPredicate::True;
+        return truth;
+    }
 
-            if (pred->kind == SSAPredicate::And)
-            {
-                if (pred->left->kind == SSAPredicate::True)
-                {
-                    return pred->right;
-                }
-                if (pred->right->kind == SSAPredicate::True)
-                {
-                    return pred->left;
-                }
-            }
-            else if (pred->kind == SSAPredicate::Or)
-            {
-                if (pred->left->kind == SSAPredicate::True ||
-                    pred->right->kind == SSAPredicate::True)
-                {
-                    SSAPredicate *truePred = new SSAPredicate();
-                    truePred->kind = SSAPredicate::True;
-                    return truePred;
-                }
-                if (predicatesEqual(pred->left, pred->right))
-                {
-                    return pred->left;
-                }
-            }
-            break;
-        }
+    SSAPredicate *literal(Value *cond, bool polarity)
+    {
+        SSAPredicate *condition = new SSAPredicate();
+        condition->kind = SSAPredicate::Kind::Condition;
+        condition->condition = cond;
+        return polarity ? condition : negation(condition);
+    }
 
-        case SSAPredicate::Not:
-            pred->left = simplifyPredicate(pred->left);
-            if (pred->left->kind == SSAPredicate::Not)
-            {
-                return pred->left->left;
-            }
-            break;
+    SSAPredicate *negation(SSAPredicate *pred)
+    {
+        SSAPredicate *no = new SSAPredicate();
+        no->kind = SSAPredicate::Kind::Not;
+        no->left = pred;
+        return no;
+    }
 
-        default:
-            break;
-        }
+    // Conjunction and disjunction that fold constants but otherwise keep
+    // their operands as they are, so block predicates share sub-predicates.
+    SSAPredicate *conjoin(SSAPredicate *a, SSAPredicate *b)
+    {
+        if (PredicateSimplifier::isTrue(a) || PredicateSimplifier::isFalse(b))
+            return b;
+        if (PredicateSimplifier::isTrue(b) || PredicateSimplifier::isFalse(a))
+            return a;
+        SSAPredicate *pred = new SSAPredicate();
+        pred->kind = SSAPredicate::And;
+        pred->left = a;
+        pred->right = b;
+        return pred;
+    }
 
+    SSAPredicate *disjoin(SSAPredicate *a, SSAPredicate *b)
+    {
+        if (!a || PredicateSimplifier::isFalse(a) || PredicateSimplifier::isTrue(b))
+            return b;
+        if (PredicateSimplifier::isFalse(b) || PredicateSimplifier::isTrue(a))
+            return a;
+        SSAPredicate *pred = new SSAPredicate();
+        pred->kind = SSAPredicate::Or;
+        pred->left = a;
+        pred->right = b;
         return pred;
     }
 
-    SSAPredicate *truth()
+    // Switches get one `icmp eq` per case, inserted before the terminator so
+    // they are converted like any other instruction. Edge (switch, succ)
+    // holds when a case targeting succ matches, or no case does and succ is
+    // the default.
+    std::unordered_map<BasicBlock *, std::unordered_map<BasicBlock *, SSAPredicate *>> switchEdges;
+
+    void prepareSwitches()
     {
-        SSAPredicate *truth = new SSAPredicate();
-        truth->kind = SSAPredicate::True;
-        return truth;
+        for (auto &BB : llvmFunc)
+        {
+            auto *SI = dyn_cast<SwitchInst>(BB.getTerminator());
+            if (!SI)
+                continue;
+            auto &edges = switchEdges[&BB];
+            SSAPredicate *anyCase = nullptr;
+            for (auto &c : SI->cases())
+            {
+                auto *cmp = new ICmpInst(SI, ICmpInst::ICMP_EQ, SI->getCondition(), c.getCaseValue(), "case");
+                SSAPredicate *match = literal(cmp, true);
+                edges[c.getCaseSuccessor()] = disjoin(edges[c.getCaseSuccessor()], match);
+                anyCase = disjoin(anyCase, match);
+            }
+            SSAPredicate *noCase = anyCase ? simplifyPredicate(negation(anyCase)) : truth();
+            edges[SI->getDefaultDest()] = disjoin(edges[SI->getDefaultDest()], noCase);
+            for (auto &edge : edges)
+                edge.second = simplifyPredicate(edge.second);
+        }
     }
 
     SSAPredicate *edgeCondition(BasicBlock *b1, BasicBlock *b2)
@@ -239,141 +390,300 @@ private:
 
         if (llvm::BranchInst *br = llvm::dyn_cast<llvm::BranchInst>(term))
         {
-            for (unsigned i = 0; i < br->getNumSuccessors(); ++i)
-            {
-                if (br->getSuccessor(i) == b2 && br->isConditional())
-                {
-                    SSAPredicate *condition = new SSAPredicate();
-                    condition->kind = SSAPredicate::Kind::Condition;
-                    condition->condition = br->getCondition();
-                    if (i > 0)
-                    {
-                        SSAPredicate *no = new SSAPredicate();
-                        no->kind = SSAPredicate::Kind::Not;
-                        no->left = condition;
-                        return no;
-                    }
-                    else
-                    {
-                        return condition;
-                    }
-                }
-            }
+            if (br->isConditional() && br->getSuccessor(0) != br->getSuccessor(1))
+                return simplifyPredicate(literal(br->getCondition(), br->getSuccessor(0) == b2));
         }
+        auto it = switchEdges.find(b1);
+        if (it != switchEdges.end())
+            return it->second.at(b2);
         return truth();
     }
 
-    SSAPredicate *getEdgePredicate(BasicBlock *from, BasicBlock *to)
+    // Control-dependence predicates. Every loop body, and the function body,
+    // is a region whose entry is the loop header (resp. the entry block) and
+    // whose nodes are its own blocks plus one node per immediate sub-loop,
+    // represented by the sub-loop header. Back edges are dropped and edges
+    // leaving the region go to a virtual exit, which makes the region graph
+    // acyclic. A node's predicate, relative to one execution of the region,
+    // is the disjunction over the edges it is control dependent on of
+    // (predicate of the edge source && edge condition). Control dependence
+    // comes from post-dominators of the region graph, computed in one pass
+    // in reverse topological order. Nodes with the same dependences share
+    // one predicate object, so a predicate is built once per distinct set of
+    // dependences and only refers to already built ones.
+    std::unordered_map<BasicBlock *, SSAPredicate *> blockPredicates;
+    std::unordered_map<Loop *, SSAPredicate *> loopPredicates;
+    std::map<std::tuple<Loop *, BasicBlock *, BasicBlock *>, SSAPredicate *> edgePredicates;
+
+    // Nodes of every region in reverse post-order, and the exit edges of
+    // every loop, both gathered in one pass over the CFG. A loop's header
+    // is the first node of its own region and stands for the whole loop in
+    // its parent's.
+    std::unordered_map<Loop *, std::vector<BasicBlock *>> regionBlocks;
+    std::unordered_map<Loop *, std::vector<std::pair<BasicBlock *, BasicBlock *>>> exitEdges;
+
+    void collectRegions()
     {
-        Loop *loop = LI.getLoopFor(from);
-        if (!loop)
+        ReversePostOrderTraversal<Function *> RPOT(&llvmFunc);
+        for (BasicBlock *BB : RPOT)
         {
-            return edgeCondition(from, to);
+            Loop *L = LI.getLoopFor(BB);
+            if (L && L->getHeader() == BB)
+                regionBlocks[L->getParentLoop()].push_back(BB);
+            regionBlocks[L].push_back(BB);
+
+            for (BasicBlock *succ : successors(BB))
+            {
+                for (Loop *exited = L; exited && !exited->contains(succ); exited = exited->getParentLoop())
+                    exitEdges[exited].push_back({BB, succ});
+            }
         }
-        if (DT.dominates(to, from))
+    }
+
+    // Node of region L that holds B, or null when B is outside L.
+    BasicBlock *regionNode(Loop *L, BasicBlock *B)
+    {
+        if (L && !L->contains(B))
+            return nullptr;
+        Loop *inner = LI.getLoopFor(B);
+        if (inner == L)
+            return B;
+        while (inner->getParentLoop() != L)
+            inner = inner->getParentLoop();
+        return inner->getHeader();
+    }
+
+    Loop *childLoop(Loop *L, BasicBlock *node)
+    {
+        Loop *inner = LI.getLoopFor(node);
+        return inner != L ? inner : nullptr;
+    }
+
+    SSAPredicate *nodePredicate(Loop *L, BasicBlock *node)
+    {
+        if (Loop *child = childLoop(L, node))
+            return loopPredicates.at(child);
+        return blockPredicates.at(node);
+    }
+
+    // Predicate, relative to one execution of region L, that control flows
+    // along from -> to, where `from` is anywhere inside L. Edges leaving a
+    // sub-loop are taken on its last iteration.
+    SSAPredicate *relativeEdge(Loop *L, BasicBlock *from, BasicBlock *to)
+    {
+        auto key = std::make_tuple(L, from, to);
+        auto it = edgePredicates.find(key);
+        if (it != edgePredicates.end())
+            return it->second;
+
+        BasicBlock *node = regionNode(L, from);
+        SSAPredicate *inner;
+        if (Loop *child = childLoop(L, node))
+            inner = relativeEdge(child, from, to);
+        else
+            inner = edgeCondition(from, to);
+        SSAPredicate *result = conjoin(nodePredicate(L, node), inner);
+        edgePredicates[key] = result;
+        return result;
+    }
+
+    struct RegionEdge
+    {
+        BasicBlock *target; // null for the virtual exit
+        SSAPredicate *condition;
+    };
+
+    std::vector<RegionEdge> regionSuccessors(Loop *L, BasicBlock *node)
+    {
+        std::vector<RegionEdge> edges;
+        BasicBlock *header = L ? L->getHeader() : nullptr;
+
+        if (Loop *child = childLoop(L, node))
         {
-            return truth();
+            for (auto &exit : exitEdges[child])
+            {
+                BasicBlock *target = exit.second == header ? nullptr : regionNode(L, exit.second);
+                SSAPredicate *cond = relativeEdge(child, exit.first, exit.second);
+                auto same = std::find_if(edges.begin(), edges.end(), [&](const RegionEdge &e)
+                                         { return e.target == target; });
+                if (same != edges.end())
+                    same->condition = disjoin(same->condition, cond);
+                else
+                    edges.push_back({target, cond});
+            }
+            if (edges.size() == 1)
+                edges[0].condition = truth();
+            for (auto &edge : edges)
+                edge.condition = simplifyPredicate(edge.condition);
         }
-        if (loop->getHeader() == from && LI.getLoopFor(to) == loop)
+        else
         {
-            return truth();
+            for (BasicBlock *succ : successors(node))
+            {
+                // Back edges end the iteration, like leaving the loop.
+                BasicBlock *target = succ == header ? nullptr : regionNode(L, succ);
+                auto same = std::find_if(edges.begin(), edges.end(), [&](const RegionEdge &e)
+                                         { return e.target == target; });
+                if (same == edges.end())
+                    edges.push_back({target, edgeCondition(node, succ)});
+                else
+                    same->condition = simplifyPredicate(disjoin(same->condition, edgeCondition(node, succ)));
+            }
         }
-        Loop *toLoop = LI.getLoopFor(to);
-        llvm::SmallVector<BasicBlock *> exitBlocks;
-        loop->getExitBlocks(exitBlocks);
-        for (BasicBlock *exit : exitBlocks)
+
+        if (edges.empty())
+            edges.push_back({nullptr, truth()});
+        return edges;
+    }
+
+    void computeRegionPredicates(Loop *L)
+    {
+        BasicBlock *entry = L ? L->getHeader() : &llvmFunc.getEntryBlock();
+
+        // Post-order DFS; edges to nodes still on the stack only occur in
+        // irreducible cycles and are ignored.
+        std::vector<BasicBlock *> order;
+        std::unordered_map<BasicBlock *, std::vector<RegionEdge>> succs;
+        std::unordered_map<BasicBlock *, int> state;
+        std::vector<std::pair<BasicBlock *, size_t>> stack = {{entry, 0}};
+        state[entry] = 1;
+        succs[entry] = regionSuccessors(L, entry);
+        while (!stack.empty())
         {
-            if (exit == to)
+            auto &[node, next] = stack.back();
+            auto &edges = succs[node];
+            if (next == edges.size())
             {
-                //errs() << "Exit edge from loop found: " << from->front() << " -> " << to->front() << "\n";
-                SSAPredicate *first = new SSAPredicate();
-                SSAPredicate *second = new SSAPredicate();
-                first->kind = SSAPredicate::Kind::And;
-                second->kind = SSAPredicate::Kind::And;
-                second->left = simplifyPredicate(getControlPredicate(from));
-                second->right = simplifyPredicate(edgeCondition(from, to));
-                first->left = simplifyPredicate(getControlPredicate(loop->getLoopPreheader()));
-                first->right = simplifyPredicate(second);
-                return first;
+                state[node] = 2;
+                order.push_back(node);
+                stack.pop_back();
+                continue;
             }
+            BasicBlock *target = edges[next++].target;
+            if (!target || state.count(target))
+                continue;
+            state[target] = 1;
+            succs[target] = regionSuccessors(L, target);
+            stack.push_back({target, 0});
         }
+        std::reverse(order.begin(), order.end());
 
-        if (to->getSinglePredecessor() == from)
+        // Topological numbering; the virtual exit comes last.
+        int exitIndex = order.size();
+        std::unordered_map<BasicBlock *, int> index;
+        for (int i = 0; i < exitIndex; i++)
+            index[order[i]] = i;
+        auto indexOf = [&](BasicBlock *node)
+        { return node ? index.at(node) : exitIndex; };
+
+        struct Edge
+        {
+            int from;
+            int to;
+            SSAPredicate *condition;
+        };
+        std::vector<Edge> edges;
+        for (int i = 0; i < exitIndex; i++)
         {
-            SSAPredicate *edgePred = edgeCondition(from, to);
-            if (edgePred->kind == SSAPredicate::True)
+            for (auto &edge : succs[order[i]])
             {
-                return getControlPredicate(from);
+                int to = indexOf(edge.target);
+                if (to > i)
+                    edges.push_back({i, to, edge.condition});
             }
-            else
+        }
+
+        // Post-dominators: a node's post-dominators come after it in every
+        // topological order, so visiting nodes backwards sees final ipdoms.
+        std::vector<int> ipdom(exitIndex + 1, exitIndex);
+        auto intersect = [&](int a, int b)
+        {
+            while (a != b)
             {
-                SSAPredicate *first = new SSAPredicate();
-                first->kind = SSAPredicate::Kind::And;
-                first->left = simplifyPredicate(getControlPredicate(from));
-                first->right = simplifyPredicate(edgePred);
-                return first;
+                if (a < b)
+                    a = ipdom[a];
+                else
+                    b = ipdom[b];
             }
+            return a;
+        };
+        for (int e = static_cast<int>(edges.size()) - 1; e >= 0;)
+        {
+            int from = edges[e].from;
+            int result = edges[e].to;
+            for (; e >= 0 && edges[e].from == from; e--)
+                result = intersect(result, edges[e].to);
+            ipdom[from] = result;
         }
 
-        SSAPredicate *first = new SSAPredicate();
-        first->kind = SSAPredicate::Kind::And;
-        first->left = simplifyPredicate(getControlPredicate(from));
-        first->right = simplifyPredicate(edgeCondition(from, to));
-        return first;
-    }
-
-    SSAPredicate *getControlPredicate(llvm::BasicBlock *BB)
-    {
-        auto it = predicateCache.find(BB);
-        if (it != predicateCache.end())
+        // Control dependences: the targets of edge a -> s up to, excluding,
+        // the ipdom of a depend on that edge.
+        std::vector<std::vector<int>> dependences(exitIndex);
+        for (int e = 0; e < edges.size(); e++)
         {
-            return it->second;
+            for (int runner = edges[e].to; runner != ipdom[edges[e].from]; runner = ipdom[runner])
+                dependences[runner].push_back(e);
         }
-        std::vector<SSAPredicate *> preds;
-        for (auto pred : predecessors(BB))
+
+        std::map<std::vector<int>, SSAPredicate *> shared;
+        std::vector<SSAPredicate *> predicates(exitIndex);
+        for (int i = 0; i < exitIndex; i++)
         {
-            SSAPredicate *edgePred = edgeCondition(pred, BB);
-            if (edgePred->kind != SSAPredicate::True)
-            {
-                preds.push_back(edgePred);
-            }
-            else
+            SSAPredicate *pred = truth();
+            if (!dependences[i].empty())
             {
-                SSAPredicate *predPred = getControlPredicate(pred);
-                if (predPred->kind != SSAPredicate::True)
+                auto it = shared.find(dependences[i]);
+                if (it != shared.end())
                 {
-                    preds.push_back(predPred);
+                    pred = it->second;
                 }
                 else
                 {
-                    SSAPredicate *truePred = new SSAPredicate();
-                    truePred->kind = SSAPredicate::True;
-                    predicateCache[BB] = truePred;
-                    return truePred;
+                    pred = nullptr;
+                    for (int e : dependences[i])
+                        pred = disjoin(pred, conjoin(predicates[edges[e].from], edges[e].condition));
+                    // The simplifier builds one node per distinct predicate,
+                    // so a single dependence still shares the predicate of
+                    // its source, and gates reuse block predicates.
+                    pred = simplifyPredicate(pred);
+                    shared[dependences[i]] = pred;
                 }
             }
+            predicates[i] = pred;
+
+            if (Loop *child = childLoop(L, order[i]))
+                loopPredicates[child] = pred;
+            else
+                blockPredicates[order[i]] = pred;
         }
-        if (preds.empty())
-        {
-            SSAPredicate *truePred = new SSAPredicate();
-            truePred->kind = SSAPredicate::True;
-            predicateCache[BB] = truePred;
-            return truePred;
-        }
-        SSAPredicate *result = preds[0];
-        for (size_t i = 1; i < preds.size(); ++i)
-        {
-            SSAPredicate *orPred = new SSAPredicate();
-            orPred->kind = SSAPredicate::Or;
-            orPred->left = result;
-            orPred->right = preds[i];
-            result = simplifyPredicate(orPred);
-        }
-        predicateCache[BB] = result;
-        return result;
+
+    }
+
+    void computePredicates()
+    {
+        prepareSwitches();
+        collectRegions();
+        // Inner regions first: a sub-loop's exit conditions are built from
+        // predicates relative to its own body.
+        auto loops = LI.getLoopsInPreorder();
+        for (auto it = loops.rbegin(); it != loops.rend(); ++it)
+            computeRegionPredicates(*it);
+        computeRegionPredicates(nullptr);
+
+        // Blocks the entry cannot reach never run. Loops only hold
+        // reachable blocks, so these are all at function level.
+        for (auto &BB : llvmFunc)
+            blockPredicates.emplace(&BB, PredicateSimplifier::falsity());
+    }
+
+    // Predicate of BB relative to its innermost enclosing region.
+    SSAPredicate *getControlPredicate(llvm::BasicBlock *BB)
+    {
+        return blockPredicates.at(BB);
     }
 
     std::unordered_map<Value *, SSAValue> valueMap;
+    std::unordered_map<PHINode *, std::vector<SSAGate>> phiGates;
     std::vector<Item> processBasicBlock(BasicBlock *BB, SSAPredicate *pred)
     {
         std::vector<Item> items;
@@ -386,10 +696,42 @@ private:
             item.Predicate = pred;
             items.push_back(item);
             valueMap[&I] = &I;
+
+            auto *phi = dyn_cast<PHINode>(&I);
+            if (phi && !LI.isLoopHeader(BB))
+            {
+                auto &gates = phiGates[phi];
+                for (unsigned i = 0; i < phi->getNumIncomingValues(); i++)
+                {
+                    SSAPredicate *gate = relativeEdge(LI.getLoopFor(BB), phi->getIncomingBlock(i), BB);
+                    gates.push_back({simplifyPredicate(gate), phi->getIncomingValue(i)});
+                }
+            }
         }
         return items;
     }
 
+    // Items of a region in reverse post-order of its blocks; a sub-loop
+    // becomes one loop item where its header would be.
+    void processRegion(Loop *L, std::vector<Item> &items)
+    {
+        for (BasicBlock *BB : regionBlocks[L])
+        {
+            if (Loop *child = childLoop(L, BB))
+            {
+                Item loopItem;
+                loopItem.content = processLoop(child);
+                loopItem.Predicate = loopPredicates.at(child);
+                items.push_back(loopItem);
+            }
+            else
+            {
+                auto blockItems = processBasicBlock(BB, getControlPredicate(BB));
+                items.insert(items.end(), blockItems.begin(), blockItems.end());
+            }
+        }
+    }
+
     SSALoop *processLoop(Loop *L)
     {
         SSALoop *ssaLoop = new SSALoop();
@@ -403,31 +745,14 @@ private:
             return ssaLoop;
         }
 
-        predicateCache[header] = getControlPredicate(preheader);
-        llvm::SmallVector<std::pair<BasicBlock *, BasicBlock *>> exitBlocks;
-        L->getExitEdges(exitBlocks);
-        for (std::pair<BasicBlock *, BasicBlock *> exit : exitBlocks)
+        // The loop continues unless an iteration leaves through one of its
+        // exit edges.
+        SSAPredicate *exits = nullptr;
+        for (auto &exit : exitEdges[L])
         {
-            SSAPredicate *first = getEdgePredicate(exit.first, exit.second);
-            if (ssaLoop->whileCondition == nullptr)
-            {
-                SSAPredicate *second = new SSAPredicate();
-                second->kind = SSAPredicate::Kind::Not;
-                second->left = first;
-                ssaLoop->whileCondition = simplifyPredicate(second);
-            }
-            else
-            {
-                SSAPredicate *orPred = new SSAPredicate();
-                orPred->kind = SSAPredicate::Kind::And;
-                SSAPredicate *second = new SSAPredicate();
-                second->kind = SSAPredicate::Kind::Not;
-                second->left = first;
-                orPred->left = ssaLoop->whileCondition;
-                orPred->right = second;
-                ssaLoop->whileCondition = simplifyPredicate(orPred);
-            }
+            exits = disjoin(exits, relativeEdge(L, exit.first, exit.second));
         }
+        ssaLoop->whileCondition = exits ? simplifyPredicate(negation(exits)) : truth();
 
         for (auto &I : *header)
         {
@@ -471,281 +796,713 @@ private:
                         muNode->rec = recValue;
                     }
 
+                    muNode->type = phi->getType();
+
                     SSALoop::MuBinding binding;
                     binding.variable = phi->getName().str();
                     binding.muNode = muNode;
+                    binding.phi = phi;
                     ssaLoop->muBindings.push_back(binding);
 
                     valueMap[phi] = muNode;
                 }
             }
         }
-        std::vector<BasicBlock *> loopBlocks;
-        for (auto *BB : L->blocks())
+        processRegion(L, ssaLoop->bodyItems);
+        return ssaLoop;
+    }
+
+public:
+    SSAPredicatedSSAConverter(Function &F, LazyValueInfo *LVI = nullptr)
+        : llvmFunc(F), DT(F), LI(DT), simplifier(F.getParent()->getDataLayout(), &DT, LVI)
+    {
+    }
+    SSAFunction *convertToPredicatedSSA()
+    {
+        SSAFunction *ssaFunc = new SSAFunction();
+        computePredicates();
+        processRegion(nullptr, ssaFunc->items);
+
+        ssaFunc->phiGates = std::move(phiGates);
+        return ssaFunc;
+    }
+
+    // Packs lowered as vectors, keyed by their lanes.
+    std::unordered_map<Instruction *, const VectorPack *> packOf;
+    std::unordered_set<const VectorPack *> loweredPacks;
+    std::unordered_map<const VectorPack *, Value *> packValues;
+    // Original scalar -> (vector, lane) it can be read from without extracting.
+    std::unordered_map<Value *, std::pair<Value *, unsigned>> laneSources;
+    std::unordered_map<SSAMuNode *, Value *> muValues;
+    std::unordered_set<PHINode *> boundPhis;
+
+    Value *remap(Value *value)
+    {
+        auto it = VMap.find(value);
+        return it != VMap.end() ? (Value *)it->second : value;
+    }
+
+    Value *lowerSSAValue(const SSAValue &value)
+    {
+        if (auto mu = std::get_if<SSAMuNode *>(&value))
         {
-            loopBlocks.push_back(BB);
+            auto it = muValues.find(*mu);
+            return it != muValues.end() ? it->second : nullptr;
         }
+        return remap(std::get<llvm::Value *>(value));
+    }
 
-        for (auto *BB : loopBlocks)
+    // Builds the `width`-lane vector whose lane i holds scalars[i], reusing an
+    // existing vector when the scalars already live in its lanes in order,
+    // broadcasting when every lane holds the same scalar and shuffling when
+    // the scalars all live in one or two vectors. Lanes past the scalars are
+    // padding and stay poison.
+    Value *gatherLanes(const std::vector<Value *> &scalars, unsigned width, IRBuilder<> &builder)
+    {
+        auto it = laneSources.find(scalars[0]);
+        if (it != laneSources.end())
         {
-            if (LI.getLoopFor(BB) == L && LI.isLoopHeader(BB) && BB != header)
+            Value *vector = it->second.first;
+            bool reuse = cast<FixedVectorType>(vector->getType())->getNumElements() == width;
+            for (unsigned lane = 0; reuse && lane < scalars.size(); lane++)
             {
-                for (auto *subLoop : LI)
-                {
-                    if (subLoop->getHeader() == BB && subLoop->getParentLoop() == L)
-                    {
-                        SSALoop *nestedLoop = processLoop(subLoop);
-                        Item loopItem;
-                        loopItem.content = nestedLoop;
-                        loopItem.Predicate = getControlPredicate(BB);
-                        ssaLoop->bodyItems.push_back(loopItem);
-
-                        std::unordered_set<BasicBlock *> nestedBlocks(
-                            subLoop->block_begin(), subLoop->block_end());
-                        auto it = std::remove_if(loopBlocks.begin(), loopBlocks.end(),
-                                                 [&](BasicBlock *b)
-                                                 { return nestedBlocks.count(b); });
-                        loopBlocks.erase(it, loopBlocks.end());
-                        break;
-                    }
-                }
+                auto laneIt = laneSources.find(scalars[lane]);
+                reuse = laneIt != laneSources.end() && laneIt->second.first == vector && laneIt->second.second == lane;
             }
-            else
+            if (reuse)
+                return vector;
+        }
+
+        if (std::all_of(scalars.begin(), scalars.end(), [&](Value *scalar) { return scalar == scalars[0]; }))
+            return splat(width, remap(scalars[0]), builder);
+        if (Value *shuffled = shuffleLanes(scalars, width, builder))
+            return shuffled;
+
+        // Constant lanes start out in a constant vector; only the others are
+        // inserted.
+        std::vector<Constant *> constants;
+        for (Value *scalar : scalars)
+        {
+            auto *constant = dyn_cast<Constant>(remap(scalar));
+            constants.push_back(constant ? constant : PoisonValue::get(scalar->getType()));
+        }
+        constants.resize(width, PoisonValue::get(scalars[0]->getType()));
+        Value *vector = ConstantVector::get(constants);
+        for (unsigned lane = 0; lane < scalars.size(); lane++)
+        {
+            if (!isa<Constant>(remap(scalars[lane])))
+                vector = builder.CreateInsertElement(vector, remap(scalars[lane]), builder.getInt32(lane));
+        }
+        return vector;
+    }
+
+    // One shufflevector picking every lane out of at most two vectors of the
+    // same type, e.g. the x fields out of two vectors of {x, y} pairs; null
+    // when the scalars are spread wider.
+    Value *shuffleLanes(const std::vector<Value *> &scalars, unsigned width, IRBuilder<> &builder)
+    {
+        Value *sources[2] = {nullptr, nullptr};
+        std::vector<int> mask(width, UndefMaskElem);
+        for (unsigned lane = 0; lane < scalars.size(); lane++)
+        {
+            auto it = laneSources.find(scalars[lane]);
+            if (it == laneSources.end())
+                return nullptr;
+            auto [vector, sourceLane] = it->second;
+            unsigned source = 0;
+            while (source < 2 && sources[source] && sources[source] != vector)
+                source++;
+            if (source == 2 || (sources[0] && vector->getType() != sources[0]->getType()))
+                return nullptr;
+            sources[source] = vector;
+            mask[lane] = source * cast<FixedVectorType>(vector->getType())->getNumElements() + sourceLane;
+        }
+        return builder.CreateShuffleVector(sources[0], sources[1] ? sources[1] : PoisonValue::get(sources[0]->getType()),
+                                           mask);
+    }
+
+    // Preheaders of the loops being lowered, outermost first.
+    std::vector<BasicBlock *> preheaders;
+    std::map<std::tuple<Value *, unsigned, BasicBlock *>, Value *> splats;
+
+    // Broadcasts `scalar` into every lane. A value that does not change inside
+    // the enclosing loops is broadcast once, in the preheader of the outermost
+    // loop it is available in, and shared by every pack that needs it.
+    Value *splat(unsigned lanes, Value *scalar, IRBuilder<> &builder)
+    {
+        if (isa<Constant>(scalar))
+            return builder.CreateVectorSplat(lanes, scalar);
+
+        auto *def = dyn_cast<Instruction>(scalar);
+        for (BasicBlock *preheader : preheaders)
+        {
+            if (def && !dominance.dominates(def->getParent(), preheader))
+                continue;
+            Value *&vector = splats[{scalar, lanes, preheader}];
+            if (!vector)
             {
-                SSAPredicate *blockPred = getControlPredicate(BB);
-                auto items = processBasicBlock(BB, blockPred);
-                ssaLoop->bodyItems.insert(ssaLoop->bodyItems.end(), items.begin(), items.end());
+                IRBuilder<> hoisted(preheader->getTerminator());
+                vector = hoisted.CreateVectorSplat(lanes, scalar);
             }
+            return vector;
         }
+        return builder.CreateVectorSplat(lanes, scalar);
+    }
 
-        return ssaLoop;
+    // Enables the lanes of a padded pack and none of its padding.
+    static Constant *laneMask(const VectorPack *pack, LLVMContext &ctx)
+    {
+        std::vector<Constant *> lanes(pack->width(), ConstantInt::getFalse(ctx));
+        std::fill_n(lanes.begin(), pack->instructions.size(), ConstantInt::getTrue(ctx));
+        return ConstantVector::get(lanes);
     }
 
-public:
-    SSAPredicatedSSAConverter(Function &F)
-        : llvmFunc(F), DT(F), PDT(F), LI(DT)
+    // Enables lane i * stride for every lane i of a strided pack.
+    static Constant *memberMask(const VectorPack *pack, LLVMContext &ctx)
     {
+        std::vector<Constant *> lanes(pack->stride * pack->instructions.size(), ConstantInt::getFalse(ctx));
+        for (unsigned lane = 0; lane < pack->instructions.size(); lane++)
+            lanes[lane * pack->stride] = ConstantInt::getTrue(ctx);
+        return ConstantVector::get(lanes);
     }
-    SSAFunction *convertToPredicatedSSA()
+
+    static bool producesVector(const VectorPack *pack)
     {
-        SSAFunction *ssaFunc = new SSAFunction();
-        std::vector<BasicBlock *> topLevelBlocks;
-        std::unordered_set<BasicBlock *> skips;
-        for (auto &BB : llvmFunc)
+        Instruction *first = pack->instructions[0];
+        if (isa<LoadInst>(first))
+            return pack->contiguous || pack->stride;
+        return isa<BinaryOperator>(first) || isa<CallInst>(first);
+    }
+
+    void cloneInto(Instruction *inst, BasicBlock *block)
+    {
+        Instruction *clone = inst->clone();
+        VMap[inst] = clone;
+        RemapInstruction(clone, VMap, RF_NoModuleLevelChanges);
+        block->getInstList().push_back(clone);
+    }
+
+    // Emits `pack` as a single vector instruction at the end of `block`.
+    // Strided memory packs access their whole interleaved group: one wide load
+    // and a shuffle picking out the members, or a shuffle spreading the lanes
+    // over the group and a store masked to the members. The wide load is
+    // masked too unless the whole group is known to be dereferenceable. Other
+    // memory packs whose lanes are not contiguous are emitted lane by lane.
+    // Call packs become a vector intrinsic or a call of a vector variant.
+    void lowerPack(const VectorPack *pack, BasicBlock *block)
+    {
+        loweredPacks.insert(pack);
+        const auto &insts = pack->instructions;
+        Instruction *first = insts[0];
+        IRBuilder<> builder(block);
+
+        Value *vector = nullptr;
+        if (auto *load = dyn_cast<LoadInst>(first))
+        {
+            if (pack->contiguous)
+            {
+                auto *type = FixedVectorType::get(load->getType(), pack->width());
+                Value *ptr = builder.CreateBitCast(remap(load->getPointerOperand()),
+                                                   type->getPointerTo(load->getPointerAddressSpace()));
+                if (pack->padded)
+                    vector = builder.CreateMaskedLoad(type, ptr, load->getAlign(), laneMask(pack, block->getContext()));
+                else
+                    vector = builder.CreateAlignedLoad(type, ptr, load->getAlign());
+            }
+            else if (pack->stride)
+            {
+                auto *type = FixedVectorType::get(load->getType(), pack->stride * insts.size());
+                Value *ptr = builder.CreateBitCast(remap(load->getPointerOperand()),
+                                                   type->getPointerTo(load->getPointerAddressSpace()));
+                const DataLayout &DL = block->getModule()->getDataLayout();
+                Value *group;
+                if (isDereferenceableAndAlignedPointer(ptr, type, load->getAlign(), DL))
+                    group = builder.CreateAlignedLoad(type, ptr, load->getAlign());
+                else
+                    group = builder.CreateMaskedLoad(type, ptr, load->getAlign(), memberMask(pack, block->getContext()));
+                vector = builder.CreateShuffleVector(group, createStrideMask(0, pack->stride, insts.size()));
+            }
+        }
+        else if (auto *store = dyn_cast<StoreInst>(first))
+        {
+            if (pack->contiguous)
+            {
+                std::vector<Value *> values;
+                for (auto *inst : insts)
+                    values.push_back(cast<StoreInst>(inst)->getValueOperand());
+                Value *data = gatherLanes(values, pack->width(), builder);
+                Value *ptr = builder.CreateBitCast(remap(store->getPointerOperand()),
+                                                   data->getType()->getPointerTo(store->getPointerAddressSpace()));
+                if (pack->padded)
+                    builder.CreateMaskedStore(data, ptr, store->getAlign(), laneMask(pack, block->getContext()));
+                else
+                    builder.CreateAlignedStore(data, ptr, store->getAlign());
+                return;
+            }
+            if (pack->stride)
+            {
+                std::vector<Value *> values;
+                for (auto *inst : insts)
+                    values.push_back(cast<StoreInst>(inst)->getValueOperand());
+                Value *data = gatherLanes(values, insts.size(), builder);
+                std::vector<int> spread(pack->stride * insts.size(), UndefMaskElem);
+                for (unsigned lane = 0; lane < insts.size(); lane++)
+                    spread[lane * pack->stride] = lane;
+                Value *group = builder.CreateShuffleVector(data, spread);
+                Value *ptr = builder.CreateBitCast(remap(store->getPointerOperand()),
+                                                   group->getType()->getPointerTo(store->getPointerAddressSpace()));
+                builder.CreateMaskedStore(group, ptr, store->getAlign(), memberMask(pack, block->getContext()));
+                return;
+            }
+        }
+        else if (isa<BinaryOperator>(first))
         {
-            topLevelBlocks.push_back(&BB);
+            std::vector<Value *> lhs, rhs;
+            for (unsigned lane = 0; lane < insts.size(); lane++)
+            {
+                bool swap = lane < pack->swapped.size() && pack->swapped[lane];
+                lhs.push_back(insts[lane]->getOperand(swap ? 1 : 0));
+                rhs.push_back(insts[lane]->getOperand(swap ? 0 : 1));
+            }
+            Value *left = gatherLanes(lhs, pack->width(), builder);
+            Value *right = gatherLanes(rhs, pack->width(), builder);
+            vector = builder.CreateBinOp(static_cast<Instruction::BinaryOps>(first->getOpcode()), left, right);
+            if (auto *vectorInst = dyn_cast<Instruction>(vector))
+            {
+                vectorInst->copyIRFlags(first);
+                for (auto *inst : insts)
+                    vectorInst->andIRFlags(inst);
+            }
         }
 
-        for (auto *BB : topLevelBlocks)
+        else if (auto *call = dyn_cast<CallInst>(first))
         {
-            if (skips.count(BB))
-                continue;
-            if (LI.isLoopHeader(BB))
+            VectorCall form = vectorCallFor(insts, pack->width(), options.TLI, options.TTI);
+            bool intrinsic = form.intrinsic != Intrinsic::not_intrinsic;
+            auto *vectorType = FixedVectorType::get(call->getType(), pack->width());
+            std::vector<Type *> overloads = {vectorType};
+            std::vector<Value *> arguments;
+            for (unsigned k = 0; k < call->arg_size(); k++)
             {
-                for (auto *L : LI)
+                if (intrinsic && isScalarOperand(form.intrinsic, k))
                 {
-                    if (L->getHeader() == BB && !L->getParentLoop())
-                    {
-                        SSALoop *loop = processLoop(L);
-                        Item loopItem;
-                        loopItem.content = loop;
-                        loopItem.Predicate = getControlPredicate(L->getLoopPreheader());
-                        ssaFunc->items.push_back(loopItem);
-                        for (auto BB : L->blocks())
-                        {
-                            skips.insert(BB);
-                        }
-                        break;
-                    }
+                    arguments.push_back(remap(call->getArgOperand(k)));
+                    if (hasVectorInstrinsicOverloadedScalarOpd(form.intrinsic, k))
+                        overloads.push_back(call->getArgOperand(k)->getType());
+                    continue;
                 }
+                std::vector<Value *> lanes;
+                for (auto *inst : insts)
+                    lanes.push_back(cast<CallInst>(inst)->getArgOperand(k));
+                arguments.push_back(gatherLanes(lanes, pack->width(), builder));
             }
-            else
-            {
-                SSAPredicate *blockPred = getControlPredicate(BB);
-                // CLEAR BELOW
-                auto items = processBasicBlock(BB, blockPred);
-                ssaFunc->items.insert(ssaFunc->items.end(), items.begin(), items.end());
-            }
+            Function *callee = intrinsic ? Intrinsic::getDeclaration(block->getModule(), form.intrinsic, overloads)
+                                         : form.variant;
+            CallInst *vectorCall = builder.CreateCall(callee, arguments);
+            vectorCall->setCallingConv(callee->getCallingConv());
+            vectorCall->copyIRFlags(first);
+            for (auto *inst : insts)
+                vectorCall->andIRFlags(inst);
+            vector = vectorCall;
         }
 
-        return ssaFunc;
+        if (!vector)
+        {
+            for (auto *inst : insts)
+                cloneInto(inst, block);
+            return;
+        }
+
+        packValues[pack] = vector;
+        for (unsigned lane = 0; lane < insts.size(); lane++)
+        {
+            VMap[insts[lane]] = builder.CreateExtractElement(vector, builder.getInt32(lane));
+            laneSources[insts[lane]] = {vector, lane};
+        }
     }
 
-    void clearPhiNode(PHINode *phi, BlockBuilder &bb)
+    PHINode *eliminateMu(SSALoop::MuBinding *binding, BasicBlock *header, BasicBlock *preheader)
     {
-        // Avoid implementing by avoiding phi nodes altogether
+        PHINode *node = PHINode::Create(binding->muNode->type, 2, binding->variable, header);
+        Value *init = lowerSSAValue(binding->muNode->init);
+        node->addIncoming(init ? init : PoisonValue::get(node->getType()), preheader);
+        muValues[binding->muNode] = node;
+        if (binding->phi)
+        {
+            VMap[binding->phi] = node;
+            boundPhis.insert(binding->phi);
+        }
+        return node;
     }
 
-    void eliminatePhiNodes(std::variant<SSAFunction *, SSALoop *> function_or_loop, BlockBuilder &bb)
+    // Mu-nodes whose recurrences are exactly the lanes of one vector pack share
+    // a single vector phi, so the loop-carried value stays in a vector register
+    // across iterations. Scalar users read their lane through an extract.
+    void eliminateMus(SSALoop *loop, BasicBlock *header, BasicBlock *preheader,
+                      std::vector<std::pair<SSALoop::MuBinding *, PHINode *>> &scalarPhis,
+                      std::vector<std::pair<const VectorPack *, PHINode *>> &vectorPhis)
     {
-        if (auto loop = std::get_if<SSALoop *>(&function_or_loop))
+        std::unordered_map<const VectorPack *, std::vector<SSALoop::MuBinding *>> lanesOf;
+        std::vector<const VectorPack *> packOrder;
+        for (auto &binding : loop->muBindings)
         {
+            auto rec = std::get_if<llvm::Value *>(&binding.muNode->rec);
+            auto *recInst = rec ? dyn_cast<Instruction>(*rec) : nullptr;
+            auto it = recInst ? packOf.find(recInst) : packOf.end();
+            if (it == packOf.end() || !producesVector(it->second))
+                continue;
+            const auto &insts = it->second->instructions;
+            auto &lanes = lanesOf[it->second];
+            if (lanes.empty())
+            {
+                lanes.resize(insts.size(), nullptr);
+                packOrder.push_back(it->second);
+            }
+            unsigned lane = std::find(insts.begin(), insts.end(), recInst) - insts.begin();
+            if (!lanes[lane])
+                lanes[lane] = &binding;
+        }
+
+        IRBuilder<> initBuilder(preheader);
+        std::vector<std::pair<PHINode *, std::vector<SSALoop::MuBinding *>>> extracts;
+        std::unordered_set<SSALoop::MuBinding *> vectorized;
+        for (const VectorPack *pack : packOrder)
+        {
+            auto &lanes = lanesOf[pack];
+            if (std::find(lanes.begin(), lanes.end(), nullptr) != lanes.end())
+                continue;
 
-            for (auto &item : (*loop)->bodyItems)
+            Value *init = PoisonValue::get(FixedVectorType::get(lanes[0]->muNode->type, pack->width()));
+            for (unsigned lane = 0; lane < lanes.size(); lane++)
             {
-                if (auto instr = std::get_if<Instruction *>(&item.content))
-                    if (auto phi = dyn_cast<PHINode>(*instr))
-                    {
-                        clearPhiNode(phi, bb);
-                    }
+                Value *laneInit = lowerSSAValue(lanes[lane]->muNode->init);
+                if (laneInit)
+                    init = initBuilder.CreateInsertElement(init, laneInit, initBuilder.getInt32(lane));
             }
+            PHINode *phi = PHINode::Create(init->getType(), 2, lanes[0]->variable + ".vec", header);
+            phi->addIncoming(init, preheader);
+            vectorPhis.push_back({pack, phi});
+            extracts.push_back({phi, lanes});
+            vectorized.insert(lanes.begin(), lanes.end());
         }
-        else if (auto function = std::get_if<SSAFunction *>(&function_or_loop))
+
+        for (auto &binding : loop->muBindings)
         {
-            for (auto &item : (*function)->items)
+            if (!vectorized.count(&binding))
+                scalarPhis.push_back({&binding, eliminateMu(&binding, header, preheader)});
+        }
+
+        // Extracts go after every phi of the header.
+        IRBuilder<> builder(header);
+        for (auto &[phi, lanes] : extracts)
+        {
+            for (unsigned lane = 0; lane < lanes.size(); lane++)
             {
-                if (auto instr = std::get_if<Instruction *>(&item.content))
-                    if (auto phi = dyn_cast<PHINode>(*instr))
-                    {
-                        clearPhiNode(phi, bb);
-                    }
+                Value *scalar = builder.CreateExtractElement(phi, builder.getInt32(lane));
+                muValues[lanes[lane]->muNode] = scalar;
+                if (lanes[lane]->phi)
+                {
+                    VMap[lanes[lane]->phi] = scalar;
+                    laneSources[lanes[lane]->phi] = {phi, lane};
+                    boundPhis.insert(lanes[lane]->phi);
+                }
             }
         }
     }
 
-    void restore_ssa(std::variant<SSAFunction *, SSALoop *> function_or_loop, BlockBuilder &bb)
+    LoweredDominance dominance;
+    LoweringOptions options;
+    const std::unordered_map<PHINode *, std::vector<SSAGate>> *functionGates = nullptr;
+
+    // A join phi picks the incoming value whose gate holds. Gates are
+    // disjoint, so a chain of selects over all but the last gate suffices.
+    void lowerGatedPhi(PHINode *phi, const std::vector<SSAGate> &gates, BasicBlock *block, BlockBuilder &blockBuilder)
+    {
+        IRBuilder<> builder(block);
+        Value *result = nullptr;
+        for (auto it = gates.rbegin(); it != gates.rend(); ++it)
+        {
+            if (PredicateSimplifier::isFalse(it->predicate))
+                continue;
+            Value *value = remap(it->value);
+            if (result && value != result)
+                result = builder.CreateSelect(blockBuilder.materialize(it->predicate, block), value, result);
+            else
+                result = value;
+        }
+        VMap[phi] = result ? result : PoisonValue::get(phi->getType());
+    }
+
+    bool isAvailable(Value *value, BasicBlock *block, const std::unordered_set<Value *> &runDefs)
     {
-        // Avoid implementing by avoiding phi nodes altogether
+        if (!isa<Instruction>(value) || runDefs.count(value))
+            return true;
+        auto *lowered = dyn_cast<Instruction>(remap(value));
+        if (!lowered)
+            return true;
+        return lowered != value && dominance.dominates(lowered->getParent(), block);
     }
 
-    PHINode *eliminateMu(SSALoop::MuBinding *muNode, BasicBlock *header, BasicBlock *entry, BasicBlock *latch)
+    // Stores into a stack slot whose address never escapes can run
+    // unconditionally as a store of select(pred, new, old): the slot is always
+    // dereferenceable and no other thread can observe the extra write.
+    static bool isPrivateStore(Instruction *inst)
     {
-        PHINode *node = PHINode::Create(muNode->muNode->type, 2, muNode->variable, header);
+        auto *store = dyn_cast<StoreInst>(inst);
+        if (!store || !store->isSimple())
+            return false;
+        auto *slot = dyn_cast<AllocaInst>(getUnderlyingObject(store->getPointerOperand()));
+        return slot && !PointerMayBeCaptured(slot, true, true);
+    }
 
-        if (auto init = std::get_if<llvm::Value *>(&muNode->muNode->init))
+    // Cost units of running `inst` unconditionally, or None when it must not
+    // run on paths where its predicate is false.
+    Optional<unsigned> speculationCost(Instruction *inst, BasicBlock *block, const std::unordered_set<Value *> &runDefs)
+    {
+        if (packOf.count(inst) || inst->isTerminator())
+            return None;
+        if (auto *phi = dyn_cast<PHINode>(inst))
         {
-            if (auto initMu = std::get_if<SSAMuNode *>(&muNode->muNode->init))
-            {
-                PHINode *initPhi = eliminateMu(new SSALoop::MuBinding{muNode->variable + "_init", *initMu}, header, entry, latch);
-                node->addIncoming(initPhi, entry);
-            }
+            if (boundPhis.count(phi))
+                return 0u;
+            auto it = functionGates->find(phi);
+            if (it == functionGates->end())
+                return None;
+            return static_cast<unsigned>(it->second.size() - 1);
         }
-        if (auto rec = std::get_if<llvm::Value *>(&muNode->muNode->rec))
+
+        bool privateStore = isPrivateStore(inst);
+        if (!privateStore && !isSafeToSpeculativelyExecute(inst))
+            return None;
+        for (Value *op : inst->operands())
         {
-            if (auto recMu = std::get_if<SSAMuNode *>(&muNode->muNode->rec))
-            {
-                PHINode *recPhi = eliminateMu(new SSALoop::MuBinding{muNode->variable + "_rec", *recMu}, header, entry, latch);
-                node->addIncoming(recPhi, latch);
-            }
+            if (!isAvailable(op, block, runDefs))
+                return None;
         }
-        return node;
+
+        unsigned cost = 1;
+        if (options.TTI)
+        {
+            auto value = options.TTI->getInstructionCost(inst, TargetTransformInfo::TCK_SizeAndLatency).getValue();
+            if (!value)
+                return None;
+            cost = std::max<int64_t>(*value, 1);
+        }
+        // The merging load and select.
+        return privateStore ? cost + 2 : cost;
     }
 
-    BasicBlock *lowerToIR(std::variant<SSAFunction *, SSALoop *> function_or_loop,
-                          BasicBlock *entry, LLVMContext &ctx, SSAPredicate* pred = nullptr)
+    // Emits items[begin, end), all under one predicate, without branching
+    // around them. Returns false without emitting anything when an item cannot
+    // be speculated or the run costs more than the threshold.
+    bool speculateRun(std::vector<Item> &items, size_t begin, size_t end, BlockBuilder &blockBuilder)
     {
-        BlockBuilder blockBuilder = BlockBuilder(entry, &VMap);
-        eliminatePhiNodes(function_or_loop, blockBuilder);
+        SSAPredicate *pred = items[begin].Predicate;
+        if (PredicateSimplifier::isTrue(pred))
+            return false;
 
-        std::map<SSALoop::MuBinding *, PHINode *> bindingToPhi;
+        BasicBlock *block = blockBuilder.speculation_block(pred);
+        std::unordered_set<Value *> runDefs;
+        unsigned cost = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            auto instr = std::get_if<Instruction *>(&items[i].content);
+            if (!instr)
+                return false;
+            Optional<unsigned> itemCost = speculationCost(*instr, block, runDefs);
+            if (!itemCost)
+                return false;
+            cost += *itemCost;
+            if (cost > options.speculationThreshold)
+                return false;
+            runDefs.insert(*instr);
+        }
 
-        if (auto loop = std::get_if<SSALoop *>(&function_or_loop))
+        IRBuilder<> builder(block);
+        Value *cond = nullptr;
+        for (size_t i = begin; i < end; i++)
         {
-            //errs() << "Lowering loop to IR, wish us luck\n";
-            BasicBlock *header = BasicBlock::Create(ctx, "loop_header", entry->getParent());
-            blockBuilder.append(header, pred ? pred : truth());
-            BasicBlock *exit = BasicBlock::Create(ctx, "loop_exit", entry->getParent());
-            for (auto &binding : (*loop)->muBindings)
+            Instruction *inst = std::get<Instruction *>(items[i].content);
+            auto *phi = dyn_cast<PHINode>(inst);
+            if (phi && boundPhis.count(phi))
+                continue;
+            if (phi)
             {
-                //PHINode *phi = eliminateMu(&binding, header, entry, latch);
-                //bindingToPhi[&binding] = phi;
-                for (auto &pair : valueMap)
-                {
-                    if (auto mu = std::get_if<SSAMuNode *>(&pair.second))
-                    {
-                        if (*mu == binding.muNode)
-                        {
-                            //VMap[pair.first] = phi;
-                            break;
-                        }
-                    }
-                }
+                lowerGatedPhi(phi, functionGates->at(phi), block, blockBuilder);
             }
-            BasicBlock *bodyBlock = header;
-            for (size_t i = 0; i < (*loop)->bodyItems.size(); ++i)
+            else if (isPrivateStore(inst))
             {
-                auto &item = (*loop)->bodyItems[i];
-
-                bodyBlock = blockBuilder.get_block(item.Predicate);
-                if (auto innerLoop = std::get_if<SSALoop *>(&item.content))
-                {
-                    bodyBlock = lowerToIR(*innerLoop, bodyBlock, ctx, item.Predicate);
-                    blockBuilder.append(bodyBlock, item.Predicate);
-                }
-                else if (auto instr = std::get_if<Instruction *>(&item.content))
-                {
-                    Instruction *clone = (*instr)->clone();
-                    VMap[*instr] = clone;
-                    RemapInstruction(clone, VMap, RF_NoModuleLevelChanges);
-                    // errs() << "Inserting instruction: " << *clone << "\n";
-                    bodyBlock->getInstList().push_back(clone);
-                }
+                auto *store = cast<StoreInst>(inst);
+                if (!cond)
+                    cond = blockBuilder.materialize(pred, block);
+                Value *ptr = remap(store->getPointerOperand());
+                Value *value = remap(store->getValueOperand());
+                Value *old = builder.CreateAlignedLoad(value->getType(), ptr, store->getAlign());
+                builder.CreateAlignedStore(builder.CreateSelect(cond, value, old), ptr, store->getAlign());
             }
-            for (auto &binding : (*loop)->muBindings)
+            else
             {
-                PHINode *phi = bindingToPhi[&binding];
-                if (auto init = std::get_if<llvm::Value *>(&binding.muNode->init))
-                {
-                    if (!std::get_if<SSAMuNode *>(&binding.muNode->init))
-                    {
-                        auto it = VMap.find(*init);
-                        Value *remapped_init = (it != VMap.end()) ? (Value *)it->second : *init;
-                        phi->addIncoming(remapped_init, entry);
-                    }
-                }
-                if (auto rec = std::get_if<llvm::Value *>(&binding.muNode->rec))
-                {
-                    if (!std::get_if<SSAMuNode *>(&binding.muNode->rec))
-                    {
-                        auto it = VMap.find(*rec);
-                        Value *remapped_rec = (it != VMap.end()) ? (Value *)it->second : *rec;
-                        //phi->addIncoming(remapped_rec, latch);
-                    }
-                }
+                cloneInto(inst, block);
             }
-            BasicBlock *block = blockBuilder.get_block((*loop)->whileCondition);
-            if(!block->getTerminator()) BranchInst::Create(header, block);
-            if(!blockBuilder.getTrueBlock()->getTerminator()) BranchInst::Create(exit, blockBuilder.getTrueBlock());
-            return exit;
         }
-        else if (auto function = std::get_if<SSAFunction *>(&function_or_loop))
+        return true;
+    }
+
+    static bool samePredicate(SSAPredicate *a, SSAPredicate *b)
+    {
+        return a == b || (a && b && predicatesEqual(a, b));
+    }
+
+    void lowerItems(std::vector<Item> &items, BlockBuilder &blockBuilder, LLVMContext &ctx)
+    {
+        for (size_t i = 0; i < items.size();)
         {
-            BasicBlock *currentBlock = entry;
-            for (size_t i = 0; i < (*function)->items.size(); ++i)
+            size_t end = i + 1;
+            if (options.speculationThreshold && !blockBuilder.inRegion(items[i].Predicate))
             {
-                auto &item = (*function)->items[i];
-
-                if (auto loop = std::get_if<SSALoop *>(&item.content))
+                while (end < items.size() && samePredicate(items[end].Predicate, items[i].Predicate))
+                    end++;
+                if (speculateRun(items, i, end, blockBuilder))
                 {
-                    currentBlock = lowerToIR(*loop, currentBlock, ctx, item.Predicate);
+                    i = end;
+                    continue;
                 }
-                else if (auto instr = std::get_if<Instruction *>(&item.content))
+            }
+            for (; i < end; i++)
+                lowerItem(items[i], blockBuilder, ctx);
+        }
+    }
+
+    // Lowers `loop` after `preheader` and returns the block following the loop.
+    BasicBlock *lowerLoop(SSALoop *loop, BasicBlock *preheader, LLVMContext &ctx)
+    {
+        Function *F = preheader->getParent();
+        BasicBlock *header = BasicBlock::Create(ctx, "loop_header", F);
+        BasicBlock *exit = BasicBlock::Create(ctx, "loop_exit", F);
+        dominance.add(header, preheader);
+
+        std::vector<std::pair<SSALoop::MuBinding *, PHINode *>> scalarPhis;
+        std::vector<std::pair<const VectorPack *, PHINode *>> vectorPhis;
+        eliminateMus(loop, header, preheader, scalarPhis, vectorPhis);
+        BranchInst::Create(header, preheader);
+
+        BlockBuilder blockBuilder(header, &VMap, &dominance);
+        preheaders.push_back(preheader);
+        lowerItems(loop->bodyItems, blockBuilder, ctx);
+        preheaders.pop_back();
+
+        BasicBlock *latch = blockBuilder.close();
+        if (latch->getTerminator())
+            latch = blockBuilder.get_block(truth());
+        Value *cond = loop->whileCondition ? blockBuilder.materialize(loop->whileCondition, latch)
+                                           : ConstantInt::getTrue(ctx);
+        BranchInst::Create(header, exit, cond, latch);
+        dominance.add(exit, latch);
+
+        for (auto &[binding, phi] : scalarPhis)
+        {
+            Value *rec = lowerSSAValue(binding->muNode->rec);
+            phi->addIncoming(rec ? rec : PoisonValue::get(phi->getType()), latch);
+        }
+        for (auto &[pack, phi] : vectorPhis)
+        {
+            phi->addIncoming(packValues[pack], latch);
+        }
+        return exit;
+    }
+
+    void lowerItem(Item &item, BlockBuilder &blockBuilder, LLVMContext &ctx)
+    {
+        BasicBlock *block = blockBuilder.get_block(item.Predicate);
+        if (auto loop = std::get_if<SSALoop *>(&item.content))
+        {
+            blockBuilder.continueIn(lowerLoop(*loop, block, ctx));
+        }
+        else if (auto instr = std::get_if<Instruction *>(&item.content))
+        {
+            if (auto *phi = dyn_cast<PHINode>(*instr))
+            {
+                if (boundPhis.count(phi))
+                    return;
+                auto gates = functionGates->find(phi);
+                if (gates != functionGates->end())
                 {
-                    Instruction *clone = (*instr)->clone();
-                    VMap[*instr] = clone;
-                    RemapInstruction(clone, VMap, RF_NoModuleLevelChanges);
-                    // errs() << "Inserting instruction: " << *clone << "\n";
-                    currentBlock->getInstList().push_back(clone);
+                    lowerGatedPhi(phi, gates->second, block, blockBuilder);
+                    return;
                 }
             }
+            auto it = packOf.find(*instr);
+            if (it == packOf.end())
+                cloneInto(*instr, block);
+            else if (!loweredPacks.count(it->second))
+                lowerPack(it->second, block);
+        }
+    }
 
-            blockBuilder.seal_off(currentBlock);
-            // In theory we shouldn't need a terminator, as the last instruction should be one. If its not, complain!
-            if (currentBlock->getTerminator() == nullptr)
-                errs() << "Warning: Block " << currentBlock->front() << " has no terminator!\n";
+    BasicBlock *lowerToIR(SSAFunction *function, BasicBlock *entry, LLVMContext &ctx, const PackSet &packs,
+                          const LoweringOptions &loweringOptions)
+    {
+        options = loweringOptions;
+        functionGates = &function->phiGates;
+        for (auto &pack : packs)
+        {
+            for (auto *inst : pack.instructions)
+                packOf[inst] = &pack;
         }
-        restore_ssa(function_or_loop, blockBuilder);
+
+        dominance.add(entry, nullptr);
+        BlockBuilder blockBuilder(entry, &VMap, &dominance);
+        lowerItems(function->items, blockBuilder, ctx);
+
+        // Every path out of a well-formed function ends in a return item; the
+        // fall-through of the last region is unreachable.
+        BasicBlock *last = blockBuilder.close();
+        if (last->getTerminator() == nullptr)
+            new UnreachableInst(ctx, last);
         return entry;
     }
 };
 
-SSAFunction *convertToPredicatedSSA(llvm::Function &llvmFunc)
+// Items are placed in the block of their own predicate, so a value computed
+// under one predicate and used under another, or after the loop that computed
+// it, need not dominate its use. Route such uses through phis that carry undef
+// on the paths where the value was never computed.
+static void repairDominance(Function &F)
 {
-    SSAPredicatedSSAConverter converter(llvmFunc);
+    DominatorTree DT(F);
+    std::vector<std::pair<Instruction *, std::vector<Use *>>> broken;
+    for (auto &BB : F)
+    {
+        for (auto &I : BB)
+        {
+            std::vector<Use *> uses;
+            for (Use &U : I.uses())
+            {
+                if (!DT.dominates(&I, U))
+                    uses.push_back(&U);
+            }
+            if (!uses.empty())
+                broken.push_back({&I, uses});
+        }
+    }
+
+    for (auto &[def, uses] : broken)
+    {
+        SSAUpdater updater;
+        updater.Initialize(def->getType(), def->getName());
+        updater.AddAvailableValue(def->getParent(), def);
+        for (Use *use : uses)
+            updater.RewriteUse(*use);
+    }
+}
+
+SSAFunction *convertToPredicatedSSA(llvm::Function &llvmFunc, llvm::LazyValueInfo *LVI)
+{
+    SSAPredicatedSSAConverter converter(llvmFunc, LVI);
     return converter.convertToPredicatedSSA();
 }
 
-void lowerToIR(SSAFunction *function, llvm::Function &llvmFunc)
+void lowerToIR(SSAFunction *function, llvm::Function &llvmFunc, const PackSet &packs, const LoweringOptions &options)
 {
     SSAPredicatedSSAConverter converter(llvmFunc);
     BasicBlock *newEntry = BasicBlock::Create(llvmFunc.getContext(), "entry", &llvmFunc);
@@ -753,23 +1510,22 @@ void lowerToIR(SSAFunction *function, llvm::Function &llvmFunc)
     for (auto &BB : llvmFunc)
         if (&BB != newEntry)
             OldBlocks.push_back(&BB);
-    converter.lowerToIR(function, newEntry, llvmFunc.getContext());
+    converter.lowerToIR(function, newEntry, llvmFunc.getContext(), packs, options);
     newEntry->moveBefore(&llvmFunc.getEntryBlock());
-    // verifyFunction(llvmFunc, &errs());
-    // errs() << llvmFunc << "\n";
-    // errs() << "We done lowering to IR.\n";
     for (auto *BB : OldBlocks)
         BB->dropAllReferences();
     for (auto *BB : OldBlocks)
         BB->eraseFromParent();
-    // errs() << llvmFunc << "\n";
-    std::vector<BasicBlock *> blocksToErase;
+    removeUnreachableBlocks(llvmFunc);
+    repairDominance(llvmFunc);
     for (auto &BB : llvmFunc)
-        if (predecessors(&BB).empty() && &BB != &llvmFunc.getEntryBlock())
-            blocksToErase.push_back(&BB);
-    for (auto *BB : blocksToErase)
-        BB->eraseFromParent();
-    //errs() << llvmFunc << "\n";
+    {
+        for (auto it = BB.rbegin(); it != BB.rend();)
+        {
+            Instruction &I = *it++;
+            if (isInstructionTriviallyDead(&I))
+                I.eraseFromParent();
+        }
+    }
     verifyFunction(llvmFunc, &errs());
-    // errs() << "We done frfr.\n";
 }
@@ -6,10 +6,14 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h" // Add this
 #include "llvm/IR/Type.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
 #include <vector>
 #include <string>
 #include <variant>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 struct Item;
 
@@ -45,6 +49,8 @@ struct SSALoop
     {
         std::string variable;
         SSAMuNode *muNode;
+        // Header phi this binding replaces; its uses are rewired on lowering.
+        llvm::PHINode *phi = nullptr;
     };
 
     std::vector<MuBinding> muBindings;
@@ -58,18 +64,103 @@ struct Item
     SSAPredicate *Predicate = nullptr;
 };
 
+// One incoming value of a non-header phi, selected when `predicate` holds.
+struct SSAGate
+{
+    SSAPredicate *predicate;
+    llvm::Value *value;
+};
+
 struct SSAFunction
 {
     std::vector<Item> items;
+    // Gates of every phi that is not a loop mu-node, in incoming order.
+    std::unordered_map<llvm::PHINode *, std::vector<SSAGate>> phiGates;
+};
+
+// A group of isomorphic, same-predicate instructions that is lowered as one
+// vector instruction. Lane i of the vector is instructions[i].
+struct VectorPack
+{
+    std::vector<llvm::Instruction *> instructions;
+    SSAPredicate *predicate;
+    // Memory packs only: lane i accesses the element right after lane i - 1.
+    bool contiguous = false;
+    // Strided memory packs only: lane i accesses the element `stride`
+    // elements after lane i - 1, one member of an interleaved group such as
+    // the x fields of an array of {x, y} structs. 0 for other packs.
+    unsigned stride = 0;
+    // Commutative packs only: lanes whose two operands go to the vector
+    // operation in reverse order, so that each operand vector lines up with
+    // values that are already vectors. Empty when no lane is swapped.
+    std::vector<bool> swapped;
+    // Packs whose lane count is not a power of two are either split by the
+    // packer or padded: lowered at the next power of two, with the extra
+    // lanes left poison and memory accessed through masked intrinsics.
+    bool padded = false;
+
+    // Number of lanes of the vector the pack is lowered to.
+    unsigned width() const
+    {
+        return padded ? llvm::PowerOf2Ceil(instructions.size()) : instructions.size();
+    }
 };
 
-SSAFunction *convertToPredicatedSSA(llvm::Function &llvmFunc);
-void lowerToIR(SSAFunction *function, llvm::Function &llvmFunc);
+struct PackHash
+{
+    size_t operator()(const VectorPack &pack) const
+    {
+        size_t hash = 0;
+        for (auto *inst : pack.instructions)
+        {
+            hash ^= std::hash<llvm::Instruction *>()(inst);
+        }
+        return hash;
+    }
+};
+
+bool operator==(const VectorPack &a, const VectorPack &b);
+
+using PackSet = std::unordered_set<VectorPack, PackHash>;
+
+namespace llvm
+{
+class TargetLibraryInfo;
+class TargetTransformInfo;
+}
+
+struct LoweringOptions
+{
+    // Predicated runs of cheap, side-effect-free items whose total cost is at
+    // most this many units are executed unconditionally instead of being
+    // branched around; phis and stores to private stack slots merge their
+    // results with selects. 0 keeps every branch.
+    unsigned speculationThreshold = 0;
+    // Prices items for the threshold; without it every item costs one unit.
+    // Together with TLI it also picks the vector form of call packs, as it
+    // did for the packer.
+    const llvm::TargetTransformInfo *TTI = nullptr;
+    const llvm::TargetLibraryInfo *TLI = nullptr;
+};
+
+// Structural equality; And/Or operands may appear in either order.
+bool predicatesEqual(SSAPredicate *A, SSAPredicate *B);
+
+namespace llvm
+{
+class LazyValueInfo;
+}
+
+// LVI, when given, lets the predicate simplifier fold conditions from value
+// ranges.
+SSAFunction *convertToPredicatedSSA(llvm::Function &llvmFunc, llvm::LazyValueInfo *LVI = nullptr);
+void lowerToIR(SSAFunction *function, llvm::Function &llvmFunc, const PackSet &packs = PackSet(),
+               const LoweringOptions &options = LoweringOptions());
 
 class PredicatedSSAPrinter
 {
 public:
-    static void print(SSAFunction *function, llvm::raw_fd_ostream &os)
+    static void print(SSAFunction *function, llvm::raw_ostream &os)
     {
         os << "Function:\n";
         for (auto &item : function->items)
@@ -78,7 +169,7 @@ public:
             os << "\n";
         }
     }
-    static void predicateToString(SSAPredicate *pred, llvm::raw_fd_ostream &os)
+    static void predicateToString(SSAPredicate *pred, llvm::raw_ostream &os)
     {
         if (!pred)
         {
@@ -92,11 +183,7 @@ public:
             os << "true";
             return;
         case SSAPredicate::Condition:
-            if (pred->condition && pred->condition->hasName())
-            {
-                os << ("%" + pred->condition->getName().str());
-            }
-            os << *pred->condition;
+            pred->condition->printAsOperand(os, /*PrintType=*/false);
             return;
         case SSAPredicate::Not:
             os << "!(";
@@ -123,7 +210,7 @@ public:
     }
 
 private:
-    static void itemToString(Item *item, llvm::raw_fd_ostream &os, int loopDepth)
+    static void itemToString(Item *item, llvm::raw_ostream &os, int loopDepth)
     {
         for (int i = 0; i < loopDepth; i++)
         {
@@ -0,0 +1,325 @@
+#include "runtimeChecks.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include <map>
+#include <vector>
+
+using namespace llvm;
+
+namespace
+{
+
+// Byte addresses [low, high) as integer SCEVs.
+struct AddressRange
+{
+    const SCEV *low;
+    const SCEV *high;
+};
+
+// Addresses `address` takes over the whole function. An affine recurrence is
+// widened over the symbolic maximum trip count of its loop, which bounds the
+// iterations that can run.
+Optional<AddressRange> rangeOf(const SCEV *address, ScalarEvolution &SE)
+{
+    if (auto *rec = dyn_cast<SCEVAddRecExpr>(address))
+    {
+        if (!rec->isAffine())
+            return None;
+        auto start = rangeOf(rec->getStart(), SE);
+        const SCEV *step = rec->getStepRecurrence(SE);
+        const SCEV *trips = SE.getSymbolicMaxBackedgeTakenCount(rec->getLoop());
+        if (!start || isa<SCEVCouldNotCompute>(trips))
+            return None;
+        const SCEV *distance = SE.getMulExpr(step, SE.getTruncateOrZeroExtend(trips, step->getType()));
+        if (SE.isKnownNonNegative(step))
+            return AddressRange{start->low, SE.getAddExpr(start->high, distance)};
+        if (SE.isKnownNonPositive(step))
+            return AddressRange{SE.getAddExpr(start->low, distance), start->high};
+        return None;
+    }
+    if (SCEVExprContains(address, [](const SCEV *S) { return isa<SCEVAddRecExpr>(S); }))
+        return None;
+    return AddressRange{address, address};
+}
+
+// Whether `S` only uses values that exist before `point` in the entry block.
+bool isAvailableAt(const SCEV *S, Instruction *point)
+{
+    return !SCEVExprContains(S, [&](const SCEV *part) {
+        auto *unknown = dyn_cast<SCEVUnknown>(part);
+        if (!unknown)
+            return isa<SCEVAddRecExpr>(part);
+        Value *value = unknown->getValue();
+        if (isa<Argument>(value) || isa<Constant>(value))
+            return false;
+        auto *inst = dyn_cast<Instruction>(value);
+        return !inst || inst->getParent() != point->getParent() || !inst->comesBefore(point);
+    });
+}
+
+// `S` as a base and a constant offset from it, so that addresses such as %a
+// and %a+4, which SCEV does not order, can be compared by their offsets.
+std::pair<const SCEV *, int64_t> splitOffset(const SCEV *S, ScalarEvolution &SE)
+{
+    if (auto *add = dyn_cast<SCEVAddExpr>(S))
+    {
+        auto *offset = dyn_cast<SCEVConstant>(add->getOperand(0));
+        if (offset && offset->getAPInt().getMinSignedBits() <= 64)
+        {
+            SmallVector<const SCEV *, 4> base(std::next(add->op_begin()), add->op_end());
+            return {SE.getAddExpr(base), offset->getAPInt().getSExtValue()};
+        }
+    }
+    return {S, 0};
+}
+
+// The lowest or highest offset from each base, in the order the bases were
+// first seen.
+using OffsetBounds = SmallVector<std::pair<const SCEV *, int64_t>, 2>;
+
+void addBound(OffsetBounds &bounds, const SCEV *address, bool lowest, ScalarEvolution &SE)
+{
+    auto [base, offset] = splitOffset(address, SE);
+    for (auto &[known, bound] : bounds)
+    {
+        if (known == base)
+        {
+            bound = lowest ? std::min(bound, offset) : std::max(bound, offset);
+            return;
+        }
+    }
+    bounds.push_back({base, offset});
+}
+
+const SCEV *combineBounds(const OffsetBounds &bounds, bool lowest, ScalarEvolution &SE)
+{
+    SmallVector<const SCEV *, 2> addresses;
+    for (auto &[base, offset] : bounds)
+        addresses.push_back(SE.getAddExpr(base, SE.getConstant(base->getType(), offset, true)));
+    return lowest ? SE.getUMinExpr(addresses) : SE.getUMaxExpr(addresses);
+}
+
+struct ObjectAccesses
+{
+    std::vector<Instruction *> accesses;
+    bool written = false;
+    Optional<AddressRange> range;
+};
+
+// A copy has to save a cost unit for every this many instructions it
+// duplicates.
+const unsigned CopiedInstructionsPerUnit = 8;
+
+// Erases the checks, which run from the static allocas of `entry` up to
+// `end` or the end of the block, and the intrinsic declarations the expander
+// added for them.
+void eraseChecks(BasicBlock &entry, Instruction *end)
+{
+    SmallSetVector<Function *, 2> intrinsics;
+    while (true)
+    {
+        Instruction *check = end ? end->getPrevNode() : entry.empty() ? nullptr : &entry.back();
+        if (!check || isa<AllocaInst>(check))
+            break;
+        if (auto *call = dyn_cast<IntrinsicInst>(check))
+            intrinsics.insert(call->getCalledFunction());
+        check->eraseFromParent();
+    }
+    for (Function *intrinsic : intrinsics)
+    {
+        if (intrinsic->use_empty())
+            intrinsic->eraseFromParent();
+    }
+}
+
+} // namespace
+
+Optional<OverlapVersioning> versionOnOverlapChecks(Function &F, ScalarEvolution &SE, const TargetTransformInfo &TTI,
+                                                   const ObjectPairs &pairs, InstructionCost budget,
+                                                   InstructionCost &cost)
+{
+    cost = InstructionCost::getInvalid();
+    const DataLayout &DL = F.getParent()->getDataLayout();
+    Type *intPtrType = DL.getIntPtrType(F.getContext());
+    BasicBlock &entry = F.getEntryBlock();
+    // Checks go after the static allocas, which both bodies keep sharing.
+    Instruction *checkPoint = &*entry.getFirstInsertionPt();
+    while (isa<AllocaInst>(checkPoint))
+        checkPoint = checkPoint->getNextNode();
+
+    // Objects in the order they are first accessed, so that equal functions
+    // get equal checks.
+    std::vector<const Value *> objects;
+    std::map<const Value *, ObjectAccesses> accessesOf;
+    for (Instruction &I : instructions(F))
+    {
+        Value *ptr = getLoadStorePointerOperand(&I);
+        if (!ptr)
+            continue;
+        const Value *object = getUnderlyingObject(ptr);
+        auto [it, inserted] = accessesOf.try_emplace(object);
+        if (inserted)
+            objects.push_back(object);
+        it->second.accesses.push_back(&I);
+        it->second.written |= isa<StoreInst>(I);
+    }
+
+    for (const Value *object : objects)
+    {
+        auto &object_ = accessesOf[object];
+        // Accesses from the same base only widen its bounds, so the range
+        // has a term per base rather than per access.
+        OffsetBounds lows, highs;
+        bool computable = true;
+        for (Instruction *access : object_.accesses)
+        {
+            const SCEV *address = SE.getPtrToIntExpr(SE.getSCEV(getLoadStorePointerOperand(access)), intPtrType);
+            auto range = isa<SCEVCouldNotCompute>(address) ? None : rangeOf(address, SE);
+            if (!range)
+            {
+                computable = false;
+                break;
+            }
+            const SCEV *size = SE.getConstant(intPtrType, DL.getTypeStoreSize(getLoadStoreType(access)));
+            addBound(lows, range->low, true, SE);
+            addBound(highs, SE.getAddExpr(range->high, size), false, SE);
+        }
+        if (!computable)
+            continue;
+        const SCEV *low = combineBounds(lows, true, SE), *high = combineBounds(highs, false, SE);
+        if (isAvailableAt(low, checkPoint) && isAvailableAt(high, checkPoint))
+            object_.range = AddressRange{low, high};
+    }
+
+    std::vector<std::pair<const Value *, const Value *>> checked;
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        for (size_t j = i + 1; j < objects.size(); j++)
+        {
+            const Value *a = objects[i], *b = objects[j];
+            if (!pairs.count({a, b}) && !pairs.count({b, a}))
+                continue;
+            if (accessesOf[a].range && accessesOf[b].range && (accessesOf[a].written || accessesOf[b].written))
+                checked.push_back({a, b});
+        }
+    }
+    if (checked.empty())
+        return None;
+
+    // Two ranges overlap when each starts before the other ends.
+    SCEVExpander expander(SE, DL, "sv.overlap");
+    IRBuilder<> builder(checkPoint);
+    Value *overlap = builder.getFalse();
+    for (auto &[a, b] : checked)
+    {
+        auto rangeA = *accessesOf[a].range, rangeB = *accessesOf[b].range;
+        Value *lowA = expander.expandCodeFor(rangeA.low, intPtrType, checkPoint);
+        Value *highA = expander.expandCodeFor(rangeA.high, intPtrType, checkPoint);
+        Value *lowB = expander.expandCodeFor(rangeB.low, intPtrType, checkPoint);
+        Value *highB = expander.expandCodeFor(rangeB.high, intPtrType, checkPoint);
+        builder.SetInsertPoint(checkPoint);
+        Value *pairOverlaps = builder.CreateAnd(builder.CreateICmpULT(lowA, highB), builder.CreateICmpULT(lowB, highA));
+        overlap = builder.CreateOr(overlap, pairOverlaps, "sv.overlap");
+    }
+
+    // The checks and the branch run on every call, and every instruction the
+    // copy duplicates adds code; that much is known before anything is
+    // copied.
+    const auto kind = TargetTransformInfo::TCK_RecipThroughput;
+    cost = TTI.getCFInstrCost(Instruction::Br, kind);
+    unsigned copied = F.getInstructionCount();
+    for (Instruction *check = checkPoint->getPrevNode(); check; check = check->getPrevNode())
+    {
+        copied--;
+        if (!isa<AllocaInst>(check))
+            cost += TTI.getInstructionCost(check, kind);
+    }
+    cost += (copied + CopiedInstructionsPerUnit - 1) / CopiedInstructionsPerUnit;
+    if (cost >= budget)
+    {
+        eraseChecks(entry, checkPoint);
+        return None;
+    }
+
+    // The original body becomes the fallback; the clone gets the branch when
+    // nothing overlaps.
+    BasicBlock *scalarBody = entry.splitBasicBlock(checkPoint, "sv.scalar");
+    std::vector<BasicBlock *> body;
+    for (BasicBlock &BB : F)
+    {
+        if (&BB != &entry)
+            body.push_back(&BB);
+    }
+    ValueToValueMapTy VMap;
+    SmallVector<BasicBlock *, 16> clones;
+    for (BasicBlock *BB : body)
+    {
+        BasicBlock *clone = CloneBasicBlock(BB, VMap, ".noalias", &F);
+        VMap[BB] = clone;
+        clones.push_back(clone);
+    }
+    remapInstructionsInBlocks(clones, VMap);
+
+    entry.getTerminator()->eraseFromParent();
+    BranchInst::Create(scalarBody, cast<BasicBlock>(VMap[scalarBody]), overlap, &entry);
+
+    MDBuilder MDB(F.getContext());
+    MDNode *domain = MDB.createAnonymousAliasScopeDomain("sv.overlap");
+    std::map<const Value *, MDNode *> scopes;
+    for (auto &[a, b] : checked)
+    {
+        for (const Value *object : {a, b})
+        {
+            if (!scopes.count(object))
+                scopes[object] = MDB.createAnonymousAliasScope(domain);
+        }
+    }
+    for (auto &[object, scope] : scopes)
+    {
+        SmallVector<Metadata *, 4> partners;
+        for (auto &[a, b] : checked)
+        {
+            if (a == object)
+                partners.push_back(scopes[b]);
+            else if (b == object)
+                partners.push_back(scopes[a]);
+        }
+        MDNode *noalias = MDNode::get(F.getContext(), partners);
+        for (Instruction *access : accessesOf[object].accesses)
+        {
+            auto *clone = cast<Instruction>(VMap[access]);
+            clone->setMetadata(LLVMContext::MD_alias_scope,
+                               MDNode::concatenate(clone->getMetadata(LLVMContext::MD_alias_scope),
+                                                   MDNode::get(F.getContext(), {scope})));
+            clone->setMetadata(LLVMContext::MD_noalias,
+                               MDNode::concatenate(clone->getMetadata(LLVMContext::MD_noalias), noalias));
+        }
+    }
+    return OverlapVersioning{&entry, scalarBody, std::vector<BasicBlock *>(clones.begin(), clones.end())};
+}
+
+void undoOverlapVersioning(Function &F, const OverlapVersioning &versioning)
+{
+    for (BasicBlock *clone : versioning.clones)
+        clone->dropAllReferences();
+    for (BasicBlock *clone : versioning.clones)
+        clone->eraseFromParent();
+
+    // The checks follow the static allocas and are only used by each other
+    // and the branch.
+    eraseChecks(*versioning.entry, nullptr);
+    BranchInst::Create(versioning.scalarBody, versioning.entry);
+    MergeBlockIntoPredecessor(versioning.scalarBody);
+}
@@ -0,0 +1,57 @@
+#ifndef RUNTIMECHECKS_H
+#define RUNTIMECHECKS_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Function.h"
+#include <set>
+#include <utility>
+#include <vector>
+
+// Pairs of underlying objects that may overlap, in either order.
+using ObjectPairs = std::set<std::pair<const llvm::Value *, const llvm::Value *>>;
+
+// The blocks versionOnOverlapChecks adds to a function: the entry block ends
+// in the checks and the branch, the original body starts at `scalarBody`, and
+// `clones` are the copy that runs when nothing overlaps.
+struct OverlapVersioning
+{
+    llvm::BasicBlock *entry;
+    llvm::BasicBlock *scalarBody;
+    std::vector<llvm::BasicBlock *> clones;
+};
+
+// Versions `F` on runtime overlap checks for the object pairs in `pairs`. The
+// body is cloned, and the entry block compares the byte ranges the function
+// accesses in the two objects of each pair, branching to the clone when none
+// overlap and to the original body otherwise. Accesses of the clone carry
+// scoped noalias metadata, one scope per object, which mayConflict honours;
+// after conversion the two bodies are items under the check and its
+// negation, and only the clone has the freedom to pack.
+//
+// The range of an object covers every access to it, with accesses in loops
+// widened over the symbolic maximum trip count, so a check may fail where a
+// finer one would pass but never passes wrongly. Accesses that differ from
+// one base by a constant offset are collapsed to the lowest and highest
+// offset, so a range grows with the bases an object is accessed through,
+// not with its accesses. Objects whose ranges cannot be computed on entry
+// are left out and keep conservative dependences in both bodies.
+//
+// `cost` is set to what the versioning costs whether or not the checks pass:
+// the checks and the branch run on every call, and every copied instruction
+// is charged a fraction of a unit for the code it adds. It is known before
+// anything is copied, and when it reaches `budget` the checks are removed
+// again. Returns None, leaving `F` untouched, in that case and when no pair
+// can be checked, where `cost` is left invalid.
+llvm::Optional<OverlapVersioning> versionOnOverlapChecks(llvm::Function &F, llvm::ScalarEvolution &SE,
+                                                         const llvm::TargetTransformInfo &TTI,
+                                                         const ObjectPairs &pairs, llvm::InstructionCost budget,
+                                                         llvm::InstructionCost &cost);
+
+// Removes the checks and the copy, giving back the function as it was before
+// versionOnOverlapChecks. Instructions of the original body are kept, so
+// anything referring to them stays valid.
+void undoOverlapVersioning(llvm::Function &F, const OverlapVersioning &versioning);
+
+#endif
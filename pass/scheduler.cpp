@@ -0,0 +1,322 @@
+#include "scheduler.h"
+#include "dependence.h"
+#include "flatSSA.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Module.h"
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace llvm;
+
+namespace
+{
+
+// What an item reads, writes and defines, flattened over nested loops.
+struct ItemSummary
+{
+    std::vector<Instruction *> insts;
+    std::vector<Instruction *> memoryInsts;
+    std::vector<Value *> uses;
+    // The item may stop execution (return, trap, non-terminating loop).
+    bool mayNotReturn = false;
+    // The item may trap or read invalid memory if run before an item that
+    // stops execution, e.g. a division by zero or a load.
+    bool mayTrap = false;
+    bool writesMemory = false;
+    bool isTerminator = false;
+};
+
+void collectConditions(SSAPredicate *pred, std::vector<Value *> &uses)
+{
+    if (!pred)
+        return;
+    if (pred->kind == SSAPredicate::Condition)
+        uses.push_back(pred->condition);
+    collectConditions(pred->left, uses);
+    collectConditions(pred->right, uses);
+}
+
+using PhiGates = std::unordered_map<PHINode *, std::vector<SSAGate>>;
+
+void summarize(const Item &item, const PhiGates &phiGates, ItemSummary &summary)
+{
+    collectConditions(item.Predicate, summary.uses);
+    if (auto inst = std::get_if<Instruction *>(&item.content))
+    {
+        summary.insts.push_back(*inst);
+        for (Value *op : (*inst)->operands())
+            summary.uses.push_back(op);
+        // A gated phi is lowered to selects on its gate predicates, so it
+        // reads their conditions even when every incoming value is constant.
+        if (auto *phi = dyn_cast<PHINode>(*inst))
+        {
+            auto gates = phiGates.find(phi);
+            if (gates != phiGates.end())
+            {
+                for (auto &gate : gates->second)
+                    collectConditions(gate.predicate, summary.uses);
+            }
+        }
+        if ((*inst)->mayReadOrWriteMemory())
+            summary.memoryInsts.push_back(*inst);
+        summary.writesMemory |= (*inst)->mayWriteToMemory();
+        summary.mayNotReturn |= !isGuaranteedToTransferExecutionToSuccessor(*inst);
+        summary.mayTrap |= !isSafeToSpeculativelyExecute(*inst);
+        summary.isTerminator |= (*inst)->isTerminator();
+        return;
+    }
+
+    auto *loop = std::get<SSALoop *>(item.content);
+    summary.mayNotReturn = true;
+    collectConditions(loop->whileCondition, summary.uses);
+    for (auto &binding : loop->muBindings)
+    {
+        if (auto init = std::get_if<Value *>(&binding.muNode->init))
+            summary.uses.push_back(*init);
+    }
+    for (const auto &bodyItem : loop->bodyItems)
+        summarize(bodyItem, phiGates, summary);
+}
+
+// Structurally equal predicates share a flat predicate id, which serves as the
+// item's class.
+std::vector<int> classifyPredicates(const FlatSSA &flat, const std::vector<Item> &items)
+{
+    std::vector<int> classes;
+    classes.reserve(items.size());
+    for (const auto &item : items)
+        classes.push_back(flat.predicate(flat.itemOf(item)));
+    return classes;
+}
+
+// The memory accesses of the items seen so far, indexed so that an access is
+// only tested against those it may conflict with. Accesses to two different
+// identified objects never conflict, so an access to an identified object
+// is tested against the accesses to the same object and against the
+// accesses to unknown objects. Those are tested against everything. Either
+// way, accesses sharing its base pointer are looked up by overlapping
+// constant offsets.
+class AccessIndex
+{
+public:
+    // Adds the items whose accesses may conflict with `inst` to `deps`.
+    void findConflicts(Instruction *inst, std::unordered_set<int> &deps) const
+    {
+        Key key = keyOf(inst);
+        writes.findConflicts(inst, key, deps);
+        if (inst->mayWriteToMemory())
+            reads.findConflicts(inst, key, deps);
+    }
+
+    void add(Instruction *inst, int item)
+    {
+        (inst->mayWriteToMemory() ? writes : reads).add(inst, keyOf(inst), item);
+    }
+
+private:
+    struct Key
+    {
+        // Null for an unknown object.
+        const Value *object = nullptr;
+        // Null when the access has no constant offset from a base pointer.
+        const Value *base = nullptr;
+        int64_t offset = 0;
+        int64_t size = 0;
+    };
+
+    struct Access
+    {
+        Instruction *inst;
+        int item;
+    };
+
+    struct Accesses
+    {
+        // By object, null for unknown ones, base pointer and constant offset
+        // from the base.
+        std::unordered_map<const Value *, std::unordered_map<const Value *, std::map<int64_t, std::vector<Access>>>>
+            objects;
+        int64_t maxSize = 0;
+
+        void add(Instruction *inst, const Key &key, int item)
+        {
+            objects[key.object][key.base][key.offset].push_back({inst, item});
+            maxSize = std::max(maxSize, key.size);
+        }
+
+        void findConflicts(Instruction *inst, const Key &key, std::unordered_set<int> &deps) const
+        {
+            auto test = [&](const Access &access) {
+                if (!deps.count(access.item) && mayConflict(access.inst, inst))
+                    deps.insert(access.item);
+            };
+            for (const auto &[object, bases] : objects)
+            {
+                if (key.object && object && object != key.object)
+                    continue;
+                for (const auto &[base, offsets] : bases)
+                {
+                    // Earlier accesses from the same base that may overlap
+                    // start less than maxSize bytes before this one.
+                    auto first = offsets.begin(), last = offsets.end();
+                    if (key.base && base == key.base)
+                    {
+                        first = offsets.lower_bound(key.offset - maxSize + 1);
+                        last = offsets.lower_bound(key.offset + key.size);
+                    }
+                    for (auto it = first; it != last; ++it)
+                    {
+                        for (const Access &access : it->second)
+                            test(access);
+                    }
+                }
+            }
+        }
+    };
+
+    Accesses reads, writes;
+
+    static Key keyOf(Instruction *inst)
+    {
+        Key key;
+        Value *ptr = getLoadStorePointerOperand(inst);
+        if (!ptr)
+            return key;
+        const DataLayout &DL = inst->getModule()->getDataLayout();
+        if (!getConstantOffset(ptr, DL, key.base, key.offset))
+        {
+            key.base = nullptr;
+            return key;
+        }
+        const Value *object = getUnderlyingObject(ptr);
+        if (isIdentifiedObject(object))
+            key.object = object;
+        key.size = DL.getTypeStoreSize(getLoadStoreType(inst));
+        return key;
+    }
+};
+
+void scheduleScope(const FlatSSA &flat, const PhiGates &phiGates, std::vector<Item> &items)
+{
+    for (auto &item : items)
+    {
+        if (auto loop = std::get_if<SSALoop *>(&item.content))
+            scheduleScope(flat, phiGates, (*loop)->bodyItems);
+    }
+
+    size_t n = items.size();
+    if (n < 3)
+        return;
+
+    std::vector<ItemSummary> summaries(n);
+    std::unordered_map<Value *, int> definedBy;
+    for (size_t i = 0; i < n; i++)
+    {
+        summarize(items[i], phiGates, summaries[i]);
+        for (auto *inst : summaries[i].insts)
+            definedBy[inst] = i;
+    }
+
+    // Edges only point forward in the original order, so loop-carried uses
+    // (mu recurrences) never constrain the schedule.
+    std::vector<std::vector<int>> successors(n);
+    std::vector<int> inDegree(n, 0);
+    auto addEdge = [&](int from, int to)
+    {
+        successors[from].push_back(to);
+        inDegree[to]++;
+    };
+
+    AccessIndex accesses;
+    int lastBarrier = -1;
+    std::vector<int> sideEffectsSinceBarrier;
+    for (size_t j = 0; j < n; j++)
+    {
+        const ItemSummary &sj = summaries[j];
+        std::unordered_set<int> deps;
+        for (Value *use : sj.uses)
+        {
+            auto it = definedBy.find(use);
+            if (it != definedBy.end() && it->second < static_cast<int>(j))
+                deps.insert(it->second);
+        }
+        for (auto *inst : sj.memoryInsts)
+            accesses.findConflicts(inst, deps);
+        for (auto *inst : sj.memoryInsts)
+            accesses.add(inst, j);
+
+        // Nothing with side effects crosses an item that may stop execution,
+        // nor does anything that may trap, and returns stay put relative to
+        // everything.
+        bool hasSideEffects = sj.writesMemory || sj.mayNotReturn;
+        if (sj.isTerminator)
+        {
+            for (size_t i = 0; i < j; i++)
+                deps.insert(i);
+        }
+        else if ((hasSideEffects || sj.mayTrap) && lastBarrier >= 0)
+        {
+            deps.insert(lastBarrier);
+        }
+        if (sj.mayNotReturn || sj.isTerminator)
+        {
+            for (int i : sideEffectsSinceBarrier)
+                deps.insert(i);
+            sideEffectsSinceBarrier.clear();
+            lastBarrier = j;
+        }
+        else if (hasSideEffects)
+        {
+            sideEffectsSinceBarrier.push_back(j);
+        }
+
+        for (int i : deps)
+            addEdge(i, j);
+    }
+
+    // List scheduling: keep emitting ready items of the current predicate and
+    // only switch predicates when none is left, preferring original order.
+    std::vector<int> classes = classifyPredicates(flat, items);
+    std::vector<std::set<int>> readyByClass(*std::max_element(classes.begin(), classes.end()) + 1);
+    std::set<int> ready;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (inDegree[i] == 0)
+        {
+            ready.insert(i);
+            readyByClass[classes[i]].insert(i);
+        }
+    }
+
+    std::vector<Item> scheduled;
+    scheduled.reserve(n);
+    int currentClass = classes[0];
+    while (!ready.empty())
+    {
+        int next = readyByClass[currentClass].empty() ? *ready.begin() : *readyByClass[currentClass].begin();
+        currentClass = classes[next];
+        ready.erase(next);
+        readyByClass[currentClass].erase(next);
+        scheduled.push_back(items[next]);
+        for (int succ : successors[next])
+        {
+            if (--inDegree[succ] == 0)
+            {
+                ready.insert(succ);
+                readyByClass[classes[succ]].insert(succ);
+            }
+        }
+    }
+    items = scheduled;
+}
+
+}
+
+void schedulePredicatedSSA(SSAFunction &function)
+{
+    FlatSSA flat(function);
+    scheduleScope(flat, function.phiGates, function.items);
+}
@@ -0,0 +1,12 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "predicatedSSA.h"
+
+// Reorders the items of every scope, respecting data, memory and control
+// dependences, so that items under the same predicate become contiguous.
+// Lowering opens one predicate region per run of equal predicates, so fewer
+// runs means fewer branches; it also brings packable items together.
+void schedulePredicatedSSA(SSAFunction &function);
+
+#endif
@@ -0,0 +1,230 @@
+#include "simdClones.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+using namespace llvm;
+
+namespace
+{
+
+// Larger callees are left scalar: every call site of them would have to be
+// packed to pay for the clones.
+const unsigned MaxCloneSize = 32;
+
+bool isWidenableType(Type *type)
+{
+    return VectorType::isValidElementType(type) && !type->isPointerTy();
+}
+
+bool isClonable(Function &F)
+{
+    if (F.isDeclaration() || F.isInterposable() || F.isVarArg() || F.size() != 1 ||
+        F.hasFnAttribute(Attribute::OptimizeNone) || !isWidenableType(F.getReturnType()))
+        return false;
+    for (Argument &arg : F.args())
+    {
+        if (!isWidenableType(arg.getType()))
+            return false;
+    }
+    BasicBlock &block = F.getEntryBlock();
+    if (block.size() > MaxCloneSize + 1)
+        return false;
+    for (Instruction &I : block)
+    {
+        if (isa<ReturnInst>(I))
+            continue;
+        if (!isa<BinaryOperator>(I) && !isa<UnaryOperator>(I) && !isa<CastInst>(I) && !isa<CmpInst>(I) &&
+            !isa<SelectInst>(I))
+            return false;
+        if (!isWidenableType(I.getType()))
+            return false;
+        for (Value *operand : I.operands())
+        {
+            if (!isWidenableType(operand->getType()))
+                return false;
+        }
+    }
+    return true;
+}
+
+// The variant of `F` for `width` lanes; `mapping` is set to its entry in the
+// variant attribute. Null when a function of that name exists already: it is
+// not ours to reuse, nor to erase once unused.
+Function *cloneForWidth(Function &F, unsigned width, std::string &mapping)
+{
+    std::string name = ("_ZGV" + Twine(VFABI::_LLVM_) + "N" + Twine(width) + std::string(F.arg_size(), 'v') + "_" +
+                        F.getName())
+                           .str();
+    mapping = VFABI::mangleTLIVectorName(name, F.getName(), F.arg_size(), ElementCount::getFixed(width));
+    if (F.getParent()->getFunction(name))
+        return nullptr;
+
+    std::vector<Type *> params;
+    for (Argument &arg : F.args())
+        params.push_back(FixedVectorType::get(arg.getType(), width));
+    auto *type = FunctionType::get(FixedVectorType::get(F.getReturnType(), width), params, false);
+    Function *clone = Function::Create(type, GlobalValue::InternalLinkage, name, F.getParent());
+    // Parameter attributes such as signext do not apply to vectors; the
+    // function attributes carry the target the body is compiled for.
+    clone->setCallingConv(F.getCallingConv());
+    clone->addFnAttrs(AttrBuilder(F.getContext(), F.getAttributes().getFnAttrs()));
+    clone->setDoesNotAccessMemory();
+    clone->setDoesNotThrow();
+    clone->addFnAttr(Attribute::WillReturn);
+
+    IRBuilder<> builder(BasicBlock::Create(F.getContext(), "entry", clone));
+    DenseMap<Value *, Value *> vectors;
+    for (auto [arg, vector] : zip(F.args(), clone->args()))
+    {
+        vector.setName(arg.getName());
+        vectors[&arg] = &vector;
+    }
+    auto vectorOf = [&](Value *value) -> Value * {
+        if (Value *vector = vectors.lookup(value))
+            return vector;
+        return ConstantVector::getSplat(ElementCount::getFixed(width), cast<Constant>(value));
+    };
+    for (Instruction &I : F.getEntryBlock())
+    {
+        if (auto *ret = dyn_cast<ReturnInst>(&I))
+        {
+            builder.CreateRet(vectorOf(ret->getReturnValue()));
+            break;
+        }
+        Value *vector;
+        if (auto *conversion = dyn_cast<CastInst>(&I))
+            vector = builder.CreateCast(conversion->getOpcode(), vectorOf(conversion->getOperand(0)),
+                                        FixedVectorType::get(conversion->getDestTy(), width));
+        else if (auto *cmp = dyn_cast<CmpInst>(&I))
+            vector = builder.CreateCmp(cmp->getPredicate(), vectorOf(cmp->getOperand(0)), vectorOf(cmp->getOperand(1)));
+        else if (auto *select = dyn_cast<SelectInst>(&I))
+            vector = builder.CreateSelect(vectorOf(select->getCondition()), vectorOf(select->getTrueValue()),
+                                          vectorOf(select->getFalseValue()));
+        else if (auto *unary = dyn_cast<UnaryOperator>(&I))
+            vector = builder.CreateUnOp(unary->getOpcode(), vectorOf(unary->getOperand(0)));
+        else
+            vector = builder.CreateBinOp(cast<BinaryOperator>(I).getOpcode(), vectorOf(I.getOperand(0)),
+                                         vectorOf(I.getOperand(1)));
+        if (auto *inst = dyn_cast<Instruction>(vector))
+            inst->copyIRFlags(&I);
+        vector->setName(I.getName());
+        vectors[&I] = vector;
+    }
+    return clone;
+}
+
+// Variants taking a mask or scalar arguments, such as uniform or linear
+// ones, are not used: lowering passes every argument as a vector of lanes.
+bool isPlainVariant(const VFInfo &info)
+{
+    return !info.Shape.VF.isScalable() && all_of(info.Shape.Parameters, [](const VFParameter &param) {
+        return param.ParamKind == VFParamKind::Vector;
+    });
+}
+
+} // namespace
+
+std::vector<Function *> createSimdClones(Module &M, unsigned maxWidth)
+{
+    std::vector<Function *> candidates;
+    for (Function &F : M)
+    {
+        if (!F.use_empty() && isClonable(F))
+            candidates.push_back(&F);
+    }
+
+    std::vector<Function *> clones;
+    for (Function *F : candidates)
+    {
+        SmallVector<std::string, 8> mappings;
+        for (unsigned width = 2; width <= maxWidth; width *= 2)
+        {
+            std::string mapping;
+            if (Function *clone = cloneForWidth(*F, width, mapping))
+            {
+                clones.push_back(clone);
+                mappings.push_back(mapping);
+            }
+        }
+        if (mappings.empty())
+            continue;
+        F->setDoesNotAccessMemory();
+        F->setDoesNotThrow();
+        F->addFnAttr(Attribute::WillReturn);
+        for (User *user : F->users())
+        {
+            auto *call = dyn_cast<CallInst>(user);
+            if (!call || call->getCalledFunction() != F)
+                continue;
+            SmallVector<std::string, 8> names;
+            VFABI::getVectorVariantNames(*call, names);
+            for (const std::string &mapping : mappings)
+            {
+                if (!is_contained(names, mapping))
+                    names.push_back(mapping);
+            }
+            VFABI::setVectorVariantNames(call, names);
+        }
+    }
+    return clones;
+}
+
+void dropUnusedSimdClones(Module &M, const std::vector<Function *> &clones)
+{
+    SmallPtrSet<Function *, 16> unused;
+    for (Function *clone : clones)
+    {
+        if (clone->use_empty())
+            unused.insert(clone);
+    }
+    if (unused.empty())
+        return;
+
+    for (Function &F : M)
+    {
+        for (Instruction &I : instructions(F))
+        {
+            auto *call = dyn_cast<CallInst>(&I);
+            if (!call || !call->getAttributes().hasFnAttr(VFABI::MappingsAttrName))
+                continue;
+            SmallVector<std::string, 8> names, kept;
+            VFABI::getVectorVariantNames(*call, names);
+            for (const std::string &name : names)
+            {
+                auto info = VFABI::tryDemangleForVFABI(name, M);
+                if (!info || !unused.count(M.getFunction(info->VectorName)))
+                    kept.push_back(name);
+            }
+            if (kept.empty())
+                call->setAttributes(
+                    call->getAttributes().removeFnAttribute(call->getContext(), VFABI::MappingsAttrName));
+            else
+                VFABI::setVectorVariantNames(call, kept);
+        }
+    }
+    for (Function *clone : unused)
+        clone->eraseFromParent();
+}
+
+bool hasVectorVariants(const CallInst &call)
+{
+    return any_of(VFDatabase::getMappings(call), isPlainVariant);
+}
+
+Function *vectorVariant(const CallInst &call, unsigned width)
+{
+    for (const VFInfo &info : VFDatabase::getMappings(call))
+    {
+        if (!isPlainVariant(info) || info.Shape.VF.getFixedValue() != width)
+            continue;
+        Function *variant = call.getModule()->getFunction(info.VectorName);
+        if (variant && variant->arg_size() == call.arg_size())
+            return variant;
+    }
+    return nullptr;
+}
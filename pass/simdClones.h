@@ -0,0 +1,37 @@
+#ifndef SIMDCLONES_H
+#define SIMDCLONES_H
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include <vector>
+
+// Gives every small pure function of `M` that is called somewhere vector
+// variants of 2, 4, ... up to `maxWidth` lanes, so that the packer can turn
+// isomorphic calls to it into one vector call. A function qualifies when it
+// is a single block of at most a few dozen arithmetic instructions, casts,
+// compares and selects on scalar, non-pointer values; such a function cannot
+// touch memory, unwind or loop, and its clone applies the same instructions
+// to vectors, lane by lane.
+//
+// Clones are named after the Vector Function ABI, _ZGV_LLVM_N<lanes><v per
+// argument>_<name>, and the calls to the scalar function carry them in their
+// vector-function-abi-variant attribute, where the loop vectorizer finds
+// them too. A width whose name some function of `M` already has gets no
+// clone. The scalar function is marked as not accessing memory, not
+// unwinding and returning, which its body proves. Returns the clones created,
+// the only ones dropUnusedSimdClones may erase.
+std::vector<llvm::Function *> createSimdClones(llvm::Module &M, unsigned maxWidth);
+
+// Erases the clones in `clones` that no call ended up using, and drops them
+// from the variant attributes of the remaining scalar calls.
+void dropUnusedSimdClones(llvm::Module &M, const std::vector<llvm::Function *> &clones);
+
+// Whether `call` names an unmasked vector variant of its callee whose
+// arguments are all vectors.
+bool hasVectorVariants(const llvm::CallInst &call);
+
+// The unmasked variant of the callee of `call` that takes and returns
+// vectors of `width` lanes, or null when there is none.
+llvm::Function *vectorVariant(const llvm::CallInst &call, unsigned width);
+
+#endif
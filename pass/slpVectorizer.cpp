@@ -8,8 +8,24 @@
 #include <memory>
 #include <cassert>
 #include <algorithm>
+#include <limits>
+#include <map>
+#include <tuple>
 #include "predicatedSSA.h"
 #include "slpVectorizer.h"
+#include "dependence.h"
+#include "flatSSA.h"
+#include "vectorCalls.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Module.h"
 
 using namespace llvm;
 
@@ -18,29 +34,18 @@ bool operator==(const VectorPack &a, const VectorPack &b)
     return a.instructions == b.instructions;
 }
 
-static void buildMaps(std::unordered_map<Instruction *, SSAPredicate *> &instructionPredicates, const std::vector<Item> &items)
+// Arithmetic seeds are runs of same-opcode, same-predicate instructions that
+// are adjacent in the item list. Calls must also share their callee, which
+// needs a vector form. Where only the predicate breaks a run, the two
+// instructions either side of the break are seeded as well, so the packer
+// reports them as lanes under different predicates.
+static void findArithmeticSeeds(const FlatSSA &flat, const std::vector<Item> &items, const TargetLibraryInfo *TLI,
+                                std::vector<std::vector<Instruction *>> &seeds)
 {
-    for (const auto &item : items)
-    {
-        if (std::holds_alternative<llvm::Instruction *>(item.content))
-        {
-            auto *inst = std::get<llvm::Instruction *>(item.content);
-            instructionPredicates[inst] = item.Predicate;
-        }
-        else
-        {
-            auto *loop = std::get<SSALoop *>(item.content);
-            buildMaps(instructionPredicates, loop->bodyItems);
-        }
-    }
-}
-
-static std::vector<std::vector<Instruction *>> findSeeds(const std::unordered_map<Instruction *, SSAPredicate *> &instructionPredicates, const std::vector<Item> &items)
-{
-    std::vector<std::vector<Instruction *>> seeds;
     std::vector<Instruction *> currentGroup;
     unsigned lastOpcode = 0;
-    SSAPredicate *lastPred = nullptr;
+    unsigned lastPred = FlatSSA::None;
+    const Value *lastCallee = nullptr;
 
     for (const auto &item : items)
     {
@@ -48,14 +53,17 @@ static std::vector<std::vector<Instruction *>> findSeeds(const std::unordered_ma
         {
             auto *inst = std::get<llvm::Instruction *>(item.content);
             unsigned opcode = inst->getOpcode();
-            SSAPredicate *pred = instructionPredicates.at(inst);
+            unsigned pred = flat.predicate(flat.itemOf(inst));
+            auto *call = dyn_cast<CallInst>(inst);
+            const Value *callee = call ? call->getCalledOperand() : nullptr;
 
-            if (!SLPPacker::isVectorizable(opcode))
+            if (!SLPPacker::isVectorizable(opcode) || isa<LoadInst>(inst) || isa<StoreInst>(inst) ||
+                (call && !isVectorizableCall(*call, TLI)))
             {
                 continue;
             }
 
-            if (opcode == lastOpcode && SLPPacker::predicatesEqual(pred, lastPred))
+            if (opcode == lastOpcode && pred == lastPred && callee == lastCallee)
             {
                 currentGroup.push_back(inst);
             }
@@ -65,9 +73,14 @@ static std::vector<std::vector<Instruction *>> findSeeds(const std::unordered_ma
                 {
                     seeds.push_back(currentGroup);
                 }
+                if (opcode == lastOpcode && callee == lastCallee)
+                {
+                    seeds.push_back({currentGroup.back(), inst});
+                }
                 currentGroup = {inst};
                 lastOpcode = opcode;
                 lastPred = pred;
+                lastCallee = callee;
             }
         }
         else
@@ -80,11 +93,9 @@ static std::vector<std::vector<Instruction *>> findSeeds(const std::unordered_ma
                 }
                 currentGroup.clear();
                 lastOpcode = 0;
-                lastPred = nullptr;
+                lastPred = FlatSSA::None;
+                lastCallee = nullptr;
             }
-            auto *loop = std::get<SSALoop *>(item.content);
-            auto loopSeeds = findSeeds(instructionPredicates, loop->bodyItems);
-            seeds.insert(seeds.end(), loopSeeds.begin(), loopSeeds.end());
         }
     }
 
@@ -92,7 +103,142 @@ static std::vector<std::vector<Instruction *>> findSeeds(const std::unordered_ma
     {
         seeds.push_back(currentGroup);
     }
+}
+
+struct MemoryAccess
+{
+    unsigned bucket;
+    int64_t offset;
+    int index;
+    Instruction *inst;
+};
+
+// Memory seeds are collected over the whole scope: loads and stores are
+// bucketed by kind, underlying object, element type and predicate and sorted
+// by constant offset, so a consecutive chain ends up as neighbouring entries
+// however far apart its accesses are. Each chain is then cut into lane-width
+// seeds. Accesses to the same offset under other predicates, such as the two
+// arms of an if/else, are in other buckets and do not break the chain.
+//
+// Accesses left out of every chain may still be members of an interleaved
+// group whose other members are never accessed: runs with a constant stride
+// of 2 to 4 elements become strided seeds. When every member is accessed the
+// group is one chain instead, and the packs reading single members take
+// their lanes from its vectors with shuffles.
+static const unsigned MaxStride = 4;
+
+// `singles` are sorted by bucket and offset.
+static void findStridedSeeds(const std::vector<MemoryAccess> &singles, int laneWidth,
+                             std::vector<std::vector<Instruction *>> &seeds)
+{
+    std::map<std::pair<unsigned, int64_t>, size_t> byOffset;
+    for (size_t i = 0; i < singles.size(); i++)
+        byOffset.emplace(std::make_pair(singles[i].bucket, singles[i].offset), i);
+
+    std::vector<bool> used(singles.size(), false);
+    for (unsigned stride = 2; stride <= MaxStride; stride++)
+    {
+        for (size_t i = 0; i < singles.size(); i++)
+        {
+            if (used[i])
+                continue;
+            Instruction *first = singles[i].inst;
+            int64_t step = stride * first->getModule()->getDataLayout().getTypeAllocSize(getLoadStoreType(first));
+
+            std::vector<size_t> run = {i};
+            while (static_cast<int>(run.size()) < laneWidth)
+            {
+                const MemoryAccess &last = singles[run.back()];
+                auto next = byOffset.find({last.bucket, last.offset + step});
+                if (next == byOffset.end() || used[next->second])
+                    break;
+                run.push_back(next->second);
+            }
+            if (run.size() < 2)
+                continue;
+
+            std::vector<Instruction *> seed;
+            for (size_t index : run)
+            {
+                used[index] = true;
+                seed.push_back(singles[index].inst);
+            }
+            seeds.push_back(seed);
+        }
+    }
+}
+
+static void findMemorySeeds(const FlatSSA &flat, const std::vector<Item> &items, int laneWidth,
+                            std::vector<std::vector<Instruction *>> &seeds)
+{
+    std::map<std::tuple<unsigned, const Value *, Type *, unsigned>, unsigned> buckets;
+    std::vector<MemoryAccess> accesses;
+    std::vector<MemoryAccess> singles;
 
+    for (int i = 0; i < items.size(); i++)
+    {
+        auto instr = std::get_if<Instruction *>(&items[i].content);
+        if (!instr || (!isa<LoadInst>(*instr) && !isa<StoreInst>(*instr)))
+            continue;
+
+        Instruction *inst = *instr;
+        const DataLayout &DL = inst->getModule()->getDataLayout();
+        const Value *base;
+        int64_t offset;
+        if (!getConstantOffset(getLoadStorePointerOperand(inst), DL, base, offset))
+            continue;
+        auto key = std::make_tuple(inst->getOpcode(), base, getLoadStoreType(inst), flat.predicate(flat.itemOf(inst)));
+        unsigned bucket = buckets.emplace(key, buckets.size()).first->second;
+        accesses.push_back({bucket, offset, i, inst});
+    }
+
+    std::sort(accesses.begin(), accesses.end(), [](const MemoryAccess &a, const MemoryAccess &b) {
+        return std::tie(a.bucket, a.offset, a.index) < std::tie(b.bucket, b.offset, b.index);
+    });
+
+    size_t begin = 0;
+    while (begin < accesses.size())
+    {
+        Instruction *first = accesses[begin].inst;
+        int64_t size = first->getModule()->getDataLayout().getTypeAllocSize(getLoadStoreType(first));
+
+        std::vector<Instruction *> chain = {first};
+        size_t end = begin + 1;
+        while (end < accesses.size() && accesses[end].bucket == accesses[begin].bucket &&
+               accesses[end].offset == accesses[end - 1].offset + size)
+        {
+            chain.push_back(accesses[end].inst);
+            end++;
+        }
+
+        for (size_t lane = 0; lane + 2 <= chain.size(); lane += laneWidth)
+        {
+            size_t last = std::min(chain.size(), lane + laneWidth);
+            seeds.emplace_back(chain.begin() + lane, chain.begin() + last);
+        }
+        if (chain.size() == 1)
+            singles.push_back(accesses[begin]);
+        begin = end;
+    }
+
+    findStridedSeeds(singles, laneWidth, seeds);
+}
+
+static std::vector<std::vector<Instruction *>> findSeeds(const FlatSSA &flat, const std::vector<Item> &items,
+                                                        int laneWidth, const TargetLibraryInfo *TLI)
+{
+    std::vector<std::vector<Instruction *>> seeds;
+    findMemorySeeds(flat, items, laneWidth, seeds);
+
+    // Runs longer than a vector, e.g. the per-field arithmetic of an
+    // unrolled loop over structs, are cut into lane-width seeds.
+    std::vector<std::vector<Instruction *>> runs;
+    findArithmeticSeeds(flat, items, TLI, runs);
+    for (auto &run : runs)
+    {
+        for (size_t lane = 0; lane + 2 <= run.size(); lane += laneWidth)
+            seeds.emplace_back(run.begin() + lane, run.begin() + std::min(run.size(), lane + laneWidth));
+    }
     return seeds;
 }
 
@@ -101,31 +247,18 @@ bool SLPPacker::isVectorizable(unsigned opcode)
 {
     return opcode == Instruction::Add || opcode == Instruction::FAdd ||
            opcode == Instruction::Mul || opcode == Instruction::FMul ||
-           opcode == Instruction::Load || opcode == Instruction::Store;
+           opcode == Instruction::Load || opcode == Instruction::Store ||
+           opcode == Instruction::Call;
 }
 
-bool SLPPacker::predicatesEqual(SSAPredicate *a, SSAPredicate *b)
+bool PackingOptions::isCold(const BasicBlock *block) const
 {
-    if (a == b)
-        return true;
-    if (!a || !b)
-        return false;
-    if (a->kind != b->kind)
-        return false;
-    switch (a->kind)
-    {
-    case SSAPredicate::True:
-        return true;
-    case SSAPredicate::Condition:
-        return a->condition == b->condition;
-    case SSAPredicate::Not:
-        return predicatesEqual(a->left, b->left);
-    case SSAPredicate::And:
-    case SSAPredicate::Or:
-        return predicatesEqual(a->left, b->left) && predicatesEqual(a->right, b->right);
-    default:
-        return false;
-    }
+    return BFI && PSI && PSI->hasProfileSummary() && PSI->isColdBlock(block, BFI);
+}
+
+unsigned SLPPacker::predicateOf(Instruction *inst) const
+{
+    return flat->predicate(flat->itemOf(inst));
 }
 
 bool SLPPacker::isUniformPredicate(const std::vector<Instruction *> &insts)
@@ -133,10 +266,10 @@ bool SLPPacker::isUniformPredicate(const std::vector<Instruction *> &insts)
     if (insts.empty())
         return true;
 
-    SSAPredicate *firstPred = instructionPredicates.at(insts[0]);
+    unsigned firstPred = predicateOf(insts[0]);
     for (size_t i = 1; i < insts.size(); i++)
     {
-        if (!predicatesEqual(instructionPredicates.at(insts[i]), firstPred))
+        if (predicateOf(insts[i]) != firstPred)
         {
             return false;
         }
@@ -144,91 +277,1030 @@ bool SLPPacker::isUniformPredicate(const std::vector<Instruction *> &insts)
     return true;
 }
 
-std::unordered_set<VectorPack, PackHash> SLPPacker::packInstructions(SSAFunction &function, int laneWidth)
+static const char *const RemarkPass = "super-vectorization";
+
+// Cost of running the lanes as scalars and as one vector instruction, in
+// reciprocal-throughput units. Strided memory packs access their whole
+// interleaved group at once. Other non-contiguous memory packs are lowered
+// lane by lane, so they only add the cost of moving values in or out of the
+// vector.
+// Arithmetic packs also pay for the operand vectors that lowering has to
+// build, which is what operand reordering saves. Call packs pay for their
+// vector form and the argument vectors it takes.
+std::pair<InstructionCost, InstructionCost> SLPPacker::packCost(const VectorPack &pack) const
+{
+    const TargetTransformInfo &TTI = *options.TTI;
+    const auto kind = TargetTransformInfo::TCK_RecipThroughput;
+    const auto &lanes = pack.instructions;
+    InstructionCost scalar = 0;
+    for (auto *inst : lanes)
+        scalar += TTI.getInstructionCost(inst, kind);
+
+    Instruction *first = lanes[0];
+    bool memory = isa<LoadInst>(first) || isa<StoreInst>(first);
+    auto *vectorType = FixedVectorType::get(memory ? getLoadStoreType(first) : first->getType(), pack.width());
+    InstructionCost vector;
+    if (auto *call = dyn_cast<CallInst>(first))
+    {
+        VectorCall form = vectorCallFor(lanes, pack.width(), options.TLI, &TTI);
+        scalar = form.scalarCost;
+        vector = form.cost;
+        for (unsigned argument = 0; argument < call->arg_size(); argument++)
+        {
+            if (form.intrinsic != Intrinsic::not_intrinsic && isScalarOperand(form.intrinsic, argument))
+                continue;
+            std::vector<Value *> operands;
+            for (auto *lane : lanes)
+                operands.push_back(cast<CallInst>(lane)->getArgOperand(argument));
+            vector += operandCost(operands, pack.width());
+        }
+    }
+    else if (!memory)
+    {
+        vector = TTI.getArithmeticInstrCost(first->getOpcode(), vectorType, kind);
+        for (unsigned side = 0; side < 2; side++)
+        {
+            std::vector<Value *> operands;
+            for (unsigned lane = 0; lane < lanes.size(); lane++)
+            {
+                bool swap = lane < pack.swapped.size() && pack.swapped[lane];
+                operands.push_back(lanes[lane]->getOperand(swap ? 1 - side : side));
+            }
+            vector += operandCost(operands, pack.width());
+        }
+    }
+    else if (pack.stride)
+    {
+        // Lowering masks the gaps of stores always, of loads only when the
+        // whole group is not known to be dereferenceable.
+        auto *groupType = FixedVectorType::get(getLoadStoreType(first), pack.stride * lanes.size());
+        bool maskGaps = isa<StoreInst>(first) ||
+                        !isDereferenceableAndAlignedPointer(getLoadStorePointerOperand(first), groupType,
+                                                            getLoadStoreAlignment(first),
+                                                            first->getModule()->getDataLayout());
+        vector = TTI.getInterleavedMemoryOpCost(first->getOpcode(), groupType, pack.stride, {0},
+                                                getLoadStoreAlignment(first), getLoadStoreAddressSpace(first), kind,
+                                                false, maskGaps);
+    }
+    else if (pack.contiguous && pack.padded)
+        vector = TTI.getMaskedMemoryOpCost(first->getOpcode(), vectorType, getLoadStoreAlignment(first),
+                                           getLoadStoreAddressSpace(first), kind);
+    else if (pack.contiguous)
+        vector = TTI.getMemoryOpCost(first->getOpcode(), vectorType, getLoadStoreAlignment(first),
+                                     getLoadStoreAddressSpace(first), kind);
+    else
+        vector = scalar + TTI.getScalarizationOverhead(vectorType, APInt::getLowBitsSet(pack.width(), lanes.size()),
+                                                       isa<LoadInst>(first), isa<StoreInst>(first));
+    return {scalar, vector};
+}
+
+// Mirrors gatherLanes in the lowering: a vector a pack already produces in
+// lane order is free, a splat is one insert and a broadcast, lanes all taken
+// from one or two such vectors are one shuffle, and any other operand vector
+// is built one insert per non-constant lane. Lanes past the operands are
+// padding and cost nothing.
+InstructionCost SLPPacker::operandCost(const std::vector<Value *> &operands, unsigned width) const
 {
-    instructionPredicates.clear();
-    buildMaps(instructionPredicates, function.items);
-    auto seeds = findSeeds(instructionPredicates, function.items);
+    const TargetTransformInfo &TTI = *options.TTI;
+    auto *vectorType = FixedVectorType::get(operands[0]->getType(), width);
 
-    std::unordered_set<VectorPack, PackHash> packs;
+    auto it = vectorLanes.find(operands[0]);
+    bool reuse = it != vectorLanes.end() && it->second.width == width;
+    for (unsigned lane = 0; reuse && lane < operands.size(); lane++)
+    {
+        auto laneIt = vectorLanes.find(operands[lane]);
+        reuse = laneIt != vectorLanes.end() && laneIt->second.pack == it->second.pack && laneIt->second.lane == lane;
+    }
+    if (reuse)
+        return 0;
 
-    for (const auto &seedGroup : seeds)
+    if (std::all_of(operands.begin(), operands.end(), [&](Value *operand) { return operand == operands[0]; }))
     {
-        if (seedGroup.size() >= 2 && static_cast<int>(seedGroup.size()) <= laneWidth && isUniformPredicate(seedGroup))
+        if (isa<Constant>(operands[0]))
+            return 0;
+        return TTI.getVectorInstrCost(Instruction::InsertElement, vectorType, 0) +
+               TTI.getShuffleCost(TargetTransformInfo::SK_Broadcast, vectorType);
+    }
+
+    std::vector<const Instruction *> sources;
+    unsigned sourceWidth = 0;
+    for (Value *operand : operands)
+    {
+        auto laneIt = vectorLanes.find(operand);
+        if (laneIt == vectorLanes.end() || (sourceWidth && laneIt->second.width != sourceWidth))
         {
-            VectorPack pack;
-            pack.instructions = seedGroup;
-            pack.predicate = instructionPredicates[seedGroup[0]];
-            packs.insert(pack);
+            sources.clear();
+            break;
         }
+        sourceWidth = laneIt->second.width;
+        if (std::find(sources.begin(), sources.end(), laneIt->second.pack) == sources.end())
+            sources.push_back(laneIt->second.pack);
     }
+    if (!sources.empty() && sources.size() <= 2)
+        return TTI.getShuffleCost(sources.size() == 1 ? TargetTransformInfo::SK_PermuteSingleSrc
+                                                       : TargetTransformInfo::SK_PermuteTwoSrc,
+                                  FixedVectorType::get(operands[0]->getType(), sourceWidth));
+
+    APInt inserted(width, 0);
+    for (unsigned lane = 0; lane < operands.size(); lane++)
+        if (!isa<Constant>(operands[lane]))
+            inserted.setBit(lane);
+    if (inserted.isZero())
+        return 0;
+    return TTI.getScalarizationOverhead(vectorType, inserted, /*Insert=*/true, /*Extract=*/false);
+}
+
+// How much better an operand vector gets when `current` sits in the lane
+// right after `previous`.
+int SLPPacker::operandAffinity(Value *previous, Value *current) const
+{
+    if (previous == current)
+        return 2;
+    if (isa<Constant>(previous) && isa<Constant>(current))
+        return 2;
 
-    std::unordered_map<Instruction *, int> instToIndex;
-    for (int i = 0; i < function.items.size(); i++)
+    auto previousLane = vectorLanes.find(previous);
+    auto currentLane = vectorLanes.find(current);
+    if (previousLane != vectorLanes.end() && currentLane != vectorLanes.end() &&
+        previousLane->second.pack == currentLane->second.pack &&
+        previousLane->second.lane + 1 == currentLane->second.lane)
+        return 3;
+
+    auto *previousLoad = dyn_cast<LoadInst>(previous);
+    auto *currentLoad = dyn_cast<LoadInst>(current);
+    if (previousLoad && currentLoad && previousLoad->getType() == currentLoad->getType())
     {
-        if (std::holds_alternative<llvm::Instruction *>(function.items[i].content))
+        const DataLayout &DL = currentLoad->getModule()->getDataLayout();
+        const Value *previousBase, *currentBase;
+        int64_t previousOffset, currentOffset;
+        if (getConstantOffset(previousLoad->getPointerOperand(), DL, previousBase, previousOffset) &&
+            getConstantOffset(currentLoad->getPointerOperand(), DL, currentBase, currentOffset) &&
+            previousBase == currentBase &&
+            previousOffset + (int64_t)DL.getTypeAllocSize(currentLoad->getType()) == currentOffset)
+            return 3;
+    }
+
+    auto *previousInst = dyn_cast<Instruction>(previous);
+    auto *currentInst = dyn_cast<Instruction>(current);
+    if (previousInst && currentInst && previousInst->getOpcode() == currentInst->getOpcode())
+        return 1;
+    return 0;
+}
+
+// Greedy, lane by lane: each lane keeps or swaps its operands, whichever
+// pairs them better with the operands chosen for the lane before.
+std::vector<bool> SLPPacker::orderOperands(const std::vector<Instruction *> &lanes) const
+{
+    if (!lanes[0]->isCommutative())
+        return {};
+    std::vector<bool> swapped(lanes.size(), false);
+
+    Value *left = lanes[0]->getOperand(0);
+    Value *right = lanes[0]->getOperand(1);
+    bool any = false;
+    for (unsigned lane = 1; lane < lanes.size(); lane++)
+    {
+        Value *first = lanes[lane]->getOperand(0);
+        Value *second = lanes[lane]->getOperand(1);
+        int keep = operandAffinity(left, first) + operandAffinity(right, second);
+        int swap = operandAffinity(left, second) + operandAffinity(right, first);
+        if (swap > keep)
         {
-            instToIndex[std::get<llvm::Instruction *>(function.items[i].content)] = i;
+            swapped[lane] = any = true;
+            std::swap(first, second);
         }
+        left = first;
+        right = second;
     }
+    if (!any)
+        return {};
+    return swapped;
+}
+
+static bool producesVector(const VectorPack &pack)
+{
+    Instruction *first = pack.instructions[0];
+    if (isa<LoadInst>(first))
+        return pack.contiguous || pack.stride;
+    return isa<BinaryOperator>(first) || isa<CallInst>(first);
+}
+
+void SLPPacker::addVectorLanes(const VectorPack &pack)
+{
+    if (!producesVector(pack))
+        return;
+    for (unsigned lane = 0; lane < pack.instructions.size(); lane++)
+        vectorLanes[pack.instructions[lane]] = {pack.instructions[0], lane, pack.width()};
+}
+
+void SLPPacker::removeVectorLanes(const VectorPack &pack)
+{
+    for (auto *inst : pack.instructions)
+        vectorLanes.erase(inst);
+}
+
+// "<lanes> x <opcode> under <predicate>", the subject of every pack remark.
+template <typename Remark>
+static Remark &describeLanes(Remark &remark, const FlatSSA &flat, const std::vector<Instruction *> &lanes)
+{
+    std::string predicate;
+    raw_string_ostream os(predicate);
+    PredicatedSSAPrinter::predicateToString(flat.predicateNode(flat.predicate(flat.itemOf(lanes[0]))), os);
+    return remark << ore::NV("Lanes", static_cast<unsigned>(lanes.size())) << " x " << lanes[0]->getOpcodeName()
+                  << " under " << ore::NV("Predicate", os.str());
+}
+
+void SLPPacker::remarkCost(const std::vector<Instruction *> &lanes, InstructionCost scalar, InstructionCost vector)
+{
+    if (!options.ORE)
+        return;
+    options.ORE->emit([&]() {
+        OptimizationRemarkAnalysis remark(RemarkPass, "PackCost", lanes[0]);
+        describeLanes(remark << "cost of ", *flat, lanes)
+            << ": scalar " << ore::NV("ScalarCost", scalar) << ", vector " << ore::NV("VectorCost", vector)
+            << ", delta " << ore::NV("CostDelta", vector - scalar);
+        return remark;
+    });
+}
+
+void SLPPacker::remarkMissed(const std::vector<Instruction *> &lanes, StringRef reason, const std::string &why)
+{
+    if (!options.ORE)
+        return;
+    options.ORE->emit([&]() {
+        OptimizationRemarkMissed remark(RemarkPass, reason, lanes[0]);
+        describeLanes(remark << "not packed: ", *flat, lanes) << ": " << why;
+        return remark;
+    });
+}
+
+void SLPPacker::remarkPacked(const VectorPack &pack)
+{
+    if (!options.ORE)
+        return;
+    options.ORE->emit([&]() {
+        OptimizationRemark remark(RemarkPass, "Packed", pack.instructions[0]);
+        describeLanes(remark << "packed ", *flat, pack.instructions);
+        if (pack.padded)
+            remark << " padded to " << ore::NV("Width", pack.width()) << " lanes";
+        if (options.TTI)
+        {
+            auto [scalar, vector] = packCost(pack);
+            remark << " (cost delta " << ore::NV("CostDelta", vector - scalar) << ")";
+        }
+        return remark;
+    });
+}
+
+// Positions of the items of one scope by flat item id. Items nested in a loop
+// map to the position of the loop; anything outside the scope maps to -1.
+// Entries left over from other scopes are recognised as stale by checking
+// that the item at the recorded position really contains the id.
+class ScopeIndex
+{
+public:
+    explicit ScopeIndex(const FlatSSA &flat) : flat(flat), positions(flat.numItems(), 0) {}
+
+    void build(const std::vector<Item> &items)
+    {
+        ids.assign(items.size(), FlatSSA::None);
+        update(items, 0, items.size());
+    }
+
+    // Re-reads the items from `first` to `last`, exclusive, after they were
+    // reordered among themselves.
+    void update(const std::vector<Item> &items, int first, int last)
+    {
+        for (int i = first; i < last; i++)
+        {
+            unsigned id = flat.itemOf(items[i]);
+            ids[i] = id;
+            for (unsigned k = id; k < flat.subtreeEnd(id); k++)
+                positions[k] = i;
+        }
+    }
+
+    int position(Instruction *inst) const
+    {
+        unsigned id = flat.itemOf(inst);
+        if (id == FlatSSA::None)
+            return -1;
+        unsigned pos = positions[id];
+        if (pos < ids.size() && ids[pos] <= id && id < flat.subtreeEnd(ids[pos]))
+            return pos;
+        return -1;
+    }
+
+    // Flat ids of the instructions held by the item at `pos`.
+    template <typename Fn> void forEachInstruction(int pos, Fn fn) const
+    {
+        for (unsigned k = ids[pos]; k < flat.subtreeEnd(ids[pos]); k++)
+        {
+            if (Instruction *inst = flat.instruction(k))
+                fn(inst);
+        }
+    }
+
+private:
+    const FlatSSA &flat;
+    std::vector<unsigned> positions;
+    std::vector<unsigned> ids;
+};
+
+// Registers live at each position of a scope, kept as a segment tree so that
+// adding a live range and taking the maximum over a span of positions are
+// both logarithmic. A node's pending amount applies to its whole span.
+class LiveCounts
+{
+public:
+    explicit LiveCounts(int size) : size(size), maxima(4 * size), pending(4 * size) {}
+
+    void add(int begin, int end, int amount) { add(1, 0, size, begin, end, amount); }
+
+    int max(int begin, int end) const { return max(1, 0, size, begin, end); }
+
+private:
+    int size;
+    std::vector<int> maxima;
+    std::vector<int> pending;
+
+    void add(unsigned node, int low, int high, int begin, int end, int amount)
+    {
+        if (end <= low || high <= begin)
+            return;
+        if (begin <= low && high <= end)
+        {
+            maxima[node] += amount;
+            pending[node] += amount;
+            return;
+        }
+        int middle = (low + high) / 2;
+        add(2 * node, low, middle, begin, end, amount);
+        add(2 * node + 1, middle, high, begin, end, amount);
+        maxima[node] = pending[node] + std::max(maxima[2 * node], maxima[2 * node + 1]);
+    }
+
+    int max(unsigned node, int low, int high, int begin, int end) const
+    {
+        if (end <= low || high <= begin)
+            return std::numeric_limits<int>::min() / 2;
+        if (begin <= low && high <= end)
+            return maxima[node];
+        int middle = (low + high) / 2;
+        return pending[node] + std::max(max(2 * node, low, middle, begin, end),
+                                        max(2 * node + 1, middle, high, begin, end));
+    }
+};
+
+// Estimate of the registers a scope needs at its busiest point, per register
+// class. A value is live from its item to the last item of the scope that
+// uses it; values used by a later iteration or outside the scope stay live
+// to the end. The lanes of a pack share one vector value, live from its
+// first lane to the last use of any lane. Values that die inside the item
+// defining them, such as temporaries of a nested loop, are priced when that
+// loop's own scope is packed.
+//
+// The ranges are found once per scope. Committing a pack only revisits the
+// ranges that begin or end among the items it moved and those its lanes
+// define or use, so the cost follows the pack rather than the scope.
+class RegisterPressure
+{
+public:
+    RegisterPressure(const TargetTransformInfo &TTI, const ScopeIndex &scope, int numItems)
+        : TTI(TTI), scope(scope), numItems(numItems), beginsAt(numItems + 1), endsAt(numItems + 1)
+    {
+        for (int pos = 0; pos < numItems; pos++)
+        {
+            scope.forEachInstruction(pos, [&](Instruction *inst) {
+                if (inst->getType()->isVoidTy())
+                    return;
+                int end = lastUse(inst, pos);
+                if (end <= pos)
+                    return;
+                rangeOf[inst] = ranges.size();
+                insert({pos, end, TTI.getRegisterClassForType(false, inst->getType()), 1, inst, nullptr});
+            });
+        }
+    }
+
+    // The register class that `lanes` as a pack would push past its limit,
+    // paired with the peak it would reach there. A class already over the
+    // limit only counts if the pack makes it worse.
+    Optional<std::pair<unsigned, unsigned>> excess(const std::vector<Instruction *> &lanes) const
+    {
+        if (lanes[0]->getType()->isVoidTy())
+            return None;
+
+        // Changes to the live registers of each class, as (position, change)
+        // steps; the peak can only rise between the first and last step.
+        std::map<unsigned, std::vector<std::pair<int, int>>> steps;
+        auto addSteps = [&](const Range &range, int sign) {
+            if (range.end <= range.begin || !range.registers)
+                return;
+            steps[range.regClass].emplace_back(range.begin, sign * int(range.registers));
+            steps[range.regClass].emplace_back(range.end, -sign * int(range.registers));
+        };
+        addSteps(packRange(lanes, nullptr), 1);
+        for (auto *inst : lanes)
+        {
+            auto found = rangeOf.find(inst);
+            if (found != rangeOf.end())
+                addSteps(ranges[found->second], -1);
+        }
+
+        for (auto &[regClass, classSteps] : steps)
+        {
+            std::sort(classSteps.begin(), classSteps.end());
+            auto counts = live.find(regClass);
+            int change = 0;
+            int peak = 0;
+            for (size_t next = 0; next < classSteps.size();)
+            {
+                int pos = classSteps[next].first;
+                while (next < classSteps.size() && classSteps[next].first == pos)
+                    change += classSteps[next++].second;
+                if (next == classSteps.size())
+                    break;
+                int busiest = counts == live.end() ? 0 : counts->second.max(pos, classSteps[next].first);
+                peak = std::max(peak, busiest + change);
+            }
+            unsigned available = TTI.getNumberOfRegisters(regClass);
+            int before = counts == live.end() ? 0 : counts->second.max(0, numItems);
+            if (unsigned(peak) > available && peak > before)
+                return std::make_pair(regClass, unsigned(peak));
+        }
+        return None;
+    }
+
+    // Records `lanes` as a pack once the scope index has been updated for
+    // the new item order. Item `first + i` of the old order moved to
+    // `moved[i]`; items outside that window kept their position.
+    void commit(const std::vector<Instruction *> &lanes, int first, const std::vector<int> &moved)
+    {
+        // A range that ended at a lane now ends wherever that lane went.
+        std::vector<unsigned> stale;
+        for (auto *inst : lanes)
+        {
+            for (Value *operand : inst->operands())
+            {
+                auto found = isa<Instruction>(operand) ? rangeOf.find(cast<Instruction>(operand)) : rangeOf.end();
+                if (found != rangeOf.end())
+                    stale.push_back(found->second);
+            }
+        }
+        for (auto *inst : lanes)
+        {
+            auto found = rangeOf.find(inst);
+            if (found != rangeOf.end())
+                erase(found->second);
+        }
+
+        auto shift = [&](int pos) {
+            return pos >= first && pos < first + int(moved.size()) ? moved[pos - first] : pos;
+        };
+        std::vector<unsigned> shifted;
+        for (int pos = first; pos < first + int(moved.size()); pos++)
+        {
+            shifted.insert(shifted.end(), beginsAt[pos].begin(), beginsAt[pos].end());
+            shifted.insert(shifted.end(), endsAt[pos].begin(), endsAt[pos].end());
+        }
+        std::sort(shifted.begin(), shifted.end());
+        shifted.erase(std::unique(shifted.begin(), shifted.end()), shifted.end());
+        for (unsigned index : shifted)
+            move(index, shift(ranges[index].begin), shift(ranges[index].end));
+
+        if (!lanes[0]->getType()->isVoidTy())
+        {
+            for (auto *inst : lanes)
+                rangeOf[inst] = ranges.size();
+            insert(packRange(lanes, &lanes));
+        }
+        for (unsigned index : stale)
+        {
+            Range &range = ranges[index];
+            if (!range.registers)
+                continue;
+            if (range.lanes)
+            {
+                Range updated = packRange(*range.lanes, range.lanes);
+                move(index, updated.begin, updated.end);
+            }
+            else
+            {
+                int begin = scope.position(range.value);
+                move(index, begin, lastUse(range.value, begin));
+            }
+        }
+    }
+
+private:
+    struct Range
+    {
+        int begin;
+        int end;
+        unsigned regClass;
+        unsigned registers;
+        // The scalar value or the lanes of the pack that the range belongs to.
+        Instruction *value;
+        const std::vector<Instruction *> *lanes;
+    };
+
+    const TargetTransformInfo &TTI;
+    const ScopeIndex &scope;
+    int numItems;
+    std::vector<Range> ranges;
+    std::unordered_map<Instruction *, unsigned> rangeOf;
+    // Ranges by the position they begin and end at.
+    std::vector<SmallVector<unsigned, 2>> beginsAt;
+    std::vector<SmallVector<unsigned, 2>> endsAt;
+    std::map<unsigned, LiveCounts> live;
+
+    int lastUse(Instruction *inst, int def) const
+    {
+        int end = def;
+        for (User *user : inst->users())
+        {
+            int pos = isa<Instruction>(user) ? scope.position(cast<Instruction>(user)) : -1;
+            if (pos < 0 || pos < def)
+                return numItems;
+            end = std::max(end, pos);
+        }
+        return end;
+    }
+
+    Range packRange(const std::vector<Instruction *> &lanes, const std::vector<Instruction *> *owner) const
+    {
+        int begin = numItems;
+        int end = 0;
+        for (auto *inst : lanes)
+        {
+            int def = scope.position(inst);
+            begin = std::min(begin, def);
+            end = std::max(end, lastUse(inst, def));
+        }
+        auto *vectorType = FixedVectorType::get(lanes[0]->getType(), lanes.size());
+        unsigned width = TTI.getRegisterBitWidth(TargetTransformInfo::RGK_FixedWidthVector).getFixedSize();
+        unsigned bits = vectorType->getPrimitiveSizeInBits().getFixedSize();
+        unsigned registers = width ? std::max(1u, (bits + width - 1) / width) : 1;
+        return {begin, end, TTI.getRegisterClassForType(true, vectorType), registers, nullptr, owner};
+    }
+
+    void count(const Range &range, int sign)
+    {
+        if (range.end > range.begin)
+            live.try_emplace(range.regClass, numItems).first->second.add(range.begin, range.end,
+                                                                          sign * int(range.registers));
+    }
+
+    void insert(const Range &range)
+    {
+        unsigned index = ranges.size();
+        ranges.push_back(range);
+        beginsAt[range.begin].push_back(index);
+        endsAt[range.end].push_back(index);
+        count(range, 1);
+    }
+
+    void erase(unsigned index)
+    {
+        Range &range = ranges[index];
+        count(range, -1);
+        erase_value(beginsAt[range.begin], index);
+        erase_value(endsAt[range.end], index);
+        range.registers = 0;
+    }
+
+    void move(unsigned index, int begin, int end)
+    {
+        Range &range = ranges[index];
+        count(range, -1);
+        erase_value(beginsAt[range.begin], index);
+        erase_value(endsAt[range.end], index);
+        range.begin = begin;
+        range.end = end;
+        beginsAt[begin].push_back(index);
+        endsAt[end].push_back(index);
+        count(range, 1);
+    }
+};
+
+// Lanes must agree on types so they fit one vector instruction.
+static bool isIsomorphic(const std::vector<Instruction *> &insts)
+{
+    Type *type = insts[0]->getType();
+    if (auto *store = dyn_cast<StoreInst>(insts[0]))
+        type = store->getValueOperand()->getType();
+    if (!VectorType::isValidElementType(type))
+        return false;
+
+    for (auto *inst : insts)
+    {
+        if (auto *load = dyn_cast<LoadInst>(inst))
+        {
+            if (!load->isSimple() || load->getType() != type)
+                return false;
+        }
+        else if (auto *store = dyn_cast<StoreInst>(inst))
+        {
+            if (!store->isSimple() || store->getValueOperand()->getType() != type)
+                return false;
+        }
+        else if (auto *call = dyn_cast<CallInst>(inst))
+        {
+            if (call->getType() != type || call->getCalledOperand() != cast<CallInst>(insts[0])->getCalledOperand())
+                return false;
+        }
+        else if (inst->getType() != type)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Element stride between neighbouring lanes of a load/store pack when it is
+// constant: 1 when lane i accesses the element right after lane i - 1, so the
+// pack can use a single wide access, up to MaxStride for a member of an
+// interleaved group; 0 otherwise.
+static unsigned strideOf(const std::vector<Instruction *> &insts)
+{
+    if (!isa<LoadInst>(insts[0]) && !isa<StoreInst>(insts[0]))
+        return 0;
+
+    const DataLayout &DL = insts[0]->getModule()->getDataLayout();
+    Type *type = getLoadStoreType(insts[0]);
+    int64_t size = DL.getTypeAllocSize(type);
+    if (DL.getTypeSizeInBits(type) != 8 * size)
+        return 0;
+
+    const Value *base0;
+    int64_t offset0;
+    if (!getConstantOffset(getLoadStorePointerOperand(insts[0]), DL, base0, offset0))
+        return 0;
+    unsigned stride = 0;
+    for (size_t lane = 1; lane < insts.size(); lane++)
+    {
+        const Value *base;
+        int64_t offset;
+        if (!getConstantOffset(getLoadStorePointerOperand(insts[lane]), DL, base, offset) || base != base0)
+            return 0;
+        if (lane == 1)
+        {
+            if (offset <= offset0 || (offset - offset0) % size || (offset - offset0) / size > MaxStride)
+                return 0;
+            stride = (offset - offset0) / size;
+        }
+        if (offset != offset0 + static_cast<int64_t>(lane * stride) * size)
+            return 0;
+    }
+    return stride;
+}
+
+// Lowering emits the whole pack at the position of its first lane, so every
+// other lane is hoisted over the items in between. That is only legal when
+// none of those items defines an operand of the lane or touches memory the
+// lane depends on.
+// With `assumed`, accesses to different underlying objects are taken not to
+// overlap, as a runtime check would guarantee, and the objects are recorded.
+static bool conflicts(Instruction *a, Instruction *b, ObjectPairs *assumed)
+{
+    if (!assumed || !mayConflictAcrossObjects(a, b))
+        return mayConflict(a, b);
+    assumed->insert({getUnderlyingObject(getLoadStorePointerOperand(a)),
+                     getUnderlyingObject(getLoadStorePointerOperand(b))});
+    return false;
+}
+
+static bool canSchedulePack(const ScopeIndex &scope, const std::vector<Instruction *> &insts,
+                            const std::vector<int> &indices, int minIndex, ObjectPairs *assumed = nullptr)
+{
+    std::unordered_set<Instruction *> members(insts.begin(), insts.end());
+    std::unordered_set<int> memberIndices(indices.begin(), indices.end());
+
+    for (size_t lane = 0; lane < insts.size(); lane++)
+    {
+        Instruction *inst = insts[lane];
+        int index = indices[lane];
+
+        for (Value *op : inst->operands())
+        {
+            auto *opInst = dyn_cast<Instruction>(op);
+            if (!opInst)
+                continue;
+            if (members.count(opInst))
+                return false;
+            int opIndex = scope.position(opInst);
+            if (opIndex > minIndex && opIndex < index)
+                return false;
+        }
+
+        if (!inst->mayReadOrWriteMemory())
+            continue;
+        bool conflict = false;
+        for (int k = minIndex + 1; k < index && !conflict; k++)
+        {
+            if (memberIndices.count(k))
+                continue;
+            scope.forEachInstruction(k, [&](Instruction *other) {
+                conflict = conflict || conflicts(inst, other, assumed);
+            });
+        }
+        if (conflict)
+            return false;
+    }
+    return true;
+}
+
+static bool predicateUses(SSAPredicate *pred, Value *value)
+{
+    if (!pred)
+        return false;
+    if (pred->kind == SSAPredicate::Condition)
+        return pred->condition == value;
+    return predicateUses(pred->left, value) || predicateUses(pred->right, value);
+}
+
+// Seeds gathered across a scope often have the value of a later lane computed
+// between the lanes, which rules out hoisting. Emitting the pack at its last
+// lane instead sinks every other lane, which is legal when nothing in between
+// reads a lane's result or touches memory the lane depends on.
+static bool canSinkPack(const std::vector<Item> &items, const ScopeIndex &scope, const std::vector<Instruction *> &insts, const std::vector<int> &indices, int maxIndex, ObjectPairs *assumed = nullptr)
+{
+    std::unordered_set<int> memberIndices(indices.begin(), indices.end());
+
+    for (size_t lane = 0; lane < insts.size(); lane++)
+    {
+        Instruction *inst = insts[lane];
+        int index = indices[lane];
+
+        for (User *user : inst->users())
+        {
+            auto *userInst = dyn_cast<Instruction>(user);
+            int userIndex = userInst ? scope.position(userInst) : -1;
+            if (userIndex > index && userIndex <= maxIndex)
+                return false;
+        }
+
+        for (int k = index + 1; k < maxIndex; k++)
+        {
+            if (memberIndices.count(k))
+                continue;
+            if (predicateUses(items[k].Predicate, inst))
+                return false;
+            if (!inst->mayReadOrWriteMemory())
+                continue;
+            bool conflict = false;
+            scope.forEachInstruction(k, [&](Instruction *other) {
+                conflict = conflict || conflicts(inst, other, assumed);
+            });
+            if (conflict)
+                return false;
+        }
+    }
+    return true;
+}
+
+// A pack whose lane count is not a power of two is either padded to the next
+// power of two or cut down to the largest power of two it holds, with the
+// lanes cut off queued as a seed of their own. The cost model decides,
+// pricing the cut-off lanes as scalars; without one the pack is cut, which
+// never needs masked memory operations.
+void SLPPacker::shapeOddPack(VectorPack &pack, std::vector<std::vector<Instruction *>> &seeds) const
+{
+    const auto &lanes = pack.instructions;
+    size_t head = PowerOf2Floor(lanes.size());
+
+    VectorPack cut = pack;
+    cut.instructions.resize(head);
+    unsigned stride = strideOf(cut.instructions);
+    cut.contiguous = stride == 1;
+    cut.stride = stride > 1 ? stride : 0;
+    cut.swapped = orderOperands(cut.instructions);
+
+    // Interleaved groups are not padded: the padding lanes would fall
+    // between the members of the next group. Neither are calls, whose
+    // callee would run on the poison lanes.
+    if (options.TTI && !pack.stride && !isa<CallInst>(lanes[0]))
+    {
+        VectorPack padded = pack;
+        padded.padded = true;
+        InstructionCost paddedCost = packCost(padded).second;
+        InstructionCost cutCost = packCost(cut).second;
+        for (size_t lane = head; lane < lanes.size(); lane++)
+            cutCost += options.TTI->getInstructionCost(lanes[lane], TargetTransformInfo::TCK_RecipThroughput);
+        if (paddedCost.isValid() && paddedCost < cutCost)
+        {
+            pack = padded;
+            return;
+        }
+    }
+
+    if (lanes.size() - head >= 2)
+        seeds.emplace_back(lanes.begin() + head, lanes.end());
+    pack = cut;
+}
+
+void SLPPacker::packScope(std::vector<Item> &items, int laneWidth, std::unordered_set<VectorPack, PackHash> &goodPacks)
+{
+    for (auto &item : items)
+    {
+        if (std::holds_alternative<SSALoop *>(item.content))
+        {
+            packScope(std::get<SSALoop *>(item.content)->bodyItems, laneWidth, goodPacks);
+        }
+    }
+
+    auto seeds = findSeeds(*flat, items, laneWidth, options.TLI);
+
+    std::vector<VectorPack> packs;
+
+    // Cutting an odd-sized seed may queue its remainder as a further seed.
+    for (size_t seed = 0; seed < seeds.size(); seed++)
+    {
+        std::vector<Instruction *> seedGroup = seeds[seed];
+        if (seedGroup.size() < 2)
+            continue;
+        if (static_cast<int>(seedGroup.size()) > laneWidth)
+        {
+            remarkMissed(seedGroup, "TooWide", "more lanes than the vector width of " + std::to_string(laneWidth));
+            continue;
+        }
+        if (!isUniformPredicate(seedGroup))
+        {
+            remarkMissed(seedGroup, "NonUniformPredicate", "lanes run under different predicates");
+            continue;
+        }
+        if (!isIsomorphic(seedGroup))
+        {
+            remarkMissed(seedGroup, "NotIsomorphic", "lanes differ in opcode or type");
+            continue;
+        }
+
+        VectorPack pack;
+        pack.instructions = seedGroup;
+        pack.predicate = flat->predicateNode(predicateOf(seedGroup[0]));
+        unsigned stride = strideOf(seedGroup);
+        pack.contiguous = stride == 1;
+        pack.stride = stride > 1 ? stride : 0;
+        pack.swapped = orderOperands(seedGroup);
+        if (options.isCold(seedGroup[0]->getParent()))
+        {
+            remarkMissed(seedGroup, "Cold", "the profile marks the block as cold");
+            continue;
+        }
+        if (!isPowerOf2_64(seedGroup.size()))
+            shapeOddPack(pack, seeds);
+        if (isa<CallInst>(pack.instructions[0]) &&
+            !vectorCallFor(pack.instructions, pack.width(), options.TLI, options.TTI).exists())
+        {
+            remarkMissed(pack.instructions, "NoVectorForm",
+                         "the callee has no vector form of " + std::to_string(pack.width()) + " lanes");
+            continue;
+        }
+        if (options.TTI)
+        {
+            auto [scalar, vector] = packCost(pack);
+            remarkCost(pack.instructions, scalar, vector);
+            if (!vector.isValid() || !(vector - scalar < -options.costThreshold))
+            {
+                remarkMissed(pack.instructions, "Unprofitable",
+                             "saves no more than the cost threshold of " + std::to_string(options.costThreshold));
+                continue;
+            }
+        }
+        addVectorLanes(pack);
+        packs.push_back(pack);
+    }
+
+    ScopeIndex scope(*flat);
+    scope.build(items);
+    std::unique_ptr<RegisterPressure> pressure;
+    if (options.TTI && !packs.empty())
+        pressure = std::make_unique<RegisterPressure>(*options.TTI, scope, items.size());
 
-    std::unordered_set<VectorPack, PackHash> goodPacks;
     for (const auto &pack : packs)
     {
         std::vector<int> indices;
         for (auto *inst : pack.instructions)
-            indices.push_back(instToIndex[inst]);
+            indices.push_back(scope.position(inst));
         int min_index = *std::min_element(indices.begin(), indices.end());
         int max_index = *std::max_element(indices.begin(), indices.end());
-        bool canVectorize = true;
-        for (auto *inst : pack.instructions)
+        int position = min_index;
+        if (!canSchedulePack(scope, pack.instructions, indices, min_index))
         {
-            for (auto user : inst->users())
+            if (!canSinkPack(items, scope, pack.instructions, indices, max_index))
             {
-                if (auto *userInst = llvm::dyn_cast<llvm::Instruction>(user))
+                ObjectPairs hoisted, sunk;
+                bool hoistable = canSchedulePack(scope, pack.instructions, indices, min_index, &hoisted);
+                if (hoistable || canSinkPack(items, scope, pack.instructions, indices, max_index, &sunk))
                 {
-                    if (instToIndex.count(userInst) && instToIndex[userInst] < min_index)
+                    auto &assumed = hoistable ? hoisted : sunk;
+                    overlapPairs.insert(assumed.begin(), assumed.end());
+                    if (options.TTI)
                     {
-                        canVectorize = false;
-                        break;
+                        auto [scalar, vector] = packCost(pack);
+                        blockedSavings[pack.instructions[0]] = scalar - vector;
                     }
+                    remarkMissed(pack.instructions, "MayAlias",
+                                 "the lanes can only be moved next to each other if accesses to different "
+                                 "objects do not overlap");
+                }
+                else
+                {
+                    remarkMissed(pack.instructions, "Dependence",
+                                 "a dependence keeps the lanes from being moved next to each other");
                 }
+                removeVectorLanes(pack);
+                continue;
             }
-            if (!canVectorize)
+            position = max_index;
+        }
+
+        // The pack was priced while every candidate counted as a vector; one
+        // whose operands came from packs dropped since has to build them.
+        InstructionCost saving = 0;
+        if (options.TTI)
+        {
+            auto [scalar, vector] = packCost(pack);
+            saving = scalar - vector;
+            if (!vector.isValid() || !(vector - scalar < -options.costThreshold))
             {
-                errs() << "Vectorization failed :(\n";
-                break;
+                remarkMissed(pack.instructions, "Unprofitable",
+                             "saves no more than the cost threshold of " + std::to_string(options.costThreshold) +
+                                 " without the packs dropped before it");
+                removeVectorLanes(pack);
+                continue;
             }
         }
-        if (canVectorize)
+
+        if (pressure && exceedsRegisters(*pressure, pack))
         {
-            std::vector<Item> newItems;
-            std::unordered_set<int> packIndices(indices.begin(), indices.end());
-            instToIndex.clear();
-            for (int i = 0; i < function.items.size(); i++)
+            removeVectorLanes(pack);
+            continue;
+        }
+
+        // Only the items from min_index to max_index move: the lanes come
+        // together at `position` and the items between them close up.
+        std::vector<Item> window;
+        std::unordered_set<int> packIndices(indices.begin(), indices.end());
+        // New positions of the items of the window.
+        std::vector<int> moved(max_index - min_index + 1);
+        for (int i = min_index; i <= max_index; i++)
+        {
+            moved[i - min_index] = min_index + window.size();
+            if (packIndices.count(i))
             {
-                if (packIndices.count(i))
+                if (i == position)
                 {
-                    if (i == min_index)
+                    for (size_t j = 0; j < indices.size(); j++)
                     {
-                        for (size_t j = 0; j < indices.size(); j++)
-                        {
-                            newItems.push_back(function.items[indices[j]]);
-                        }
+                        window.push_back(items[indices[j]]);
                     }
                 }
-                else
-                {
-                    newItems.push_back(function.items[i]);
-                }
-                if (std::holds_alternative<llvm::Instruction *>(newItems[i].content))
-                {
-                    instToIndex[std::get<llvm::Instruction *>(newItems[i].content)] = i;
-                }
             }
-            function.items = newItems;
-            goodPacks.insert(pack);
+            else
+            {
+                window.push_back(items[i]);
+            }
         }
+        std::copy(window.begin(), window.end(), items.begin() + min_index);
+        scope.update(items, min_index, max_index + 1);
+        auto &lanes = goodPacks.insert(pack).first->instructions;
+        if (pressure)
+            pressure->commit(lanes, min_index, moved);
+        if (options.TTI)
+            savings[pack.instructions[0]] = saving;
+        remarkPacked(pack);
     }
+}
+
+// A pack is turned down when it lifts the peak of some register class past
+// the number of registers in it; a scope that is already over the limit may
+// still take packs that do not make it worse.
+bool SLPPacker::exceedsRegisters(const RegisterPressure &pressure, const VectorPack &pack)
+{
+    auto excess = pressure.excess(pack.instructions);
+    if (!excess)
+        return false;
+    auto [regClass, peak] = *excess;
+    unsigned available = options.TTI->getNumberOfRegisters(regClass);
+    remarkMissed(pack.instructions, "RegisterPressure",
+                 "would need " + std::to_string(peak) + " " + options.TTI->getRegisterClassName(regClass) +
+                     " registers, more than the " + std::to_string(available) + " available");
+    return true;
+}
+
+std::unordered_set<VectorPack, PackHash> SLPPacker::packInstructions(SSAFunction &function, int laneWidth)
+{
+    FlatSSA view(function);
+    flat = &view;
+    overlapPairs.clear();
+    savings.clear();
+    blockedSavings.clear();
+
+    std::unordered_set<VectorPack, PackHash> goodPacks;
+    packScope(function.items, laneWidth, goodPacks);
+    flat = nullptr;
+    vectorLanes.clear();
     return goodPacks;
-}
\ No newline at end of file
+}
@@ -7,36 +7,103 @@
 #include <memory>
 #include <cassert>
 #include "predicatedSSA.h"
+#include "flatSSA.h"
+#include "runtimeChecks.h"
+#include "llvm/Support/InstructionCost.h"
 
 using namespace llvm;
 
-struct VectorPack {
-    std::vector<Instruction*> instructions;
-    SSAPredicate* predicate;
-};
+namespace llvm {
+class BlockFrequencyInfo;
+class OptimizationRemarkEmitter;
+class ProfileSummaryInfo;
+class TargetLibraryInfo;
+class TargetTransformInfo;
+}
 
-struct PackHash {
-    size_t operator()(const VectorPack& pack) const {
-        size_t hash = 0;
-        for (auto* inst : pack.instructions) {
-            hash ^= std::hash<Instruction*>()(inst);
-        }
-        return hash;
-    }
-};
+class RegisterPressure;
 
-bool operator==(const VectorPack& a, const VectorPack& b);
+struct PackingOptions {
+    // A candidate is committed only if the vector code is cheaper than the
+    // scalar code by more than this many cost units.
+    int costThreshold = 0;
+    // Prices candidates; without it every legal candidate is committed.
+    const TargetTransformInfo* TTI = nullptr;
+    // Maps library calls such as sqrt to intrinsics; without it only
+    // intrinsic calls and calls with vector variants are packed.
+    const TargetLibraryInfo* TLI = nullptr;
+    // Receives a remark for every candidate pack, committed or not.
+    OptimizationRemarkEmitter* ORE = nullptr;
+    // With a profile, candidates in cold blocks are left scalar: they would
+    // grow the code for no measurable gain.
+    BlockFrequencyInfo* BFI = nullptr;
+    ProfileSummaryInfo* PSI = nullptr;
+
+    bool isCold(const BasicBlock* block) const;
+};
 
 class SLPPacker {
 private:
-    std::unordered_map<Instruction*, SSAPredicate*> instructionPredicates;
+    // Dense view of the function being packed; only set during packInstructions.
+    const FlatSSA* flat = nullptr;
+    PackingOptions options;
+
+    // Where each lane of a pack accepted so far ends up: the pack, named by
+    // its first lane, the lane index and the pack width.
+    struct VectorLane {
+        const Instruction* pack;
+        unsigned lane;
+        unsigned width;
+    };
+    std::unordered_map<const Value*, VectorLane> vectorLanes;
+    ObjectPairs overlapPairs;
+    std::unordered_map<const Instruction*, InstructionCost> savings;
+    std::unordered_map<const Instruction*, InstructionCost> blockedSavings;
+
+    unsigned predicateOf(Instruction* inst) const;
 
     bool isUniformPredicate(const std::vector<Instruction*>& insts);
 
+    // Operand order for commutative packs: neighbouring lanes are matched so
+    // that each operand vector is an existing vector, consecutive loads, a
+    // splat or constants where the lanes allow it.
+    int operandAffinity(Value* previous, Value* current) const;
+    std::vector<bool> orderOperands(const std::vector<Instruction*>& lanes) const;
+
+    // Scalar and vector cost of a pack, including building its operand vectors.
+    std::pair<InstructionCost, InstructionCost> packCost(const VectorPack& pack) const;
+    InstructionCost operandCost(const std::vector<Value*>& operands, unsigned width) const;
+    void shapeOddPack(VectorPack& pack, std::vector<std::vector<Instruction*>>& seeds) const;
+    void addVectorLanes(const VectorPack& pack);
+    void removeVectorLanes(const VectorPack& pack);
+
+    // Remarks about candidate packs; free unless the emitter asks for them.
+    void remarkCost(const std::vector<Instruction*>& lanes, InstructionCost scalar, InstructionCost vector);
+    void remarkMissed(const std::vector<Instruction*>& lanes, StringRef reason, const std::string& why);
+    void remarkPacked(const VectorPack& pack);
+
+    // Register-pressure check for a pack about to be committed in the
+    // current scope; emits the missed remark when it fails.
+    bool exceedsRegisters(const RegisterPressure& pressure, const VectorPack& pack);
+
+    void packScope(std::vector<Item>& items, int laneWidth, std::unordered_set<VectorPack, PackHash>& goodPacks);
+
 public:
-    static bool isVectorizable(unsigned opcode);
+    explicit SLPPacker(const PackingOptions& options = PackingOptions()) : options(options) {}
 
-    static bool predicatesEqual(SSAPredicate* a, SSAPredicate* b);
+    static bool isVectorizable(unsigned opcode);
 
     std::unordered_set<VectorPack, PackHash> packInstructions(SSAFunction& function, int laneWidth);
+
+    // Object pairs whose possible overlap alone kept the last packInstructions
+    // from placing some pack; a runtime check on them can free it.
+    const ObjectPairs& blockingObjectPairs() const { return overlapPairs; }
+
+    // Cost units each pack committed by the last packInstructions saves over
+    // its scalar lanes, by its first lane; empty without a TTI.
+    const std::unordered_map<const Instruction*, InstructionCost>& packSavings() const { return savings; }
+
+    // What the packs that blockingObjectPairs kept from being placed would
+    // have saved, by their first lane; empty without a TTI.
+    const std::unordered_map<const Instruction*, InstructionCost>& blockedPackSavings() const { return blockedSavings; }
 };
\ No newline at end of file
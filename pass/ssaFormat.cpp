@@ -0,0 +1,574 @@
+#include "ssaFormat.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/SourceMgr.h"
+#include <algorithm>
+
+using namespace llvm;
+
+namespace
+{
+
+class SSAWriter
+{
+public:
+    SSAWriter(raw_ostream &os, std::string &error) : os(os), error(error) {}
+
+    bool writeFunction(Function &F, SSAFunction &function)
+    {
+        instructionIds.clear();
+        predicateIds.clear();
+        definitions.clear();
+        muIds.clear();
+        for (auto &I : instructions(F))
+            instructionIds[&I] = instructionIds.size();
+        numberMuNodes(function.items);
+
+        os << "function @" << F.getName() << "\n";
+        if (!writeScope(function.items, 0))
+            return false;
+
+        // Phis in function order, so that equal input gives equal text.
+        std::vector<std::pair<unsigned, PHINode *>> phis;
+        for (auto &entry : function.phiGates)
+            phis.push_back({instructionIds.lookup(entry.first), entry.first});
+        std::sort(phis.begin(), phis.end());
+        for (auto &entry : phis)
+        {
+            for (auto &gate : function.phiGates.at(entry.second))
+            {
+                std::string value;
+                if (!valueName(gate.value, entry.second, value))
+                    return false;
+                unsigned pred = predicateId(gate.predicate);
+                if (!error.empty())
+                    return false;
+                os << "gate i" << entry.first << " " << predicateName(gate.predicate, pred) << " " << value << "\n";
+            }
+        }
+        os << "endfunction\n";
+        return true;
+    }
+
+private:
+    raw_ostream &os;
+    std::string &error;
+    DenseMap<const Instruction *, unsigned> instructionIds;
+    DenseMap<SSAPredicate *, unsigned> predicateIds;
+    // Ids by definition text: predicates built separately but equal, such
+    // as the True of every unguarded item, are written once.
+    StringMap<unsigned> definitions;
+    DenseMap<SSAMuNode *, unsigned> muIds;
+
+    // Mu nodes may be referenced before their binding (a rec that is a later
+    // phi of the same header), so they are numbered up front.
+    void numberMuNodes(const std::vector<Item> &items)
+    {
+        for (auto &item : items)
+        {
+            auto loop = std::get_if<SSALoop *>(&item.content);
+            if (!loop)
+                continue;
+            for (auto &binding : (*loop)->muBindings)
+                muIds.insert({binding.muNode, muIds.size()});
+            numberMuNodes((*loop)->bodyItems);
+        }
+    }
+
+    static void indent(raw_ostream &os, unsigned depth)
+    {
+        for (unsigned i = 0; i < depth; i++)
+            os << "  ";
+    }
+
+    // Defines `pred` and its operands on first use and returns its id, the
+    // id of an equal predicate defined earlier if there is one.
+    unsigned predicateId(SSAPredicate *pred)
+    {
+        if (!pred)
+            return ~0u;
+        auto known = predicateIds.find(pred);
+        if (known != predicateIds.end())
+            return known->second;
+
+        std::string line;
+        raw_string_ostream def(line);
+        switch (pred->kind)
+        {
+        case SSAPredicate::True:
+            def << "true";
+            break;
+        case SSAPredicate::Condition:
+        {
+            std::string value;
+            if (!valueName(pred->condition, nullptr, value))
+                return ~0u;
+            def << "cond " << value;
+            break;
+        }
+        case SSAPredicate::Not:
+            def << "not " << predicateId(pred->left);
+            break;
+        case SSAPredicate::And:
+        case SSAPredicate::Or:
+        {
+            unsigned left = predicateId(pred->left);
+            unsigned right = predicateId(pred->right);
+            def << (pred->kind == SSAPredicate::And ? "and " : "or ") << left << " " << right;
+            break;
+        }
+        }
+
+        auto defined = definitions.insert({def.str(), definitions.size()});
+        unsigned id = defined.first->second;
+        predicateIds[pred] = id;
+        if (defined.second)
+            os << "pred " << id << " " << def.str() << "\n";
+        return id;
+    }
+
+    static std::string predicateName(SSAPredicate *pred, unsigned id)
+    {
+        return pred ? std::to_string(id) : "-";
+    }
+
+    // Constants and globals have no position of their own; they are named
+    // as an operand of `anchor`, the instruction that refers to them.
+    bool valueName(Value *value, Instruction *anchor, std::string &name)
+    {
+        if (auto *inst = dyn_cast<Instruction>(value))
+        {
+            auto it = instructionIds.find(inst);
+            if (it != instructionIds.end())
+            {
+                name = "i" + std::to_string(it->second);
+                return true;
+            }
+        }
+        if (auto *arg = dyn_cast<Argument>(value))
+        {
+            name = "a" + std::to_string(arg->getArgNo());
+            return true;
+        }
+        if (anchor)
+        {
+            for (unsigned k = 0; k < anchor->getNumOperands(); k++)
+            {
+                if (anchor->getOperand(k) == value)
+                {
+                    name = "i" + std::to_string(instructionIds.lookup(anchor)) + "." + std::to_string(k);
+                    return true;
+                }
+            }
+        }
+        if (auto *constant = dyn_cast<ConstantInt>(value))
+        {
+            if (constant->getType()->isIntegerTy(1))
+            {
+                name = constant->isOne() ? "c1" : "c0";
+                return true;
+            }
+        }
+        std::string text;
+        raw_string_ostream(text) << *value;
+        error = "cannot name value " + text;
+        return false;
+    }
+
+    bool ssaValueName(const SSAValue &value, Instruction *anchor, std::string &name)
+    {
+        if (auto mu = std::get_if<SSAMuNode *>(&value))
+        {
+            name = "m" + std::to_string(muIds.lookup(*mu));
+            return true;
+        }
+        return valueName(std::get<Value *>(value), anchor, name);
+    }
+
+    bool writeScope(const std::vector<Item> &items, unsigned depth)
+    {
+        for (auto &item : items)
+        {
+            unsigned pred = predicateId(item.Predicate);
+            if (!error.empty())
+                return false;
+
+            if (auto inst = std::get_if<Instruction *>(&item.content))
+            {
+                auto it = instructionIds.find(*inst);
+                if (it == instructionIds.end())
+                {
+                    error = "item instruction is not part of the function";
+                    return false;
+                }
+                indent(os, depth);
+                os << "item i" << it->second << " " << predicateName(item.Predicate, pred) << "\n";
+                continue;
+            }
+
+            SSALoop *loop = std::get<SSALoop *>(item.content);
+            unsigned whileCondition = predicateId(loop->whileCondition);
+            if (!error.empty())
+                return false;
+            indent(os, depth);
+            os << "loop " << predicateName(item.Predicate, pred) << " while "
+               << predicateName(loop->whileCondition, whileCondition) << "\n";
+
+            for (auto &binding : loop->muBindings)
+            {
+                if (!binding.phi || !instructionIds.count(binding.phi))
+                {
+                    error = "mu binding " + binding.variable + " has no header phi";
+                    return false;
+                }
+                std::string init, rec;
+                if (!ssaValueName(binding.muNode->init, binding.phi, init) ||
+                    !ssaValueName(binding.muNode->rec, binding.phi, rec))
+                    return false;
+                indent(os, depth + 1);
+                os << "mu m" << muIds.lookup(binding.muNode) << " i" << instructionIds.lookup(binding.phi)
+                   << " init " << init << " rec " << rec << "\n";
+            }
+
+            if (!writeScope(loop->bodyItems, depth + 1))
+                return false;
+            indent(os, depth);
+            os << "end\n";
+        }
+        return true;
+    }
+};
+
+class SSAReader
+{
+public:
+    SSAReader(StringRef text, LLVMContext &context, std::string &error)
+        : rest(text), context(context), error(error)
+    {
+    }
+
+    std::unique_ptr<PredicatedSSAModule> read()
+    {
+        auto result = std::make_unique<PredicatedSSAModule>();
+
+        SmallVector<StringRef, 8> tokens;
+        if (!nextLine(tokens) || tokens.size() != 2 || tokens[0] != "predicated-ssa" || tokens[1] != "1")
+            return fail("expected 'predicated-ssa 1'");
+
+        unsigned size;
+        if (!nextLine(tokens) || tokens.size() != 2 || tokens[0] != "module" || tokens[1].getAsInteger(10, size) ||
+            size > rest.size())
+            return fail("expected 'module <bytes>'");
+        StringRef moduleText = rest.take_front(size);
+        rest = rest.drop_front(size);
+        lineNumber += moduleText.count('\n');
+
+        // The IR lexer reads up to a terminating NUL, which a slice of the
+        // file does not have. The printer's ModuleID comment names the
+        // module, so that writing the result back gives the same text.
+        std::string moduleCopy = moduleText.str();
+        StringRef identifier = "<string>";
+        if (moduleText.consume_front("; ModuleID = '"))
+            identifier = moduleText.take_until([](char c) { return c == '\'' || c == '\n'; });
+        SMDiagnostic diagnostic;
+        result->module = parseAssembly(MemoryBufferRef(moduleCopy, identifier), diagnostic, context);
+        if (!result->module)
+        {
+            error = "module:" + std::to_string(diagnostic.getLineNo()) + ": " + diagnostic.getMessage().str();
+            return nullptr;
+        }
+
+        while (nextLine(tokens))
+        {
+            if (tokens.size() != 2 || tokens[0] != "function" || !tokens[1].startswith("@"))
+                return fail("expected 'function @<name>'");
+            Function *F = result->module->getFunction(tokens[1].drop_front());
+            if (!F || F->isDeclaration())
+                return fail("no definition of " + tokens[1].str());
+            SSAFunction *function = readFunction(*F);
+            if (!function)
+                return nullptr;
+            result->functions.push_back({F, function});
+        }
+        return result;
+    }
+
+private:
+    StringRef rest;
+    LLVMContext &context;
+    std::string &error;
+    unsigned lineNumber = 0;
+
+    std::vector<Instruction *> instructionList;
+    std::vector<Argument *> arguments;
+    std::vector<SSAPredicate *> predicates;
+    std::vector<SSAMuNode *> muNodes;
+    std::vector<bool> boundMuNodes;
+
+    std::nullptr_t fail(const std::string &message)
+    {
+        error = "line " + std::to_string(lineNumber) + ": " + message;
+        return nullptr;
+    }
+
+    // Splits the next non-empty line into tokens; false at end of input.
+    bool nextLine(SmallVectorImpl<StringRef> &tokens)
+    {
+        while (!rest.empty())
+        {
+            auto split = rest.split('\n');
+            rest = split.second;
+            lineNumber++;
+            tokens.clear();
+            split.first.split(tokens, ' ', -1, false);
+            if (!tokens.empty())
+                return true;
+        }
+        return false;
+    }
+
+    static bool parseIndex(StringRef token, char prefix, unsigned &index)
+    {
+        return token.size() > 1 && token[0] == prefix && !token.drop_front().getAsInteger(10, index);
+    }
+
+    SSAMuNode *muNode(unsigned id)
+    {
+        if (id >= muNodes.size())
+        {
+            muNodes.resize(id + 1, nullptr);
+            boundMuNodes.resize(id + 1, false);
+        }
+        if (!muNodes[id])
+            muNodes[id] = new SSAMuNode();
+        return muNodes[id];
+    }
+
+    Value *readValue(StringRef token)
+    {
+        unsigned index;
+        if (token == "c0" || token == "c1")
+            return ConstantInt::get(Type::getInt1Ty(context), token == "c1");
+        if (parseIndex(token, 'a', index))
+            return index < arguments.size() ? arguments[index] : nullptr;
+
+        auto operand = token.split('.');
+        if (!parseIndex(operand.first, 'i', index) || index >= instructionList.size())
+            return nullptr;
+        Instruction *inst = instructionList[index];
+        if (operand.second.empty())
+            return inst;
+        unsigned k;
+        if (operand.second.getAsInteger(10, k) || k >= inst->getNumOperands())
+            return nullptr;
+        return inst->getOperand(k);
+    }
+
+    bool readSSAValue(StringRef token, SSAValue &value)
+    {
+        unsigned id;
+        if (parseIndex(token, 'm', id))
+        {
+            value = muNode(id);
+            return true;
+        }
+        Value *plain = readValue(token);
+        value = plain;
+        return plain != nullptr;
+    }
+
+    // "-" is a missing predicate; anything else must already be defined.
+    bool readPredicate(StringRef token, SSAPredicate *&pred)
+    {
+        pred = nullptr;
+        if (token == "-")
+            return true;
+        unsigned id;
+        if (token.getAsInteger(10, id) || id >= predicates.size())
+            return false;
+        pred = predicates[id];
+        return true;
+    }
+
+    bool definePredicate(ArrayRef<StringRef> tokens)
+    {
+        unsigned id;
+        if (tokens.size() < 3 || tokens[1].getAsInteger(10, id) || id != predicates.size())
+            return false;
+
+        SSAPredicate *pred = new SSAPredicate();
+        StringRef kind = tokens[2];
+        if (kind == "true" && tokens.size() == 3)
+        {
+            pred->kind = SSAPredicate::True;
+        }
+        else if (kind == "cond" && tokens.size() == 4)
+        {
+            pred->kind = SSAPredicate::Condition;
+            pred->condition = readValue(tokens[3]);
+            if (!pred->condition || !pred->condition->getType()->isIntegerTy(1))
+                return false;
+        }
+        else if (kind == "not" && tokens.size() == 4)
+        {
+            pred->kind = SSAPredicate::Not;
+            if (!readPredicate(tokens[3], pred->left) || !pred->left)
+                return false;
+        }
+        else if ((kind == "and" || kind == "or") && tokens.size() == 5)
+        {
+            pred->kind = kind == "and" ? SSAPredicate::And : SSAPredicate::Or;
+            if (!readPredicate(tokens[3], pred->left) || !pred->left || !readPredicate(tokens[4], pred->right) ||
+                !pred->right)
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+        predicates.push_back(pred);
+        return true;
+    }
+
+    SSAFunction *readFunction(Function &F)
+    {
+        instructionList.clear();
+        arguments.clear();
+        predicates.clear();
+        muNodes.clear();
+        boundMuNodes.clear();
+        for (auto &I : instructions(F))
+            instructionList.push_back(&I);
+        for (auto &arg : F.args())
+            arguments.push_back(&arg);
+
+        SSAFunction *function = new SSAFunction();
+        std::vector<std::vector<Item> *> scopes = {&function->items};
+        std::vector<SSALoop *> loops;
+
+        SmallVector<StringRef, 8> tokens;
+        while (nextLine(tokens))
+        {
+            StringRef keyword = tokens[0];
+            if (keyword == "endfunction")
+            {
+                if (!loops.empty())
+                    return fail("unterminated loop");
+                for (unsigned id = 0; id < muNodes.size(); id++)
+                {
+                    if (muNodes[id] && !boundMuNodes[id])
+                        return fail("mu node m" + std::to_string(id) + " is never bound");
+                }
+                return function;
+            }
+
+            if (keyword == "pred")
+            {
+                if (!definePredicate(tokens))
+                    return fail("malformed predicate");
+            }
+            else if (keyword == "item")
+            {
+                Item item;
+                Value *value = tokens.size() == 3 ? readValue(tokens[1]) : nullptr;
+                if (!value || !isa<Instruction>(value) || !readPredicate(tokens[2], item.Predicate))
+                    return fail("malformed item");
+                item.content = cast<Instruction>(value);
+                scopes.back()->push_back(item);
+            }
+            else if (keyword == "loop")
+            {
+                SSALoop *loop = new SSALoop();
+                Item item;
+                if (tokens.size() != 4 || tokens[2] != "while" || !readPredicate(tokens[1], item.Predicate) ||
+                    !readPredicate(tokens[3], loop->whileCondition))
+                    return fail("malformed loop");
+                item.content = loop;
+                scopes.back()->push_back(item);
+                loops.push_back(loop);
+                scopes.push_back(&loop->bodyItems);
+            }
+            else if (keyword == "mu")
+            {
+                unsigned id;
+                Value *phi = tokens.size() == 7 ? readValue(tokens[2]) : nullptr;
+                if (loops.empty() || !phi || !isa<PHINode>(phi) || !parseIndex(tokens[1], 'm', id) ||
+                    tokens[3] != "init" || tokens[5] != "rec")
+                    return fail("malformed mu binding");
+                SSAMuNode *node = muNode(id);
+                if (boundMuNodes[id])
+                    return fail("mu node m" + std::to_string(id) + " is bound twice");
+                boundMuNodes[id] = true;
+                if (!readSSAValue(tokens[4], node->init) || !readSSAValue(tokens[6], node->rec))
+                    return fail("malformed mu binding");
+                node->type = phi->getType();
+
+                SSALoop::MuBinding binding;
+                binding.variable = phi->getName().str();
+                binding.muNode = node;
+                binding.phi = cast<PHINode>(phi);
+                loops.back()->muBindings.push_back(binding);
+            }
+            else if (keyword == "end")
+            {
+                if (loops.empty())
+                    return fail("'end' outside a loop");
+                loops.pop_back();
+                scopes.pop_back();
+            }
+            else if (keyword == "gate")
+            {
+                SSAGate gate;
+                Value *phi = tokens.size() == 4 ? readValue(tokens[1]) : nullptr;
+                if (!phi || !isa<PHINode>(phi) || !readPredicate(tokens[2], gate.predicate) ||
+                    !(gate.value = readValue(tokens[3])))
+                    return fail("malformed gate");
+                function->phiGates[cast<PHINode>(phi)].push_back(gate);
+            }
+            else
+            {
+                return fail("unexpected '" + keyword.str() + "'");
+            }
+        }
+        return fail("missing 'endfunction'");
+    }
+};
+
+} // namespace
+
+bool writePredicatedSSA(const Module &module, const SSAFunctionList &functions, raw_ostream &os,
+                        std::string &error)
+{
+    std::string moduleText;
+    raw_string_ostream moduleStream(moduleText);
+    module.print(moduleStream, nullptr);
+    moduleStream.flush();
+
+    os << "predicated-ssa 1\n";
+    os << "module " << moduleText.size() << "\n" << moduleText;
+
+    error.clear();
+    SSAWriter writer(os, error);
+    for (auto &entry : functions)
+    {
+        if (!writer.writeFunction(*entry.first, *entry.second))
+            return false;
+    }
+    return true;
+}
+
+bool writePredicatedSSAFunction(Function &F, SSAFunction &function, raw_ostream &os, std::string &error)
+{
+    error.clear();
+    return SSAWriter(os, error).writeFunction(F, function);
+}
+
+std::unique_ptr<PredicatedSSAModule> readPredicatedSSA(StringRef text, LLVMContext &context, std::string &error)
+{
+    error.clear();
+    return SSAReader(text, context, error).read();
+}
@@ -0,0 +1,63 @@
+#ifndef SSAFORMAT_H
+#define SSAFORMAT_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+#include "predicatedSSA.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Round-trippable textual form of predicated SSA. A file holds the IR module
+// the functions were converted from, followed by the predicated SSA of some
+// of its functions:
+//
+//   predicated-ssa 1
+//   module <bytes>
+//   <textual IR, exactly <bytes> long>
+//   function @name
+//   pred <id> true | cond <value> | not <id> | and <id> <id> | or <id> <id>
+//   item <value> <pred>
+//   loop <pred> while <pred>
+//   mu m<n> <phi> init <value> rec <value>
+//   ...nested items...
+//   end
+//   gate <phi> <pred> <value>
+//   endfunction
+//
+// Values name instructions by their position in the function (i<n>),
+// arguments (a<n>), mu nodes (m<n>), operands of an instruction (i<n>.<k>,
+// used for constants and globals) or i1 constants (c0, c1). Predicates are
+// listed once and referenced by id, so sharing between items survives the
+// round trip; equal predicates share one id even when they were separate
+// nodes, and a missing predicate is written as "-".
+//
+// Reading back needs no conversion, analysis or scheduling, so packer-only
+// benchmarks and regression fixtures can start straight from the stored form.
+
+using SSAFunctionList = std::vector<std::pair<llvm::Function *, SSAFunction *>>;
+
+// Returns false, leaving `error` set, when a value cannot be named, e.g. a
+// non-i1 constant that is not an operand of the phi or gate referring to it.
+bool writePredicatedSSA(const llvm::Module &module, const SSAFunctionList &functions, llvm::raw_ostream &os,
+                        std::string &error);
+
+// Writes only the function section, without the module. The text names
+// everything the packer looks at, which makes it a fingerprint of its input.
+bool writePredicatedSSAFunction(llvm::Function &F, SSAFunction &function, llvm::raw_ostream &os,
+                                std::string &error);
+
+struct PredicatedSSAModule
+{
+    std::unique_ptr<llvm::Module> module;
+    SSAFunctionList functions;
+};
+
+// Returns null, leaving `error` set, when the text is malformed.
+std::unique_ptr<PredicatedSSAModule> readPredicatedSSA(llvm::StringRef text, llvm::LLVMContext &context,
+                                                       std::string &error);
+
+#endif
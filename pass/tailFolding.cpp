@@ -0,0 +1,752 @@
+#include "tailFolding.h"
+#include "dependence.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+namespace
+{
+
+struct Induction
+{
+    PHINode *phi;
+    int64_t step;
+};
+
+struct FoldPlan
+{
+    Loop *loop;
+    BasicBlock *preheader;
+    BasicBlock *header;
+    // The header itself, the second block of a search loop, or the exit of
+    // the inner loop of an outer loop.
+    BasicBlock *latch;
+    // Taken from the latch once the trip count runs out.
+    BasicBlock *exit;
+    // Number of iterations, as an i64.
+    const SCEV *tripCount;
+    ICmpInst *exitCompare;
+    // Search loops only: the header leaves for `earlyExit` in the first
+    // iteration where `earlyCondition` equals `exitOnTrue`.
+    BasicBlock *earlyExit = nullptr;
+    Instruction *earlyCondition = nullptr;
+    bool exitOnTrue = true;
+    // Outer loops only: the single block of the inner loop, which repeats
+    // while `innerCondition` equals `innerRepeatsOnTrue`.
+    BasicBlock *inner = nullptr;
+    Instruction *innerCondition = nullptr;
+    bool innerRepeatsOnTrue = true;
+    std::vector<Induction> inductions;
+    // Consecutive accesses and the address of their first iteration.
+    DenseMap<Instruction *, const SCEV *> starts;
+    // Addresses that leave the loop through an exit phi.
+    DenseMap<Instruction *, const SCEVAddRecExpr *> liveAddresses;
+    // Addresses the inner loop computes per lane, and the loads that gather
+    // through them.
+    DenseSet<Instruction *> gathers;
+
+    std::vector<BasicBlock *> blocks() const
+    {
+        if (inner)
+            return {header, inner, latch};
+        if (latch == header)
+            return {header};
+        return {header, latch};
+    }
+};
+
+bool isWidenableType(Type *type)
+{
+    return VectorType::isValidElementType(type) && !type->isPointerTy();
+}
+
+bool isSafeToSpeculate(Instruction &I)
+{
+    switch (I.getOpcode())
+    {
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// Whether an instruction outside the block of `I` uses it; unlike
+// isUsedOutsideOfBlock, this counts the phis of the successors.
+bool isUsedOutsideItsBlock(Instruction &I)
+{
+    return any_of(I.users(), [&](User *user) { return cast<Instruction>(user)->getParent() != I.getParent(); });
+}
+
+// Cost of `I` in one vector iteration.
+InstructionCost widenedCost(const FoldPlan &plan, Instruction &I, const TargetTransformInfo &TTI, unsigned width)
+{
+    const auto kind = TargetTransformInfo::TCK_RecipThroughput;
+    if (&I == plan.exitCompare || I.isTerminator() || (isa<GetElementPtrInst>(I) && !plan.gathers.count(&I)))
+        return 0;
+    // A vector of addresses costs about as much as the offsets it adds.
+    if (isa<GetElementPtrInst>(I))
+        return TTI.getArithmeticInstrCost(Instruction::Add, FixedVectorType::get(Type::getInt64Ty(I.getContext()), width),
+                                          kind);
+    Type *type = isa<StoreInst>(I) ? cast<StoreInst>(I).getValueOperand()->getType() : I.getType();
+    auto *vectorType = FixedVectorType::get(type, width);
+    if (isa<PHINode>(I))
+    {
+        if (I.getParent() != plan.header)
+            return 0;
+        return TTI.getInstructionCost(&I, kind) + TTI.getShuffleCost(TargetTransformInfo::SK_Broadcast, vectorType) +
+               TTI.getArithmeticInstrCost(Instruction::Add, vectorType, kind);
+    }
+    if (plan.gathers.count(&I))
+        return TTI.getGatherScatterOpCost(Instruction::Load, vectorType, getLoadStorePointerOperand(&I),
+                                          /*VariableMask=*/true, getLoadStoreAlignment(&I), kind, &I);
+    if (isa<LoadInst>(I) || isa<StoreInst>(I))
+    {
+        if (plan.starts.count(&I))
+            return TTI.getMaskedMemoryOpCost(I.getOpcode(), vectorType, getLoadStoreAlignment(&I),
+                                             getLoadStoreAddressSpace(&I), kind);
+        return TTI.getInstructionCost(&I, kind) + TTI.getShuffleCost(TargetTransformInfo::SK_Broadcast, vectorType);
+    }
+    if (auto *conversion = dyn_cast<CastInst>(&I))
+        return TTI.getCastInstrCost(I.getOpcode(), vectorType, FixedVectorType::get(conversion->getSrcTy(), width),
+                                    TargetTransformInfo::CastContextHint::None, kind);
+    if (isa<CmpInst>(I) || isa<SelectInst>(I))
+    {
+        Type *operandType = FixedVectorType::get(I.getOperand(isa<SelectInst>(I) ? 1 : 0)->getType(), width);
+        auto *maskType = FixedVectorType::get(Type::getInt1Ty(I.getContext()), width);
+        auto predicate = isa<CmpInst>(I) ? cast<CmpInst>(I).getPredicate() : CmpInst::BAD_ICMP_PREDICATE;
+        return TTI.getCmpSelInstrCost(I.getOpcode(), operandType, maskType, predicate, kind);
+    }
+    return TTI.getArithmeticInstrCost(I.getOpcode(), vectorType, kind);
+}
+
+// Cost of one scalar iteration and of one vector iteration of the plan.
+std::pair<InstructionCost, InstructionCost> foldCost(const FoldPlan &plan, const TargetTransformInfo &TTI,
+                                                     unsigned width)
+{
+    const auto kind = TargetTransformInfo::TCK_RecipThroughput;
+    LLVMContext &context = plan.header->getContext();
+    Type *indexType = Type::getInt64Ty(context);
+    auto *maskType = FixedVectorType::get(Type::getInt1Ty(context), width);
+
+    InstructionCost scalar = 0;
+    InstructionCost vector = 0;
+    // The vector loop keeps the scalar loop control and adds the lane mask;
+    // a search loop also reduces its exit lanes to one branch condition, and
+    // an outer loop its lanes still in the inner loop, keeping the last
+    // value of each lane that leaves it.
+    for (BasicBlock *block : plan.blocks())
+    {
+        for (Instruction &I : *block)
+            scalar += TTI.getInstructionCost(&I, kind);
+        vector += TTI.getInstructionCost(block->getTerminator(), kind);
+    }
+    vector += TTI.getInstructionCost(plan.exitCompare, kind);
+    IntrinsicCostAttributes maskAttributes(Intrinsic::get_active_lane_mask, maskType, {indexType, indexType});
+    vector += TTI.getIntrinsicInstrCost(maskAttributes, kind);
+    if (plan.earlyExit)
+        vector += TTI.getArithmeticInstrCost(Instruction::And, maskType, kind) +
+                  TTI.getArithmeticReductionCost(Instruction::Or, maskType, None, kind);
+    if (plan.inner)
+    {
+        vector += TTI.getArithmeticInstrCost(Instruction::And, maskType, kind) +
+                  TTI.getArithmeticReductionCost(Instruction::Or, maskType, None, kind);
+        for (Instruction &I : *plan.inner)
+        {
+            if (!I.isTerminator() && isUsedOutsideItsBlock(I))
+                vector += TTI.getCmpSelInstrCost(Instruction::Select, FixedVectorType::get(I.getType(), width),
+                                                 maskType, CmpInst::BAD_ICMP_PREDICATE, kind);
+        }
+    }
+
+    for (BasicBlock *block : plan.blocks())
+    {
+        for (Instruction &I : *block)
+            vector += widenedCost(plan, I, TTI, width);
+    }
+    return {scalar * width, vector};
+}
+
+// The exit branch of `block` and the successor it leaves `L` for; null when
+// it does not end in a conditional branch with exactly one exiting edge.
+BranchInst *exitBranch(Loop *L, BasicBlock *block, BasicBlock *&exit)
+{
+    auto *branch = dyn_cast<BranchInst>(block->getTerminator());
+    if (!branch || !branch->isConditional() ||
+        L->contains(branch->getSuccessor(0)) == L->contains(branch->getSuccessor(1)))
+        return nullptr;
+    exit = branch->getSuccessor(L->contains(branch->getSuccessor(0)) ? 1 : 0);
+    return branch;
+}
+
+Optional<FoldPlan> planFold(Loop *L, ScalarEvolution &SE, DominatorTree &DT, const TargetTransformInfo &TTI,
+                            unsigned width, ObjectPairs &blocking)
+{
+    FoldPlan plan;
+    plan.loop = L;
+    plan.header = L->getHeader();
+    plan.latch = L->getLoopLatch();
+    plan.preheader = L->getLoopPreheader();
+    if (!plan.preheader || !plan.latch || (L->isInnermost() ? L->getNumBlocks() > 2 : L->getNumBlocks() != 3))
+        return None;
+
+    BranchInst *latchBranch = exitBranch(L, plan.latch, plan.exit);
+    if (!latchBranch)
+        return None;
+    plan.exitCompare = dyn_cast<ICmpInst>(latchBranch->getCondition());
+    if (!plan.exitCompare || plan.exitCompare->getParent() != plan.latch || !plan.exitCompare->hasOneUse())
+        return None;
+    if (!L->isInnermost())
+    {
+        // An outer loop runs its lanes through one inner loop in lockstep:
+        // the header enters the inner loop, whose exit is the latch.
+        if (L->getSubLoops().size() != 1 || L->getSubLoops()[0]->getNumBlocks() != 1)
+            return None;
+        plan.inner = L->getSubLoops()[0]->getHeader();
+        auto *entry = dyn_cast<BranchInst>(plan.header->getTerminator());
+        auto *repeat = dyn_cast<BranchInst>(plan.inner->getTerminator());
+        if (!entry || entry->isConditional() || entry->getSuccessor(0) != plan.inner || !repeat ||
+            !repeat->isConditional() || plan.latch->getSinglePredecessor() != plan.inner)
+            return None;
+        plan.innerRepeatsOnTrue = repeat->getSuccessor(0) == plan.inner;
+        plan.innerCondition = dyn_cast<Instruction>(repeat->getCondition());
+        if (!plan.innerCondition || plan.innerCondition->getParent() != plan.inner)
+            return None;
+    }
+    else if (plan.latch != plan.header)
+    {
+        BranchInst *earlyBranch = exitBranch(L, plan.header, plan.earlyExit);
+        if (!earlyBranch)
+            return None;
+        plan.exitOnTrue = earlyBranch->getSuccessor(0) == plan.earlyExit;
+        plan.earlyCondition = dyn_cast<Instruction>(earlyBranch->getCondition());
+        if (!plan.earlyCondition || plan.earlyCondition->getParent() != plan.header)
+            return None;
+    }
+
+    const DataLayout &DL = plan.header->getModule()->getDataLayout();
+    Instruction *entryPoint = plan.preheader->getTerminator();
+    // Counted loops with a known trip count are left to unrolling and the
+    // packer; neither a search loop nor an outer loop can be unrolled into
+    // independent lanes.
+    const SCEV *backedges = SE.getExitCount(L, plan.latch);
+    if (isa<SCEVCouldNotCompute>(backedges) || (!plan.earlyExit && !plan.inner && isa<SCEVConstant>(backedges)) ||
+        backedges->getType()->getIntegerBitWidth() > 64)
+        return None;
+    Type *indexType = Type::getInt64Ty(plan.header->getContext());
+    plan.tripCount = SE.getAddExpr(SE.getNoopOrZeroExtend(backedges, indexType), SE.getOne(indexType));
+    if (!isSafeToExpandAt(plan.tripCount, entryPoint, SE))
+        return None;
+
+    for (PHINode &phi : plan.header->phis())
+    {
+        auto *rec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&phi));
+        if (!phi.getType()->isIntegerTy() || !rec || rec->getLoop() != L || !rec->isAffine())
+            return None;
+        auto *step = dyn_cast<SCEVConstant>(rec->getStepRecurrence(SE));
+        if (!step || step->getAPInt().getMinSignedBits() > 64)
+            return None;
+        plan.inductions.push_back({&phi, step->getAPInt().getSExtValue()});
+    }
+
+    std::vector<Instruction *> accesses;
+    for (BasicBlock *block : plan.blocks())
+    {
+        for (Instruction &I : *block)
+        {
+            // Values leave only through phis of the exit blocks, along an
+            // edge the value is defined on, and are recovered from the lane
+            // that takes the exit.
+            bool liveOut = false;
+            for (Use &use : I.uses())
+            {
+                auto *user = cast<Instruction>(use.getUser());
+                if (L->contains(user))
+                    continue;
+                auto *phi = dyn_cast<PHINode>(user);
+                if (!phi)
+                    return None;
+                BasicBlock *from = phi->getIncomingBlock(use);
+                bool early = plan.earlyExit && from == plan.header && phi->getParent() == plan.earlyExit;
+                bool counted = from == plan.latch && phi->getParent() == plan.exit;
+                if (!early && !counted)
+                    return None;
+                liveOut = true;
+            }
+            if (&I == plan.exitCompare || I.isTerminator())
+                continue;
+            // Phis of the inner loop become vector phis, and those of its
+            // exit take the inner values the lanes left with.
+            if (auto *phi = dyn_cast<PHINode>(&I))
+            {
+                if (block == plan.header)
+                    continue;
+                if (!plan.inner || !isWidenableType(phi->getType()) ||
+                    (block == plan.latch && phi->getNumIncomingValues() != 1))
+                    return None;
+                continue;
+            }
+
+            // The inner loop computes addresses of its own per lane, from an
+            // invariant base, which only its loads may gather through.
+            if (block == plan.inner && isa<GetElementPtrInst>(I) &&
+                L->isLoopInvariant(cast<GetElementPtrInst>(I).getPointerOperand()))
+            {
+                for (Value *index : cast<GetElementPtrInst>(I).indices())
+                {
+                    if (!isa<Constant>(index) && !isWidenableType(index->getType()))
+                        return None;
+                }
+                for (User *user : I.users())
+                {
+                    auto *load = dyn_cast<LoadInst>(user);
+                    if (!load || load->getPointerOperand() != &I || load->getParent() != plan.inner)
+                        return None;
+                }
+                plan.gathers.insert(&I);
+                continue;
+            }
+
+            // Addresses are recomputed from their recurrences, so a GEP may
+            // only feed the accesses themselves, or leave the loop as a
+            // recurrence of its own.
+            if (isa<GetElementPtrInst>(I))
+            {
+                for (User *user : I.users())
+                {
+                    if (getLoadStorePointerOperand(user) != &I && L->contains(cast<Instruction>(user)))
+                        return None;
+                }
+                if (liveOut)
+                {
+                    auto *rec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&I));
+                    if (!rec || rec->getLoop() != L || !rec->isAffine() ||
+                        !isa<SCEVConstant>(rec->getStepRecurrence(SE)) ||
+                        !isSafeToExpandAt(rec->getStart(), entryPoint, SE))
+                        return None;
+                    plan.liveAddresses[&I] = rec;
+                }
+                continue;
+            }
+
+            if (isa<LoadInst>(I) || isa<StoreInst>(I))
+            {
+                accesses.push_back(&I);
+                auto *load = dyn_cast<LoadInst>(&I);
+                auto *store = dyn_cast<StoreInst>(&I);
+                if ((load && !load->isSimple()) || (store && !store->isSimple()) ||
+                    !isWidenableType(getLoadStoreType(&I)))
+                    return None;
+                if ((plan.earlyExit || block == plan.inner) && store)
+                    return None;
+                Value *ptr = getLoadStorePointerOperand(&I);
+                if (auto *gep = dyn_cast<Instruction>(ptr); gep && plan.gathers.count(gep))
+                {
+                    plan.gathers.insert(&I);
+                    continue;
+                }
+                const SCEV *address = SE.getSCEV(ptr);
+                // An invariant load is executed once per vector iteration and
+                // broadcast; the first lane is always active, so it runs
+                // exactly when the scalar loop would run it. Past the early
+                // exit of a search loop it runs even if that lane leaves,
+                // so there it must be safe to load before the loop.
+                if (load && L->isLoopInvariant(ptr))
+                {
+                    if (plan.earlyExit && block != plan.header &&
+                        !isDereferenceableAndAlignedPointer(ptr, load->getType(), load->getAlign(), DL, entryPoint,
+                                                            &DT))
+                        return None;
+                    continue;
+                }
+                // A search loop reads every lane of a vector iteration, also
+                // those past the exit, so its loads must stay in bounds over
+                // the whole trip count.
+                if (plan.earlyExit && !isDereferenceableAndAlignedInLoop(load, L, SE, DT))
+                    return None;
+                auto *rec = dyn_cast<SCEVAddRecExpr>(address);
+                auto *step = rec ? dyn_cast<SCEVConstant>(rec->getStepRecurrence(SE)) : nullptr;
+                if (!rec || rec->getLoop() != L || !step ||
+                    step->getAPInt() != DL.getTypeAllocSize(getLoadStoreType(&I)) ||
+                    !isSafeToExpandAt(rec->getStart(), entryPoint, SE))
+                    return None;
+                plan.starts[&I] = rec->getStart();
+                continue;
+            }
+
+            if (!isWidenableType(I.getType()) || !isSafeToSpeculate(I))
+                return None;
+            if (!isa<BinaryOperator>(I) && !isa<CastInst>(I) && !isa<CmpInst>(I) && !isa<SelectInst>(I))
+                return None;
+            for (Value *operand : I.operands())
+            {
+                if (!isWidenableType(operand->getType()))
+                    return None;
+            }
+        }
+    }
+
+    auto [scalar, vector] = foldCost(plan, TTI, width);
+    if (!vector.isValid() || vector >= scalar)
+        return None;
+
+    // A vector iteration runs each access for all its lanes before the next
+    // access, so accesses that may touch the same memory must only do so
+    // within an iteration: both consecutive from the same address. Pairs
+    // that merely may overlap across two objects are reported, so that the
+    // caller can version on a runtime check and try again.
+    ObjectPairs overlaps;
+    bool conflict = false, checkable = true;
+    for (size_t a = 0; a < accesses.size(); a++)
+    {
+        for (size_t b = a + 1; b < accesses.size(); b++)
+        {
+            Instruction *first = accesses[a], *second = accesses[b];
+            if (!mayConflict(first, second))
+                continue;
+            const SCEV *start = plan.starts.lookup(first);
+            if (start && start == plan.starts.lookup(second) && getLoadStoreType(first) == getLoadStoreType(second))
+                continue;
+            conflict = true;
+            if (mayConflictAcrossObjects(first, second))
+                overlaps.insert({getUnderlyingObject(getLoadStorePointerOperand(first)),
+                                 getUnderlyingObject(getLoadStorePointerOperand(second))});
+            else
+                checkable = false;
+        }
+    }
+    if (conflict)
+    {
+        if (checkable)
+            blocking.insert(overlaps.begin(), overlaps.end());
+        return None;
+    }
+    return plan;
+}
+
+void fold(const FoldPlan &plan, ScalarEvolution &SE, unsigned width)
+{
+    BasicBlock *header = plan.header;
+    Function *F = header->getParent();
+    LLVMContext &context = header->getContext();
+    const DataLayout &DL = header->getModule()->getDataLayout();
+    Type *indexType = Type::getInt64Ty(context);
+    auto *maskType = FixedVectorType::get(Type::getInt1Ty(context), width);
+
+    // Trip count, addresses and splats of invariant operands are computed
+    // once, in the preheader.
+    Instruction *entryPoint = plan.preheader->getTerminator();
+    SCEVExpander expander(SE, DL, "sv.fold");
+    Value *tripCount = expander.expandCodeFor(plan.tripCount, indexType, entryPoint);
+    DenseMap<Instruction *, Value *> starts;
+    for (auto &[access, start] : plan.starts)
+        starts[access] = expander.expandCodeFor(start, getLoadStorePointerOperand(access)->getType(), entryPoint);
+    for (auto &[address, rec] : plan.liveAddresses)
+    {
+        Type *bytePointer = Type::getInt8PtrTy(context, address->getType()->getPointerAddressSpace());
+        starts[address] = expander.expandCodeFor(rec->getStart(), bytePointer, entryPoint);
+    }
+    IRBuilder<> hoisted(entryPoint);
+
+    BasicBlock *body = BasicBlock::Create(context, header->getName() + ".fold", F, header);
+    IRBuilder<> builder(body);
+    PHINode *index = builder.CreatePHI(indexType, 2, "sv.index");
+    Value *mask = builder.CreateIntrinsic(Intrinsic::get_active_lane_mask, {maskType, indexType},
+                                          {index, tripCount}, nullptr, "sv.mask");
+
+    DenseMap<Value *, Value *> vectors;
+    auto vectorOf = [&](Value *value) {
+        auto it = vectors.find(value);
+        if (it != vectors.end())
+            return it->second;
+        return vectors[value] = hoisted.CreateVectorSplat(width, value);
+    };
+
+    // Lane k of an induction is its value k iterations after the one the
+    // vector iteration starts at.
+    std::vector<std::pair<PHINode *, int64_t>> scalarInductions;
+    for (auto &[phi, step] : plan.inductions)
+    {
+        // The usual counter from zero is the vector index itself.
+        Value *start = phi->getIncomingValueForBlock(plan.preheader);
+        Value *scalar = index;
+        if (phi->getType() != indexType || step != 1 || !match(start, m_Zero()))
+        {
+            auto *counter = builder.CreatePHI(phi->getType(), 2, phi->getName());
+            counter->addIncoming(start, plan.preheader);
+            scalarInductions.push_back({counter, step});
+            scalar = counter;
+        }
+        std::vector<Constant *> offsets;
+        for (unsigned lane = 0; lane < width; lane++)
+            offsets.push_back(ConstantInt::get(phi->getType(), step * lane, /*isSigned=*/true));
+        vectors[phi] = builder.CreateAdd(builder.CreateVectorSplat(width, scalar), ConstantVector::get(offsets));
+    }
+
+    // Widens the instructions of `block` at the builder, with `laneMask`
+    // guarding its memory accesses.
+    auto widen = [&](BasicBlock *block, Value *laneMask) {
+        for (Instruction &I : *block)
+        {
+            if (isa<PHINode>(I) || &I == plan.exitCompare || I.isTerminator() ||
+                (isa<GetElementPtrInst>(I) && !plan.gathers.count(&I)))
+                continue;
+            Value *vector = nullptr;
+            if (auto *gep = dyn_cast<GetElementPtrInst>(&I))
+            {
+                std::vector<Value *> indices;
+                for (Value *index : gep->indices())
+                    indices.push_back(isa<Constant>(index) ? index : vectorOf(index));
+                vector = builder.CreateGEP(gep->getSourceElementType(), gep->getPointerOperand(), indices);
+            }
+            else if (plan.gathers.count(&I))
+            {
+                auto &load = cast<LoadInst>(I);
+                vector = builder.CreateMaskedGather(FixedVectorType::get(load.getType(), width),
+                                                    vectors[load.getPointerOperand()], load.getAlign(), laneMask);
+            }
+            else if (isa<LoadInst>(I) || isa<StoreInst>(I))
+            {
+                Type *elementType = getLoadStoreType(&I);
+                auto *vectorType = FixedVectorType::get(elementType, width);
+                auto start = starts.find(&I);
+                if (start == starts.end())
+                {
+                    Instruction *load = I.clone();
+                    builder.Insert(load, I.getName());
+                    vectors[&I] = builder.CreateVectorSplat(width, load);
+                    continue;
+                }
+                Value *ptr = builder.CreateGEP(elementType, start->second, index);
+                ptr = builder.CreateBitCast(ptr, vectorType->getPointerTo(getLoadStoreAddressSpace(&I)));
+                if (auto *store = dyn_cast<StoreInst>(&I))
+                    builder.CreateMaskedStore(vectorOf(store->getValueOperand()), ptr, store->getAlign(), laneMask);
+                else
+                    vector = builder.CreateMaskedLoad(vectorType, ptr, cast<LoadInst>(I).getAlign(), laneMask, nullptr);
+            }
+            else if (auto *conversion = dyn_cast<CastInst>(&I))
+            {
+                vector = builder.CreateCast(conversion->getOpcode(), vectorOf(conversion->getOperand(0)),
+                                            FixedVectorType::get(conversion->getDestTy(), width));
+            }
+            else if (auto *cmp = dyn_cast<CmpInst>(&I))
+            {
+                vector = builder.CreateCmp(cmp->getPredicate(), vectorOf(cmp->getOperand(0)),
+                                           vectorOf(cmp->getOperand(1)));
+            }
+            else if (auto *select = dyn_cast<SelectInst>(&I))
+            {
+                vector = builder.CreateSelect(vectorOf(select->getCondition()), vectorOf(select->getTrueValue()),
+                                              vectorOf(select->getFalseValue()));
+            }
+            else
+            {
+                vector = builder.CreateBinOp(cast<BinaryOperator>(I).getOpcode(), vectorOf(I.getOperand(0)),
+                                             vectorOf(I.getOperand(1)));
+            }
+            if (!vector)
+                continue;
+            // Inactive lanes may turn poison under the flags; they are never
+            // stored.
+            if (auto *inst = dyn_cast<Instruction>(vector))
+                inst->copyIRFlags(&I);
+            vector->setName(I.getName());
+            vectors[&I] = vector;
+        }
+    };
+    widen(header, mask);
+
+    // The lanes of an outer loop run the inner loop together until none of
+    // them repeats it; each keeps the inner values of its last pass.
+    BasicBlock *bodyEnd = body;
+    std::vector<BasicBlock *> created = {body};
+    std::vector<PHINode *> vectorPhis;
+    if (plan.inner)
+    {
+        BasicBlock *innerBody = BasicBlock::Create(context, plan.inner->getName() + ".fold", F, header);
+        bodyEnd = BasicBlock::Create(context, plan.latch->getName() + ".fold", F, header);
+        created.push_back(innerBody);
+        created.push_back(bodyEnd);
+        builder.CreateBr(innerBody);
+        builder.SetInsertPoint(innerBody);
+        PHINode *active = builder.CreatePHI(maskType, 2, "sv.active");
+        active->addIncoming(mask, body);
+        std::vector<std::pair<PHINode *, PHINode *>> innerPhis;
+        for (PHINode &phi : plan.inner->phis())
+        {
+            PHINode *vectorPhi = builder.CreatePHI(FixedVectorType::get(phi.getType(), width), 2, phi.getName());
+            vectorPhi->addIncoming(vectorOf(phi.getIncomingValueForBlock(header)), body);
+            vectors[&phi] = vectorPhi;
+            innerPhis.push_back({&phi, vectorPhi});
+            vectorPhis.push_back(vectorPhi);
+        }
+        std::vector<std::pair<Instruction *, PHINode *>> lastValues;
+        for (Instruction &I : *plan.inner)
+        {
+            if (I.isTerminator() || !isUsedOutsideItsBlock(I))
+                continue;
+            auto *vectorType = FixedVectorType::get(I.getType(), width);
+            PHINode *last = builder.CreatePHI(vectorType, 2, I.getName() + ".last");
+            last->addIncoming(PoisonValue::get(vectorType), body);
+            lastValues.push_back({&I, last});
+            vectorPhis.push_back(last);
+        }
+
+        widen(plan.inner, active);
+        for (auto &[phi, vectorPhi] : innerPhis)
+            vectorPhi->addIncoming(vectorOf(phi->getIncomingValueForBlock(plan.inner)), innerBody);
+        Value *repeats = vectors[plan.innerCondition];
+        if (!plan.innerRepeatsOnTrue)
+            repeats = builder.CreateNot(repeats);
+        Value *remaining = builder.CreateAnd(active, repeats, "sv.remaining");
+        active->addIncoming(remaining, innerBody);
+        for (auto &[inst, last] : lastValues)
+        {
+            Value *updated = builder.CreateSelect(active, vectors[inst], last);
+            last->addIncoming(updated, innerBody);
+            vectors[inst] = updated;
+        }
+        builder.CreateCondBr(builder.CreateOrReduce(remaining), innerBody, bodyEnd);
+
+        builder.SetInsertPoint(bodyEnd);
+        for (PHINode &phi : plan.latch->phis())
+            vectors[&phi] = vectorOf(phi.getIncomingValue(0));
+        widen(plan.latch, mask);
+    }
+    else if (plan.latch != header)
+        widen(plan.latch, mask);
+
+    // The value `value` has in the iteration of lane `lane`.
+    auto laneValue = [&](IRBuilder<> &exitBuilder, Value *value, Value *lane) -> Value * {
+        auto *inst = dyn_cast<Instruction>(value);
+        if (!inst || !plan.loop->contains(inst))
+            return value;
+        if (auto *rec = plan.liveAddresses.lookup(inst))
+        {
+            const APInt &step = cast<SCEVConstant>(rec->getStepRecurrence(SE))->getAPInt();
+            Value *iteration = exitBuilder.CreateAdd(index, lane);
+            Value *offset = exitBuilder.CreateMul(iteration, ConstantInt::get(indexType, step.getSExtValue(), true));
+            Value *address = exitBuilder.CreateGEP(exitBuilder.getInt8Ty(), starts[inst], offset);
+            return exitBuilder.CreateBitCast(address, inst->getType(), inst->getName());
+        }
+        return exitBuilder.CreateExtractElement(vectors[inst], lane, inst->getName());
+    };
+    // Moves the incoming edges from `from` of the phis in `exit` to
+    // `block`, taking loop values from lane `lane`.
+    auto rewireExit = [&](BasicBlock *exit, BasicBlock *from, BasicBlock *block, Value *lane) {
+        IRBuilder<> exitBuilder(block);
+        for (PHINode &phi : exit->phis())
+        {
+            for (unsigned k = 0; k < phi.getNumIncomingValues(); k++)
+            {
+                if (phi.getIncomingBlock(k) != from)
+                    continue;
+                phi.setIncomingValue(k, laneValue(exitBuilder, phi.getIncomingValue(k), lane));
+                phi.setIncomingBlock(k, block);
+            }
+        }
+        exitBuilder.CreateBr(exit);
+    };
+
+    // A search loop leaves from the first active lane that takes the early
+    // exit, if any does.
+    BasicBlock *latch = bodyEnd;
+    if (plan.earlyExit)
+    {
+        Value *exits = vectors[plan.earlyCondition];
+        if (!plan.exitOnTrue)
+            exits = builder.CreateNot(exits);
+        Value *hits = builder.CreateAnd(exits, mask, "sv.hits");
+        BasicBlock *found = BasicBlock::Create(context, header->getName() + ".fold.exit", F, header);
+        latch = BasicBlock::Create(context, plan.latch->getName() + ".fold", F, header);
+        created.push_back(latch);
+        builder.CreateCondBr(builder.CreateOrReduce(hits), found, latch);
+
+        IRBuilder<> foundBuilder(found);
+        Value *bits = foundBuilder.CreateBitCast(hits, foundBuilder.getIntNTy(width));
+        Value *lane = foundBuilder.CreateIntrinsic(Intrinsic::cttz, {bits->getType()}, {bits, foundBuilder.getTrue()});
+        lane = foundBuilder.CreateZExtOrTrunc(lane, indexType, "sv.lane");
+        rewireExit(plan.earlyExit, plan.header, found, lane);
+        builder.SetInsertPoint(latch);
+    }
+
+    for (auto &[scalar, step] : scalarInductions)
+        scalar->addIncoming(builder.CreateAdd(scalar, ConstantInt::get(scalar->getType(), step * width, true)), latch);
+    Value *next = builder.CreateAdd(index, ConstantInt::get(indexType, width), "sv.index.next");
+    index->addIncoming(ConstantInt::get(indexType, 0), plan.preheader);
+    index->addIncoming(next, latch);
+
+    // Loop values leaving through the counted exit come from the last
+    // iteration, which is in the last vector iteration.
+    BasicBlock *done = plan.exit;
+    if (!plan.exit->phis().empty())
+    {
+        done = BasicBlock::Create(context, plan.latch->getName() + ".fold.done", F, header);
+        IRBuilder<> doneBuilder(done);
+        Value *last = doneBuilder.CreateSub(tripCount, doneBuilder.getInt64(1));
+        Value *lane = doneBuilder.CreateSub(last, index, "sv.lane");
+        rewireExit(plan.exit, plan.latch, done, lane);
+    }
+    builder.CreateCondBr(builder.CreateICmpULT(next, tripCount), body, done);
+
+    // Values only the scalar loop control needed are left over.
+    for (BasicBlock *block : reverse(created))
+    {
+        for (Instruction &I : make_early_inc_range(reverse(*block)))
+        {
+            if (isInstructionTriviallyDead(&I))
+                I.eraseFromParent();
+        }
+    }
+    for (auto &[scalar, step] : scalarInductions)
+        RecursivelyDeleteDeadPHINode(scalar);
+    for (PHINode *phi : vectorPhis)
+        RecursivelyDeleteDeadPHINode(phi);
+
+    plan.preheader->getTerminator()->replaceSuccessorWith(header, body);
+    SE.forgetLoop(plan.loop);
+    for (BasicBlock *block : plan.blocks())
+        block->dropAllReferences();
+    for (BasicBlock *block : plan.blocks())
+        block->eraseFromParent();
+}
+
+} // namespace
+
+bool foldLoopTails(Function &F, LoopInfo &LI, DominatorTree &DT, ScalarEvolution &SE, const TargetTransformInfo &TTI,
+                   unsigned width, ObjectPairs &blocking)
+{
+    if (width < 2)
+        return false;
+    // Every loop is planned before any is rewritten, while the analyses
+    // still describe the function.
+    std::vector<FoldPlan> plans;
+    for (Loop *L : LI.getLoopsInPreorder())
+    {
+        // The inner loop of a folded outer loop goes with it.
+        if (!plans.empty() && plans.back().inner && plans.back().loop->contains(L))
+            continue;
+        if (auto plan = planFold(L, SE, DT, TTI, width, blocking))
+            plans.push_back(*plan);
+    }
+    for (auto &plan : plans)
+        fold(plan, SE, width);
+    return !plans.empty();
+}
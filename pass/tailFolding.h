@@ -0,0 +1,50 @@
+#ifndef TAILFOLDING_H
+#define TAILFOLDING_H
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "runtimeChecks.h"
+
+// Vectorizes loops of `F` across iterations, `width` iterations at
+// a time, with the tail folded into the vector loop: every vector iteration
+// runs under the lane mask llvm.get.active.lane.mask(index, trip count), so
+// the lanes past the last scalar iteration are switched off instead of being
+// left to a scalar epilogue. Loops that run fewer than `width` iterations
+// still take the vector loop once.
+//
+// Search loops, whose header leaves early on a condition and whose latch
+// counts the iterations, are vectorized the same way: the exit condition is
+// evaluated for all lanes, llvm.vector.reduce.or of the active ones decides
+// whether to leave, and cttz of their bits names the lane that leaves first.
+// Values the exit phis take from the loop are extracted from that lane, or
+// from the last lane of the trip count at the counted exit. A search loop
+// reads lanes past its exit, so it must not store and its loads must be
+// dereferenceable over the whole trip count.
+//
+// Outer loops whose header enters a single-block inner loop and whose
+// latch is that loop's exit are vectorized across their own iterations. The
+// lanes run the inner loop in lockstep under a mask of the lanes still in
+// it, which starts as the lane mask and loses the lanes that leave, until
+// llvm.vector.reduce.or finds none left; each lane keeps the inner values of
+// its last pass for the latch. Inner loads that are not consecutive in the
+// outer loop gather through a vector of addresses, and the inner loop must
+// not store.
+//
+// Other counted loops are only folded when their trip count is unknown at
+// compile time; the rest are left to unrolling and the packer. A loop qualifies
+// when every header phi is an integer induction with a constant step, its
+// memory accesses are consecutive or invariant loads, its other
+// instructions are arithmetic, casts, compares and selects that cannot
+// trap, and the target prices the vector body below `width` scalar ones.
+// Accesses that may touch the same memory must do so at the same address
+// in the same iteration; loops held back only by possible overlap between
+// different objects add those objects to `blocking`.
+//
+// Returns whether any loop was folded; the analyses are stale afterwards.
+bool foldLoopTails(llvm::Function &F, llvm::LoopInfo &LI, llvm::DominatorTree &DT, llvm::ScalarEvolution &SE,
+                   const llvm::TargetTransformInfo &TTI, unsigned width, ObjectPairs &blocking);
+
+#endif
@@ -0,0 +1,105 @@
+#include "vectorCalls.h"
+#include "simdClones.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/VectorUtils.h"
+
+using namespace llvm;
+
+namespace
+{
+
+// The intrinsic `call` can become lane-wise, or not_intrinsic. Intrinsics
+// such as llvm.assume, which getVectorIntrinsicIDForCall lets through for
+// the loop vectorizer to drop, have no vector form.
+Intrinsic::ID intrinsicFor(const CallInst &call, const TargetLibraryInfo *TLI)
+{
+    Intrinsic::ID ID = getVectorIntrinsicIDForCall(&call, TLI);
+    return isTriviallyVectorizable(ID) ? ID : Intrinsic::not_intrinsic;
+}
+
+// Reciprocal throughput of the body of `F`, or 0 for a declaration.
+InstructionCost bodyCost(const Function &F, const TargetTransformInfo &TTI)
+{
+    InstructionCost cost = 0;
+    for (const BasicBlock &block : F)
+    {
+        for (const Instruction &I : block)
+            cost += TTI.getInstructionCost(&I, TargetTransformInfo::TCK_RecipThroughput);
+    }
+    return cost;
+}
+
+} // namespace
+
+bool isVectorizableCall(const CallInst &call, const TargetLibraryInfo *TLI)
+{
+    return intrinsicFor(call, TLI) != Intrinsic::not_intrinsic || hasVectorVariants(call);
+}
+
+bool isScalarOperand(Intrinsic::ID ID, unsigned operand)
+{
+    return hasVectorInstrinsicScalarOpd(ID, operand);
+}
+
+VectorCall vectorCallFor(const std::vector<Instruction *> &lanes, unsigned width, const TargetLibraryInfo *TLI,
+                         const TargetTransformInfo *TTI)
+{
+    const auto kind = TargetTransformInfo::TCK_RecipThroughput;
+    auto *call = cast<CallInst>(lanes[0]);
+    auto *vectorType = FixedVectorType::get(call->getType(), width);
+
+    VectorCall intrinsic;
+    intrinsic.intrinsic = intrinsicFor(*call, TLI);
+    std::vector<Type *> argumentTypes;
+    for (unsigned k = 0; k < call->arg_size(); k++)
+    {
+        Value *argument = call->getArgOperand(k);
+        if (intrinsic.exists() && isScalarOperand(intrinsic.intrinsic, k))
+        {
+            if (any_of(lanes, [&](Instruction *lane) { return cast<CallInst>(lane)->getArgOperand(k) != argument; }))
+                intrinsic.intrinsic = Intrinsic::not_intrinsic;
+            argumentTypes.push_back(argument->getType());
+        }
+        else
+            argumentTypes.push_back(FixedVectorType::get(argument->getType(), width));
+    }
+    if (intrinsic.exists() && TTI)
+    {
+        IntrinsicCostAttributes attributes(intrinsic.intrinsic, vectorType, argumentTypes);
+        intrinsic.cost = TTI->getIntrinsicInstrCost(attributes, kind);
+        for (Instruction *lane : lanes)
+        {
+            IntrinsicCostAttributes scalarAttributes(intrinsic.intrinsic, *cast<CallInst>(lane));
+            intrinsic.scalarCost += TTI->getIntrinsicInstrCost(scalarAttributes, kind);
+        }
+    }
+
+    VectorCall variant;
+    variant.variant = vectorVariant(*call, width);
+    if (variant.exists() && TTI)
+    {
+        std::vector<Type *> vectorTypes;
+        for (Value *argument : call->args())
+            vectorTypes.push_back(FixedVectorType::get(argument->getType(), width));
+        variant.cost = TTI->getCallInstrCost(variant.variant, vectorType, vectorTypes, kind);
+        // The scalar calls are priced as calls too, whatever the callee:
+        // getInstructionCost only counts the arguments of a call it does not
+        // know, which no vector call can beat.
+        Function *callee = call->getCalledFunction();
+        std::vector<Type *> scalarTypes;
+        for (Value *argument : call->args())
+            scalarTypes.push_back(argument->getType());
+        variant.scalarCost = TTI->getCallInstrCost(callee, call->getType(), scalarTypes, kind) * lanes.size();
+        // A variant with a body, such as a SIMD clone, runs that body once
+        // where the scalar calls run theirs once per lane.
+        if (!variant.variant->isDeclaration() && callee && !callee->isDeclaration())
+        {
+            variant.cost += bodyCost(*variant.variant, *TTI);
+            variant.scalarCost += bodyCost(*callee, *TTI) * lanes.size();
+        }
+    }
+
+    if (!variant.exists() || (intrinsic.exists() && intrinsic.cost.isValid() && intrinsic.cost <= variant.cost))
+        return intrinsic;
+    return variant;
+}
@@ -0,0 +1,47 @@
+#ifndef VECTORCALLS_H
+#define VECTORCALLS_H
+
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/InstructionCost.h"
+#include <vector>
+
+// The vector form a pack of calls is lowered to: a vector intrinsic, for
+// calls of a trivially vectorizable intrinsic or of a library function that
+// TargetLibraryInfo maps to one, or a call of a vector variant, such as a
+// SIMD clone or a vector library function the call is mapped to. When both
+// exist the target picks the cheaper one, so the packer and the lowering
+// agree on the choice by asking the same question.
+struct VectorCall
+{
+    llvm::Intrinsic::ID intrinsic = llvm::Intrinsic::not_intrinsic;
+    llvm::Function *variant = nullptr;
+    // Reciprocal throughput of the vector call alone, without its operand
+    // vectors, and of the scalar calls it replaces, priced the same way: as
+    // intrinsics when a library call becomes one, and otherwise as calls,
+    // so that a vector library function is weighed against the scalar
+    // library calls of its lanes. A variant with a body, such as a SIMD
+    // clone, adds that body against the scalar body of every lane. 0
+    // without a target to ask.
+    llvm::InstructionCost cost = 0;
+    llvm::InstructionCost scalarCost = 0;
+
+    bool exists() const { return intrinsic != llvm::Intrinsic::not_intrinsic || variant; }
+};
+
+// Whether `call` may have a vector form at all; the lanes and the width of a
+// pack decide which one it gets.
+bool isVectorizableCall(const llvm::CallInst &call, const llvm::TargetLibraryInfo *TLI);
+
+// Operands the vector intrinsic `ID` takes as scalars, which every lane must
+// agree on, such as the exponent of llvm.powi.
+bool isScalarOperand(llvm::Intrinsic::ID ID, unsigned operand);
+
+// The vector form of the isomorphic calls `lanes` at `width` lanes; one that
+// does not exist when neither the intrinsic nor a variant fits.
+VectorCall vectorCallFor(const std::vector<llvm::Instruction *> &lanes, unsigned width,
+                         const llvm::TargetLibraryInfo *TLI, const llvm::TargetTransformInfo *TTI);
+
+#endif
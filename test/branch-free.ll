@@ -0,0 +1,60 @@
+; Under -sv-speculation-threshold, a cheap predicated run is executed
+; unconditionally and merged with a select, while a run that may trap keeps
+; its branch. Without the threshold every branch is kept.
+; RUN: %svopt -passes=super-vectorization -sv-speculation-threshold=10 %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+; RUN: %svopt -passes=super-vectorization %s -S | FileCheck %s --check-prefix=KEEP
+
+; CHECK-LABEL: define i32 @cheap(
+; CHECK-NOT: br i1
+; CHECK: select i1
+; CHECK-NOT: br i1
+; CHECK: ret i32
+
+; CHECK-LABEL: define i32 @traps(
+; CHECK: br i1
+; CHECK: sdiv i32
+
+; KEEP-LABEL: define i32 @cheap(
+; KEEP: br i1
+
+define i32 @cheap(i32 %x, i32 %y) {
+entry:
+  %c = icmp slt i32 %x, %y
+  br i1 %c, label %then, label %join
+then:
+  %a = add i32 %x, 5
+  %b = mul i32 %a, %y
+  br label %join
+join:
+  %p = phi i32 [ %b, %then ], [ %x, %entry ]
+  ret i32 %p
+}
+
+define i32 @traps(i32 %x, i32 %y) {
+entry:
+  %c = icmp ne i32 %y, 0
+  br i1 %c, label %then, label %join
+then:
+  %d = sdiv i32 %x, %y
+  br label %join
+join:
+  %p = phi i32 [ %d, %then ], [ -1, %entry ]
+  ret i32 %p
+}
+
+define i32 @main() {
+entry:
+  ; 18 + 9 + 3 + -1 = 29
+  %r1 = call i32 @cheap(i32 1, i32 3)
+  %r2 = call i32 @cheap(i32 9, i32 3)
+  %r3 = call i32 @traps(i32 9, i32 3)
+  %r4 = call i32 @traps(i32 9, i32 0)
+  %s1 = add i32 %r1, %r2
+  %s2 = add i32 %r3, %r4
+  %s = add i32 %s1, %s2
+  %ok = icmp eq i32 %s, 29
+  %ret = select i1 %ok, i32 0, i32 1
+  ret i32 %ret
+}
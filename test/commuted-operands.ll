@@ -0,0 +1,84 @@
+; Lanes 1 and 3 compute y*x where lanes 0 and 2 compute x*y. The packer swaps
+; their operands, so that the multiply takes the x and y vectors the load
+; packs produce as they are, with no shuffle to bring the lanes in order.
+; @strided reads every other element; its loads are deinterleaved by one
+; shuffle each, and the swap still spares the multiply a further one.
+; RUN: %svopt -passes=super-vectorization -mattr=+avx2 -sv-cost-threshold=-10 %s -S | FileCheck %s
+
+; CHECK-LABEL: define void @f(
+; CHECK: [[X:%.*]] = load <4 x float>
+; CHECK: [[Y:%.*]] = load <4 x float>
+; CHECK-NOT: shufflevector
+; CHECK: fmul <4 x float> [[X]], [[Y]]
+; CHECK-NOT: shufflevector
+; CHECK: ret void
+
+; CHECK-LABEL: define void @strided(
+; CHECK: [[XS:%.*]] = shufflevector <8 x float> %{{.*}}, <8 x float> poison, <4 x i32> <i32 0, i32 2, i32 4, i32 6>
+; CHECK: [[YS:%.*]] = shufflevector <8 x float> %{{.*}}, <8 x float> poison, <4 x i32> <i32 0, i32 2, i32 4, i32 6>
+; CHECK-NEXT: fmul <4 x float> [[XS]], [[YS]]
+; CHECK-NOT: shufflevector
+; CHECK: ret void
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @f(float* noalias %x, float* noalias %y, float* noalias %z) {
+entry:
+  %px1 = getelementptr inbounds float, float* %x, i64 1
+  %px2 = getelementptr inbounds float, float* %x, i64 2
+  %px3 = getelementptr inbounds float, float* %x, i64 3
+  %py1 = getelementptr inbounds float, float* %y, i64 1
+  %py2 = getelementptr inbounds float, float* %y, i64 2
+  %py3 = getelementptr inbounds float, float* %y, i64 3
+  %pz1 = getelementptr inbounds float, float* %z, i64 1
+  %pz2 = getelementptr inbounds float, float* %z, i64 2
+  %pz3 = getelementptr inbounds float, float* %z, i64 3
+  %x0 = load float, float* %x, align 4
+  %x1 = load float, float* %px1, align 4
+  %x2 = load float, float* %px2, align 4
+  %x3 = load float, float* %px3, align 4
+  %y0 = load float, float* %y, align 4
+  %y1 = load float, float* %py1, align 4
+  %y2 = load float, float* %py2, align 4
+  %y3 = load float, float* %py3, align 4
+  %m0 = fmul float %x0, %y0
+  %m1 = fmul float %y1, %x1
+  %m2 = fmul float %x2, %y2
+  %m3 = fmul float %y3, %x3
+  store float %m0, float* %z, align 4
+  store float %m1, float* %pz1, align 4
+  store float %m2, float* %pz2, align 4
+  store float %m3, float* %pz3, align 4
+  ret void
+}
+
+define void @strided(float* noalias %x, float* noalias %y, float* noalias %z) {
+entry:
+  %px1 = getelementptr inbounds float, float* %x, i64 2
+  %px2 = getelementptr inbounds float, float* %x, i64 4
+  %px3 = getelementptr inbounds float, float* %x, i64 6
+  %py1 = getelementptr inbounds float, float* %y, i64 2
+  %py2 = getelementptr inbounds float, float* %y, i64 4
+  %py3 = getelementptr inbounds float, float* %y, i64 6
+  %pz1 = getelementptr inbounds float, float* %z, i64 1
+  %pz2 = getelementptr inbounds float, float* %z, i64 2
+  %pz3 = getelementptr inbounds float, float* %z, i64 3
+  %x0 = load float, float* %x, align 4
+  %x1 = load float, float* %px1, align 4
+  %x2 = load float, float* %px2, align 4
+  %x3 = load float, float* %px3, align 4
+  %y0 = load float, float* %y, align 4
+  %y1 = load float, float* %py1, align 4
+  %y2 = load float, float* %py2, align 4
+  %y3 = load float, float* %py3, align 4
+  %m0 = fmul float %x0, %y0
+  %m1 = fmul float %y1, %x1
+  %m2 = fmul float %x2, %y2
+  %m3 = fmul float %y3, %x3
+  store float %m0, float* %z, align 4
+  store float %m1, float* %pz1, align 4
+  store float %m2, float* %pz2, align 4
+  store float %m3, float* %pz3, align 4
+  ret void
+}
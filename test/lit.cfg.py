@@ -0,0 +1,18 @@
+import os
+
+import lit.formats
+
+config.name = "SuperVectorization"
+config.test_format = lit.formats.ShTest(True)
+config.suffixes = [".ll", ".test"]
+# The C example and its compiled forms are inputs of run.sh, not tests;
+# Inputs holds fixtures that tests read.
+config.excludes = ["test.c.ll", "out.ll", "Inputs"]
+
+config.environment["PATH"] = os.pathsep.join(
+    [config.llvm_tools_dir, config.environment.get("PATH", "")])
+
+# opt with the plugin loaded both as a pass plugin and for its options.
+config.substitutions.append(
+    ("%svopt", "opt -load=%s -load-pass-plugin=%s" % (config.plugin, config.plugin)))
+config.substitutions.append(("%sv-ssa", config.sv_ssa))
@@ -0,0 +1,125 @@
+; A loop nest three deep is converted to predicated SSA, with the packed
+; stores of the innermost loop, and lowered back to three nested loops.
+; The result is run with lli, which checks every element of the array.
+; RUN: %svopt -passes=super-vectorization -sv-dump-predicated-ssa=%t.pssa %s -S -o %t.ll
+; RUN: FileCheck %s --check-prefix=SSA < %t.pssa
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; SSA-LABEL: function @fill
+; SSA: loop 0 while
+; SSA-NEXT: mu m0
+; SSA: {{^  }}loop 0 while
+; SSA-NEXT: mu m1
+; SSA: {{^    }}loop 0 while
+; SSA-NEXT: mu m2
+; SSA: {{^    }}end
+; SSA: {{^  }}end
+; SSA: {{^}}end
+; SSA: endfunction
+
+; CHECK-LABEL: define void @fill(
+; CHECK: br label %[[OUTER:[a-z_0-9]+]]
+; CHECK: {{^}}[[OUTER]]:
+; CHECK-NEXT: phi i64 [ 0, %{{.*}} ]
+; CHECK: br label %[[MIDDLE:[a-z_0-9]+]]
+; CHECK: {{^}}[[MIDDLE]]:
+; CHECK-NEXT: phi i64 [ 0, %[[OUTER]] ]
+; CHECK: br label %[[INNER:[a-z_0-9]+]]
+; CHECK: {{^}}[[INNER]]:
+; CHECK-NEXT: phi i64 [ 0, %[[MIDDLE]] ]
+; CHECK: store <4 x i32>
+; CHECK: br i1 %{{.*}}, label %[[INNER]], label
+; CHECK: br i1 %{{.*}}, label %[[MIDDLE]], label
+; CHECK-NOT: store i32
+; CHECK: }
+
+@a = global [2 x [3 x [8 x i32]]] zeroinitializer
+
+; a[i][j][k] = 100 * i + 10 * j + k, with the innermost loop unrolled by 4.
+define void @fill() {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %i32 = trunc i64 %i to i32
+  %hundreds = mul i32 %i32, 100
+  br label %middle
+
+middle:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %middle.latch ]
+  %j32 = trunc i64 %j to i32
+  %tens = mul i32 %j32, 10
+  %base = add i32 %hundreds, %tens
+  br label %inner
+
+inner:
+  %k = phi i64 [ 0, %middle ], [ %k.next, %inner ]
+  %k32 = trunc i64 %k to i32
+  %v0 = add i32 %base, %k32
+  %k1 = add i32 %k32, 1
+  %v1 = add i32 %base, %k1
+  %k2 = add i32 %k32, 2
+  %v2 = add i32 %base, %k2
+  %k3 = add i32 %k32, 3
+  %v3 = add i32 %base, %k3
+  %p0 = getelementptr inbounds [2 x [3 x [8 x i32]]], [2 x [3 x [8 x i32]]]* @a, i64 0, i64 %i, i64 %j, i64 %k
+  %p1 = getelementptr inbounds i32, i32* %p0, i64 1
+  %p2 = getelementptr inbounds i32, i32* %p0, i64 2
+  %p3 = getelementptr inbounds i32, i32* %p0, i64 3
+  store i32 %v0, i32* %p0
+  store i32 %v1, i32* %p1
+  store i32 %v2, i32* %p2
+  store i32 %v3, i32* %p3
+  %k.next = add i64 %k, 4
+  %k.done = icmp eq i64 %k.next, 8
+  br i1 %k.done, label %middle.latch, label %inner
+
+middle.latch:
+  %j.next = add i64 %j, 1
+  %j.done = icmp eq i64 %j.next, 3
+  br i1 %j.done, label %outer.latch, label %middle
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %i.done = icmp eq i64 %i.next, 2
+  br i1 %i.done, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; Returns 0 if every element holds its own index digits.
+define i32 @main() {
+entry:
+  call void @fill()
+  br label %loop
+
+loop:
+  %n = phi i64 [ 0, %entry ], [ %n.next, %next ]
+  %p = getelementptr inbounds [2 x [3 x [8 x i32]]], [2 x [3 x [8 x i32]]]* @a, i64 0, i64 0, i64 0, i64 %n
+  %v = load i32, i32* %p
+  %i = udiv i64 %n, 24
+  %j = udiv i64 %n, 8
+  %j3 = urem i64 %j, 3
+  %k = urem i64 %n, 8
+  %i100 = mul i64 %i, 100
+  %j10 = mul i64 %j3, 10
+  %ij = add i64 %i100, %j10
+  %want = add i64 %ij, %k
+  %want32 = trunc i64 %want to i32
+  %ok = icmp eq i32 %v, %want32
+  br i1 %ok, label %next, label %fail
+
+next:
+  %n.next = add i64 %n, 1
+  %done = icmp eq i64 %n.next, 48
+  br i1 %done, label %pass, label %loop
+
+pass:
+  ret i32 0
+
+fail:
+  ret i32 1
+}
@@ -0,0 +1,78 @@
+; Both arms of an if/else store a[0..3]. Accesses at the same offset under
+; the two predicates must not break each other's chains: each arm becomes
+; one vector store.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK-LABEL: define void @f(
+; CHECK: store <4 x i32>
+; CHECK: store <4 x i32>
+; CHECK-NOT: store i32
+
+@a = global [4 x i32] zeroinitializer
+@b = global [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+
+define void @f(i1 %c) {
+entry:
+  %b0 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @b, i64 0, i64 0)
+  %b1 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @b, i64 0, i64 1)
+  %b2 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @b, i64 0, i64 2)
+  %b3 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @b, i64 0, i64 3)
+  br i1 %c, label %then, label %else
+then:
+  %t0 = add i32 %b0, 10
+  %t1 = add i32 %b1, 20
+  %t2 = add i32 %b2, 30
+  %t3 = add i32 %b3, 40
+  store i32 %t0, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 0)
+  store i32 %t1, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 1)
+  store i32 %t2, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 2)
+  store i32 %t3, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 3)
+  br label %join
+else:
+  %e0 = mul i32 %b0, 3
+  %e1 = mul i32 %b1, 5
+  %e2 = mul i32 %b2, 7
+  %e3 = mul i32 %b3, 9
+  store i32 %e0, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 0)
+  store i32 %e1, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 1)
+  store i32 %e2, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 2)
+  store i32 %e3, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 3)
+  br label %join
+join:
+  ret void
+}
+
+define i32 @sum() {
+entry:
+  %a0 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 0)
+  %a1 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 1)
+  %a2 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 2)
+  %a3 = load i32, i32* getelementptr ([4 x i32], [4 x i32]* @a, i64 0, i64 3)
+  %s0 = mul i32 %a0, 1
+  %s1 = mul i32 %a1, 100
+  %s2 = mul i32 %a2, 10000
+  %s3 = mul i32 %a3, 1000000
+  %s01 = add i32 %s0, %s1
+  %s23 = add i32 %s2, %s3
+  %s = add i32 %s01, %s23
+  ret i32 %s
+}
+
+define i32 @main() {
+entry:
+  ; then: 11 22 33 44, else: 3 10 21 36
+  call void @f(i1 true)
+  %r1 = call i32 @sum()
+  call void @f(i1 false)
+  %r2 = call i32 @sum()
+  %ok1 = icmp eq i32 %r1, 44332211
+  %ok2 = icmp eq i32 %r2, 36211003
+  %ok = and i1 %ok1, %ok2
+  %ret = select i1 %ok, i32 0, i32 1
+  ret i32 %ret
+}
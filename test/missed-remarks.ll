@@ -0,0 +1,75 @@
+; Every candidate the packer turns down gets a missed remark naming the
+; reason: @unprofitable cannot pay for building its operand vectors,
+; @mayalias would have to move a load past a store to another argument that
+; may overlap it, @dependence past a store to the same address, and the adds
+; of @predicates sit next to each other under the two arms of a branch.
+; RUN: %svopt -passes=super-vectorization -sv-runtime-checks=false -pass-remarks-missed=.* -pass-remarks-output=%t.yaml %s -S -o /dev/null 2> %t.remarks
+; RUN: FileCheck %s < %t.remarks
+; RUN: FileCheck %s --check-prefix=YAML < %t.yaml
+
+; CHECK: not packed: 2 x add under true: saves no more than the cost threshold of 0
+; CHECK: not packed: 2 x load under true: the lanes can only be moved next to each other if accesses to different objects do not overlap
+; CHECK: not packed: 2 x load under true: a dependence keeps the lanes from being moved next to each other
+; CHECK: not packed: 2 x add under {{.*}}%c{{.*}}: lanes run under different predicates
+
+; YAML: Name: Unprofitable
+; YAML-NEXT: Function: unprofitable
+; YAML: Name: MayAlias
+; YAML-NEXT: Function: mayalias
+; YAML: Name: Dependence
+; YAML-NEXT: Function: dependence
+; YAML: Name: NonUniformPredicate
+; YAML-NEXT: Function: predicates
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @unprofitable(i32* noalias %a, i32 %x, i32 %y) {
+entry:
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %s0 = add i32 %x, 1
+  %s1 = add i32 %y, 2
+  %d0 = sdiv i32 %s0, %y
+  %d1 = sdiv i32 %s1, %x
+  store i32 %d0, i32* %a
+  store i32 %d1, i32* %a1
+  ret void
+}
+
+define void @mayalias(i32* %a, i32* %b) {
+entry:
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %x0 = load i32, i32* %a
+  store i32 %x0, i32* %b
+  %x1 = load i32, i32* %a1
+  store i32 %x1, i32* %b1
+  ret void
+}
+
+define void @dependence(i32* noalias %a, i32* noalias %b) {
+entry:
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %x0 = load i32, i32* %a
+  store i32 %x0, i32* %a1
+  %x1 = load i32, i32* %a1
+  store i32 %x0, i32* %b
+  store i32 %x1, i32* %b1
+  ret void
+}
+
+define void @predicates(i32* noalias %a, i1 %c, i32 %x, i32 %y) {
+entry:
+  br i1 %c, label %then, label %else
+then:
+  %t = add i32 %x, 1
+  br label %join
+else:
+  %e = add i32 %y, 2
+  br label %join
+join:
+  %r = phi i32 [ %t, %then ], [ %e, %else ]
+  store i32 %r, i32* %a
+  ret void
+}
@@ -0,0 +1,35 @@
+; Two accumulators updated in lockstep around a loop are one packed mu-node,
+; lowered to a single vector phi whose lanes keep their own start values.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define i32 @main(
+; CHECK: phi <{{[0-9]+}} x i32> [ <i32 0, i32 5
+; CHECK-NOT: phi i32
+; CHECK: add <{{[0-9]+}} x i32>
+
+@a = global [2 x i32] [i32 1, i32 2]
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s0 = phi i32 [0, %entry], [%n0, %loop]
+  %s1 = phi i32 [5, %entry], [%n1, %loop]
+  %x0 = load i32, i32* getelementptr ([2 x i32], [2 x i32]* @a, i32 0, i32 0)
+  %x1 = load i32, i32* getelementptr ([2 x i32], [2 x i32]* @a, i32 0, i32 1)
+  %n0 = add i32 %s0, %x0
+  %n1 = add i32 %s1, %x1
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, 10
+  br i1 %c, label %loop, label %exit
+exit:
+  ; s0 = 10, s1 = 25
+  %r = mul i32 %n1, 3
+  %r2 = add i32 %r, %n0
+  %ok = icmp eq i32 %r2, 85
+  %ret = select i1 %ok, i32 0, i32 1
+  ret i32 %ret
+}
@@ -0,0 +1,76 @@
+; Twelve nested ifs: each block predicate extends the one of the block around
+; it by a condition, and the join picks the value of the level that exited.
+; Conjunctions are materialized once and reused by the deeper branches and by
+; the gates of the join, so the selects grow linearly with the depth rather
+; than with its square.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: grep -c select %t.ll | FileCheck %s
+; RUN: lli %t.ll
+
+; CHECK: {{^[1-4]?[0-9]$}}
+
+define i32 @f(i32 %x) {
+entry:
+  br label %n0
+n0:
+  %v0 = mul i32 %x, 2
+  %c0 = icmp sgt i32 %v0, 0
+  br i1 %c0, label %n1, label %join
+n1:
+  %v1 = mul i32 %x, 3
+  %c1 = icmp sgt i32 %v1, 1
+  br i1 %c1, label %n2, label %join
+n2:
+  %v2 = mul i32 %x, 4
+  %c2 = icmp sgt i32 %v2, 2
+  br i1 %c2, label %n3, label %join
+n3:
+  %v3 = mul i32 %x, 5
+  %c3 = icmp sgt i32 %v3, 3
+  br i1 %c3, label %n4, label %join
+n4:
+  %v4 = mul i32 %x, 6
+  %c4 = icmp sgt i32 %v4, 4
+  br i1 %c4, label %n5, label %join
+n5:
+  %v5 = mul i32 %x, 7
+  %c5 = icmp sgt i32 %v5, 5
+  br i1 %c5, label %n6, label %join
+n6:
+  %v6 = mul i32 %x, 8
+  %c6 = icmp sgt i32 %v6, 6
+  br i1 %c6, label %n7, label %join
+n7:
+  %v7 = mul i32 %x, 9
+  %c7 = icmp sgt i32 %v7, 7
+  br i1 %c7, label %n8, label %join
+n8:
+  %v8 = mul i32 %x, 10
+  %c8 = icmp sgt i32 %v8, 8
+  br i1 %c8, label %n9, label %join
+n9:
+  %v9 = mul i32 %x, 11
+  %c9 = icmp sgt i32 %v9, 9
+  br i1 %c9, label %n10, label %join
+n10:
+  %v10 = mul i32 %x, 12
+  %c10 = icmp sgt i32 %v10, 10
+  br i1 %c10, label %n11, label %join
+n11:
+  %v11 = mul i32 %x, 13
+  %c11 = icmp sgt i32 %v11, 11
+  br i1 %c11, label %n12, label %join
+n12:
+  br label %join
+join:
+  %r = phi i32 [ %v0, %n0 ], [ %v1, %n1 ], [ %v2, %n2 ], [ %v3, %n3 ], [ %v4, %n4 ], [ %v5, %n5 ], [ %v6, %n6 ], [ %v7, %n7 ], [ %v8, %n8 ], [ %v9, %n9 ], [ %v10, %n10 ], [ %v11, %n11 ], [ 0, %n12 ]
+  ret i32 %r
+}
+
+define i32 @main() {
+  %a = call i32 @f(i32 1)
+  %b = call i32 @f(i32 -3)
+  %s = add i32 %a, %b
+  %r = add i32 %s, 6
+  ret i32 %r
+}
@@ -0,0 +1,74 @@
+; A group of 3 lanes is either padded to 4 or cut into a pack of 2 and a
+; scalar lane, whichever the target prices lower. The generic target pads
+; it, reading and writing through masked accesses that leave the fourth
+; element alone; x86 without AVX-512 has no cheap masked accesses and cuts
+; it. Both results are run with lli, which also checks that c[3] is not
+; written.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.padded.ll
+; RUN: FileCheck %s --check-prefix=PADDED < %t.padded.ll
+; RUN: lli %t.padded.ll
+; RUN: %svopt -passes=super-vectorization -mtriple=x86_64-unknown-linux-gnu %s -S -o %t.cut.ll
+; RUN: FileCheck %s --check-prefix=CUT < %t.cut.ll
+; RUN: lli %t.cut.ll
+
+; PADDED-LABEL: define void @f(
+; PADDED-NOT: load i8
+; PADDED: [[A:%.*]] = call <4 x i8> @llvm.masked.load.v4i8.p0v4i8({{.*}}, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x i8> undef)
+; PADDED: [[B:%.*]] = call <4 x i8> @llvm.masked.load.v4i8.p0v4i8({{.*}}, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x i8> undef)
+; PADDED-NEXT: [[S:%.*]] = add <4 x i8> [[A]], [[B]]
+; PADDED: call void @llvm.masked.store.v4i8.p0v4i8(<4 x i8> [[S]], {{.*}}, <4 x i1> <i1 true, i1 true, i1 true, i1 false>)
+; PADDED: ret void
+
+; CUT-LABEL: define void @f(
+; CUT: load <2 x i8>
+; CUT: load i8
+; CUT: load <2 x i8>
+; CUT: load i8
+; CUT: add <2 x i8>
+; CUT: add i8
+; CUT: store <2 x i8>
+; CUT: store i8
+; CUT-NOT: masked
+; CUT: ret void
+
+@a = global [4 x i8] [i8 1, i8 2, i8 3, i8 4]
+@b = global [4 x i8] [i8 10, i8 20, i8 30, i8 40]
+@c = global [4 x i8] zeroinitializer
+
+; c[0..2] = a[0..2] + b[0..2]; c[3] is not written.
+define void @f() {
+entry:
+  %pa0 = getelementptr inbounds [4 x i8], [4 x i8]* @a, i64 0, i64 0
+  %pa1 = getelementptr inbounds [4 x i8], [4 x i8]* @a, i64 0, i64 1
+  %pa2 = getelementptr inbounds [4 x i8], [4 x i8]* @a, i64 0, i64 2
+  %pb0 = getelementptr inbounds [4 x i8], [4 x i8]* @b, i64 0, i64 0
+  %pb1 = getelementptr inbounds [4 x i8], [4 x i8]* @b, i64 0, i64 1
+  %pb2 = getelementptr inbounds [4 x i8], [4 x i8]* @b, i64 0, i64 2
+  %pc0 = getelementptr inbounds [4 x i8], [4 x i8]* @c, i64 0, i64 0
+  %pc1 = getelementptr inbounds [4 x i8], [4 x i8]* @c, i64 0, i64 1
+  %pc2 = getelementptr inbounds [4 x i8], [4 x i8]* @c, i64 0, i64 2
+  %a0 = load i8, i8* %pa0
+  %a1 = load i8, i8* %pa1
+  %a2 = load i8, i8* %pa2
+  %b0 = load i8, i8* %pb0
+  %b1 = load i8, i8* %pb1
+  %b2 = load i8, i8* %pb2
+  %s0 = add i8 %a0, %b0
+  %s1 = add i8 %a1, %b1
+  %s2 = add i8 %a2, %b2
+  store i8 %s0, i8* %pc0
+  store i8 %s1, i8* %pc1
+  store i8 %s2, i8* %pc2
+  ret void
+}
+
+; Returns 0 if c is {11, 22, 33, 0}.
+define i32 @main() {
+entry:
+  call void @f()
+  %p = bitcast [4 x i8]* @c to i32*
+  %c = load i32, i32* %p
+  %ok = icmp eq i32 %c, 2168331
+  %r = select i1 %ok, i32 0, i32 1
+  ret i32 %r
+}
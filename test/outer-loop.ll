@@ -0,0 +1,133 @@
+; An outer loop whose inner loop runs a different number of times per
+; element is folded by running the lanes through one vector inner loop in
+; lockstep. Each lane stays active until its own inner loop exits, and
+; keeps the values it left with.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define internal void @collatz(
+; CHECK: call <4 x i32> @llvm.masked.load.v4i32.p0v4i32(
+; CHECK: %sv.active{{[0-9]*}} = phi <4 x i1>
+; CHECK: select <4 x i1> %{{.*}}, <4 x i32>
+; CHECK: call i1 @llvm.vector.reduce.or.v4i1(
+; CHECK: call void @llvm.masked.store.v4i32.p0v4i32(
+; CHECK-LABEL: define internal void @chase(
+; CHECK: %sv.active{{[0-9]*}} = phi <4 x i1>
+; CHECK: call void @llvm.masked.store.v4i32.p0v4i32(
+; CHECK-LABEL: define i32 @main(
+
+define internal void @collatz(i32* noalias %a, i32* noalias %b, i64 %n) noinline {
+entry:
+  br label %outer
+outer:
+  %i = phi i64 [0, %entry], [%i.next, %latch]
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  %x0 = load i32, i32* %pa
+  br label %inner
+inner:
+  %x = phi i32 [%x0, %outer], [%x.next, %inner]
+  %s = phi i32 [0, %outer], [%s.next, %inner]
+  %odd = and i32 %x, 1
+  %isodd = icmp ne i32 %odd, 0
+  %m = mul i32 %x, 3
+  %m1 = add i32 %m, 1
+  %h = lshr i32 %x, 1
+  %x.next = select i1 %isodd, i32 %m1, i32 %h
+  %s.next = add i32 %s, 1
+  %c = icmp ugt i32 %x.next, 1
+  br i1 %c, label %inner, label %latch
+latch:
+  %steps = phi i32 [%s.next, %inner]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  store i32 %steps, i32* %pb
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %outer
+exit:
+  ret void
+}
+
+@tab = internal constant [8 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6]
+
+; chase t = tab[t & 7] until it hits 9 or 8 steps, per element
+define internal void @chase(i32* noalias %a, i32* noalias %b, i64 %n) noinline {
+entry:
+  br label %outer
+outer:
+  %i = phi i64 [0, %entry], [%i.next, %latch]
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  %t0 = load i32, i32* %pa
+  br label %inner
+inner:
+  %t = phi i32 [%t0, %outer], [%v, %inner]
+  %k = phi i32 [0, %outer], [%k.next, %inner]
+  %m = and i32 %t, 7
+  %z = zext i32 %m to i64
+  %p = getelementptr inbounds [8 x i32], [8 x i32]* @tab, i64 0, i64 %z
+  %v = load i32, i32* %p
+  %k.next = add i32 %k, 1
+  %f = icmp ne i32 %v, 9
+  %l = icmp ult i32 %k.next, 8
+  %c = and i1 %f, %l
+  br i1 %c, label %inner, label %latch
+latch:
+  %r = mul i32 %k.next, 10
+  %r2 = add i32 %r, %v
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  store i32 %r2, i32* %pb
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %outer
+exit:
+  ret void
+}
+
+define i32 @main() {
+  %a = alloca [13 x i32]
+  %b = alloca [13 x i32]
+  %a0 = getelementptr [13 x i32], [13 x i32]* %a, i64 0, i64 0
+  %b0 = getelementptr [13 x i32], [13 x i32]* %b, i64 0, i64 0
+  br label %init
+init:
+  %j = phi i64 [0, %0], [%j1, %init]
+  %j32 = trunc i64 %j to i32
+  %v = add i32 %j32, 1
+  %pj = getelementptr i32, i32* %a0, i64 %j
+  store i32 %v, i32* %pj
+  %j1 = add i64 %j, 1
+  %jd = icmp eq i64 %j1, 13
+  br i1 %jd, label %run, label %init
+run:
+  %n = call i64 @count()
+  call void @collatz(i32* %a0, i32* %b0, i64 %n)
+  %s1 = call i32 @sum(i32* %b0, i64 %n)
+  call void @chase(i32* %a0, i32* %b0, i64 %n)
+  %s2 = call i32 @sum(i32* %b0, i64 %n)
+  %s3 = mul i32 %s2, 7
+  %s = add i32 %s1, %s3
+  %r = and i32 %s, 255
+  %bad = icmp ne i32 %r, 47
+  %ret = zext i1 %bad to i32
+  ret i32 %ret
+}
+
+define internal i64 @count() noinline {
+  ret i64 13
+}
+
+define internal i32 @sum(i32* %p, i64 %n) noinline {
+entry:
+  br label %l
+l:
+  %i = phi i64 [0, %entry], [%i1, %l]
+  %acc = phi i32 [0, %entry], [%acc1, %l]
+  %q = getelementptr i32, i32* %p, i64 %i
+  %v = load i32, i32* %q
+  %acc1 = add i32 %acc, %v
+  %i1 = add i64 %i, 1
+  %d = icmp eq i64 %i1, %n
+  br i1 %d, label %x, label %l
+x:
+  ret i32 %acc1
+}
@@ -0,0 +1,250 @@
+; Plain pointer arguments may alias, which blocks every store pack of these
+; independent c[i] = a[i] + b[i] statements. Versioning on overlap checks is
+; priced before anything is copied, and the checks compare one range per
+; object, built from the lowest and highest offset of its accesses rather
+; than a min/max over every access, so their cost does not grow with the
+; statements. Here the blocked packs do not pay for the copy, and the
+; function is left as it was.
+; RUN: %svopt -passes=super-vectorization -pass-remarks-missed=super-vectorization %s -S -o %t.ll 2> %t.remarks
+; RUN: FileCheck %s < %t.ll
+; RUN: FileCheck %s --check-prefix=REMARK < %t.remarks
+
+; REMARK: remark: {{.*}}: not versioned on overlap checks: the blocked packs save at most {{[0-9]+}}, the checks and the copied code cost {{[1-9][0-9]?$}}
+
+; CHECK-LABEL: define void @f(
+; CHECK-NOT: ptrtoint
+; CHECK-NOT: llvm.umax
+; CHECK: ret void
+; CHECK-NOT: declare i64 @llvm.umax
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @f(float* %a, float* %b, float* %c) {
+entry:
+  %pa0 = getelementptr inbounds float, float* %a, i64 0
+  %pb0 = getelementptr inbounds float, float* %b, i64 0
+  %pc0 = getelementptr inbounds float, float* %c, i64 0
+  %x0 = load float, float* %pa0, align 4
+  %y0 = load float, float* %pb0, align 4
+  %s0 = fadd float %x0, %y0
+  store float %s0, float* %pc0, align 4
+  %pa1 = getelementptr inbounds float, float* %a, i64 1
+  %pb1 = getelementptr inbounds float, float* %b, i64 1
+  %pc1 = getelementptr inbounds float, float* %c, i64 1
+  %x1 = load float, float* %pa1, align 4
+  %y1 = load float, float* %pb1, align 4
+  %s1 = fadd float %x1, %y1
+  store float %s1, float* %pc1, align 4
+  %pa2 = getelementptr inbounds float, float* %a, i64 2
+  %pb2 = getelementptr inbounds float, float* %b, i64 2
+  %pc2 = getelementptr inbounds float, float* %c, i64 2
+  %x2 = load float, float* %pa2, align 4
+  %y2 = load float, float* %pb2, align 4
+  %s2 = fadd float %x2, %y2
+  store float %s2, float* %pc2, align 4
+  %pa3 = getelementptr inbounds float, float* %a, i64 3
+  %pb3 = getelementptr inbounds float, float* %b, i64 3
+  %pc3 = getelementptr inbounds float, float* %c, i64 3
+  %x3 = load float, float* %pa3, align 4
+  %y3 = load float, float* %pb3, align 4
+  %s3 = fadd float %x3, %y3
+  store float %s3, float* %pc3, align 4
+  %pa4 = getelementptr inbounds float, float* %a, i64 4
+  %pb4 = getelementptr inbounds float, float* %b, i64 4
+  %pc4 = getelementptr inbounds float, float* %c, i64 4
+  %x4 = load float, float* %pa4, align 4
+  %y4 = load float, float* %pb4, align 4
+  %s4 = fadd float %x4, %y4
+  store float %s4, float* %pc4, align 4
+  %pa5 = getelementptr inbounds float, float* %a, i64 5
+  %pb5 = getelementptr inbounds float, float* %b, i64 5
+  %pc5 = getelementptr inbounds float, float* %c, i64 5
+  %x5 = load float, float* %pa5, align 4
+  %y5 = load float, float* %pb5, align 4
+  %s5 = fadd float %x5, %y5
+  store float %s5, float* %pc5, align 4
+  %pa6 = getelementptr inbounds float, float* %a, i64 6
+  %pb6 = getelementptr inbounds float, float* %b, i64 6
+  %pc6 = getelementptr inbounds float, float* %c, i64 6
+  %x6 = load float, float* %pa6, align 4
+  %y6 = load float, float* %pb6, align 4
+  %s6 = fadd float %x6, %y6
+  store float %s6, float* %pc6, align 4
+  %pa7 = getelementptr inbounds float, float* %a, i64 7
+  %pb7 = getelementptr inbounds float, float* %b, i64 7
+  %pc7 = getelementptr inbounds float, float* %c, i64 7
+  %x7 = load float, float* %pa7, align 4
+  %y7 = load float, float* %pb7, align 4
+  %s7 = fadd float %x7, %y7
+  store float %s7, float* %pc7, align 4
+  %pa8 = getelementptr inbounds float, float* %a, i64 8
+  %pb8 = getelementptr inbounds float, float* %b, i64 8
+  %pc8 = getelementptr inbounds float, float* %c, i64 8
+  %x8 = load float, float* %pa8, align 4
+  %y8 = load float, float* %pb8, align 4
+  %s8 = fadd float %x8, %y8
+  store float %s8, float* %pc8, align 4
+  %pa9 = getelementptr inbounds float, float* %a, i64 9
+  %pb9 = getelementptr inbounds float, float* %b, i64 9
+  %pc9 = getelementptr inbounds float, float* %c, i64 9
+  %x9 = load float, float* %pa9, align 4
+  %y9 = load float, float* %pb9, align 4
+  %s9 = fadd float %x9, %y9
+  store float %s9, float* %pc9, align 4
+  %pa10 = getelementptr inbounds float, float* %a, i64 10
+  %pb10 = getelementptr inbounds float, float* %b, i64 10
+  %pc10 = getelementptr inbounds float, float* %c, i64 10
+  %x10 = load float, float* %pa10, align 4
+  %y10 = load float, float* %pb10, align 4
+  %s10 = fadd float %x10, %y10
+  store float %s10, float* %pc10, align 4
+  %pa11 = getelementptr inbounds float, float* %a, i64 11
+  %pb11 = getelementptr inbounds float, float* %b, i64 11
+  %pc11 = getelementptr inbounds float, float* %c, i64 11
+  %x11 = load float, float* %pa11, align 4
+  %y11 = load float, float* %pb11, align 4
+  %s11 = fadd float %x11, %y11
+  store float %s11, float* %pc11, align 4
+  %pa12 = getelementptr inbounds float, float* %a, i64 12
+  %pb12 = getelementptr inbounds float, float* %b, i64 12
+  %pc12 = getelementptr inbounds float, float* %c, i64 12
+  %x12 = load float, float* %pa12, align 4
+  %y12 = load float, float* %pb12, align 4
+  %s12 = fadd float %x12, %y12
+  store float %s12, float* %pc12, align 4
+  %pa13 = getelementptr inbounds float, float* %a, i64 13
+  %pb13 = getelementptr inbounds float, float* %b, i64 13
+  %pc13 = getelementptr inbounds float, float* %c, i64 13
+  %x13 = load float, float* %pa13, align 4
+  %y13 = load float, float* %pb13, align 4
+  %s13 = fadd float %x13, %y13
+  store float %s13, float* %pc13, align 4
+  %pa14 = getelementptr inbounds float, float* %a, i64 14
+  %pb14 = getelementptr inbounds float, float* %b, i64 14
+  %pc14 = getelementptr inbounds float, float* %c, i64 14
+  %x14 = load float, float* %pa14, align 4
+  %y14 = load float, float* %pb14, align 4
+  %s14 = fadd float %x14, %y14
+  store float %s14, float* %pc14, align 4
+  %pa15 = getelementptr inbounds float, float* %a, i64 15
+  %pb15 = getelementptr inbounds float, float* %b, i64 15
+  %pc15 = getelementptr inbounds float, float* %c, i64 15
+  %x15 = load float, float* %pa15, align 4
+  %y15 = load float, float* %pb15, align 4
+  %s15 = fadd float %x15, %y15
+  store float %s15, float* %pc15, align 4
+  %pa16 = getelementptr inbounds float, float* %a, i64 16
+  %pb16 = getelementptr inbounds float, float* %b, i64 16
+  %pc16 = getelementptr inbounds float, float* %c, i64 16
+  %x16 = load float, float* %pa16, align 4
+  %y16 = load float, float* %pb16, align 4
+  %s16 = fadd float %x16, %y16
+  store float %s16, float* %pc16, align 4
+  %pa17 = getelementptr inbounds float, float* %a, i64 17
+  %pb17 = getelementptr inbounds float, float* %b, i64 17
+  %pc17 = getelementptr inbounds float, float* %c, i64 17
+  %x17 = load float, float* %pa17, align 4
+  %y17 = load float, float* %pb17, align 4
+  %s17 = fadd float %x17, %y17
+  store float %s17, float* %pc17, align 4
+  %pa18 = getelementptr inbounds float, float* %a, i64 18
+  %pb18 = getelementptr inbounds float, float* %b, i64 18
+  %pc18 = getelementptr inbounds float, float* %c, i64 18
+  %x18 = load float, float* %pa18, align 4
+  %y18 = load float, float* %pb18, align 4
+  %s18 = fadd float %x18, %y18
+  store float %s18, float* %pc18, align 4
+  %pa19 = getelementptr inbounds float, float* %a, i64 19
+  %pb19 = getelementptr inbounds float, float* %b, i64 19
+  %pc19 = getelementptr inbounds float, float* %c, i64 19
+  %x19 = load float, float* %pa19, align 4
+  %y19 = load float, float* %pb19, align 4
+  %s19 = fadd float %x19, %y19
+  store float %s19, float* %pc19, align 4
+  %pa20 = getelementptr inbounds float, float* %a, i64 20
+  %pb20 = getelementptr inbounds float, float* %b, i64 20
+  %pc20 = getelementptr inbounds float, float* %c, i64 20
+  %x20 = load float, float* %pa20, align 4
+  %y20 = load float, float* %pb20, align 4
+  %s20 = fadd float %x20, %y20
+  store float %s20, float* %pc20, align 4
+  %pa21 = getelementptr inbounds float, float* %a, i64 21
+  %pb21 = getelementptr inbounds float, float* %b, i64 21
+  %pc21 = getelementptr inbounds float, float* %c, i64 21
+  %x21 = load float, float* %pa21, align 4
+  %y21 = load float, float* %pb21, align 4
+  %s21 = fadd float %x21, %y21
+  store float %s21, float* %pc21, align 4
+  %pa22 = getelementptr inbounds float, float* %a, i64 22
+  %pb22 = getelementptr inbounds float, float* %b, i64 22
+  %pc22 = getelementptr inbounds float, float* %c, i64 22
+  %x22 = load float, float* %pa22, align 4
+  %y22 = load float, float* %pb22, align 4
+  %s22 = fadd float %x22, %y22
+  store float %s22, float* %pc22, align 4
+  %pa23 = getelementptr inbounds float, float* %a, i64 23
+  %pb23 = getelementptr inbounds float, float* %b, i64 23
+  %pc23 = getelementptr inbounds float, float* %c, i64 23
+  %x23 = load float, float* %pa23, align 4
+  %y23 = load float, float* %pb23, align 4
+  %s23 = fadd float %x23, %y23
+  store float %s23, float* %pc23, align 4
+  %pa24 = getelementptr inbounds float, float* %a, i64 24
+  %pb24 = getelementptr inbounds float, float* %b, i64 24
+  %pc24 = getelementptr inbounds float, float* %c, i64 24
+  %x24 = load float, float* %pa24, align 4
+  %y24 = load float, float* %pb24, align 4
+  %s24 = fadd float %x24, %y24
+  store float %s24, float* %pc24, align 4
+  %pa25 = getelementptr inbounds float, float* %a, i64 25
+  %pb25 = getelementptr inbounds float, float* %b, i64 25
+  %pc25 = getelementptr inbounds float, float* %c, i64 25
+  %x25 = load float, float* %pa25, align 4
+  %y25 = load float, float* %pb25, align 4
+  %s25 = fadd float %x25, %y25
+  store float %s25, float* %pc25, align 4
+  %pa26 = getelementptr inbounds float, float* %a, i64 26
+  %pb26 = getelementptr inbounds float, float* %b, i64 26
+  %pc26 = getelementptr inbounds float, float* %c, i64 26
+  %x26 = load float, float* %pa26, align 4
+  %y26 = load float, float* %pb26, align 4
+  %s26 = fadd float %x26, %y26
+  store float %s26, float* %pc26, align 4
+  %pa27 = getelementptr inbounds float, float* %a, i64 27
+  %pb27 = getelementptr inbounds float, float* %b, i64 27
+  %pc27 = getelementptr inbounds float, float* %c, i64 27
+  %x27 = load float, float* %pa27, align 4
+  %y27 = load float, float* %pb27, align 4
+  %s27 = fadd float %x27, %y27
+  store float %s27, float* %pc27, align 4
+  %pa28 = getelementptr inbounds float, float* %a, i64 28
+  %pb28 = getelementptr inbounds float, float* %b, i64 28
+  %pc28 = getelementptr inbounds float, float* %c, i64 28
+  %x28 = load float, float* %pa28, align 4
+  %y28 = load float, float* %pb28, align 4
+  %s28 = fadd float %x28, %y28
+  store float %s28, float* %pc28, align 4
+  %pa29 = getelementptr inbounds float, float* %a, i64 29
+  %pb29 = getelementptr inbounds float, float* %b, i64 29
+  %pc29 = getelementptr inbounds float, float* %c, i64 29
+  %x29 = load float, float* %pa29, align 4
+  %y29 = load float, float* %pb29, align 4
+  %s29 = fadd float %x29, %y29
+  store float %s29, float* %pc29, align 4
+  %pa30 = getelementptr inbounds float, float* %a, i64 30
+  %pb30 = getelementptr inbounds float, float* %b, i64 30
+  %pc30 = getelementptr inbounds float, float* %c, i64 30
+  %x30 = load float, float* %pa30, align 4
+  %y30 = load float, float* %pb30, align 4
+  %s30 = fadd float %x30, %y30
+  store float %s30, float* %pc30, align 4
+  %pa31 = getelementptr inbounds float, float* %a, i64 31
+  %pb31 = getelementptr inbounds float, float* %b, i64 31
+  %pc31 = getelementptr inbounds float, float* %c, i64 31
+  %x31 = load float, float* %pa31, align 4
+  %y31 = load float, float* %pb31, align 4
+  %s31 = fadd float %x31, %y31
+  store float %s31, float* %pc31, align 4
+  ret void
+}
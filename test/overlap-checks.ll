@@ -0,0 +1,122 @@
+; Overlap versioning copies the function behind runtime checks. The copy is
+; kept for @k, whose loop packs only once its stores are known not to alias
+; its loads, and dropped for @f, whose four straight-line lanes do not pay for
+; the checks.
+; RUN: %svopt -passes=super-vectorization -pass-remarks=super-vectorization -pass-remarks-missed=super-vectorization %s -S -o %t.ll 2> %t.remarks
+; RUN: FileCheck %s < %t.ll
+; RUN: FileCheck %s --check-prefix=REMARK < %t.remarks
+; RUN: lli %t.ll
+
+; REMARK-DAG: remark: {{.*}}: versioned on overlap checks
+; REMARK-DAG: remark: {{.*}}: not versioned on overlap checks
+
+; CHECK-LABEL: define void @k(
+; CHECK: ptrtoint float* %b
+; CHECK: ptrtoint float* %a
+; CHECK: store <4 x float>
+; CHECK-LABEL: define void @f(
+; CHECK-NOT: ptrtoint
+; CHECK-NOT: br i1
+; CHECK: ret void
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@A = global [64 x float] zeroinitializer
+@B = global [64 x float] zeroinitializer
+
+define void @k(float* %a, float* %b, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %base = shl i64 %i, 2
+  %pa0 = getelementptr inbounds float, float* %a, i64 %base
+  %pa1 = getelementptr inbounds float, float* %pa0, i64 1
+  %pa2 = getelementptr inbounds float, float* %pa0, i64 2
+  %pa3 = getelementptr inbounds float, float* %pa0, i64 3
+  %pb0 = getelementptr inbounds float, float* %b, i64 %base
+  %pb1 = getelementptr inbounds float, float* %pb0, i64 1
+  %pb2 = getelementptr inbounds float, float* %pb0, i64 2
+  %pb3 = getelementptr inbounds float, float* %pb0, i64 3
+  %x0 = load float, float* %pa0
+  %y0 = fmul float %x0, 2.0
+  store float %y0, float* %pb0
+  %x1 = load float, float* %pa1
+  %y1 = fmul float %x1, 3.0
+  store float %y1, float* %pb1
+  %x2 = load float, float* %pa2
+  %y2 = fmul float %x2, 4.0
+  store float %y2, float* %pb2
+  %x3 = load float, float* %pa3
+  %y3 = fmul float %x3, 5.0
+  store float %y3, float* %pb3
+  %i.next = add nuw i64 %i, 1
+  %c = icmp ult i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  br label %init
+init:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %init ]
+  %p = getelementptr [64 x float], [64 x float]* @A, i64 0, i64 %j
+  %jt = trunc i64 %j to i32
+  %jm = and i32 %jt, 3
+  %f = sitofp i32 %jm to float
+  store float %f, float* %p
+  %j.next = add i64 %j, 1
+  %ci = icmp ult i64 %j.next, 64
+  br i1 %ci, label %init, label %run
+run:
+  %a = getelementptr [64 x float], [64 x float]* @A, i64 0, i64 0
+  %b = getelementptr [64 x float], [64 x float]* @B, i64 0, i64 0
+  call void @k(float* %a, float* %b, i64 8)
+  %a1 = getelementptr [64 x float], [64 x float]* @A, i64 0, i64 1
+  call void @k(float* %a, float* %a1, i64 8)
+  br label %sum
+sum:
+  %s = phi float [ 0.0, %run ], [ %s.next, %sum ]
+  %m = phi i64 [ 0, %run ], [ %m.next, %sum ]
+  %qa = getelementptr [64 x float], [64 x float]* @A, i64 0, i64 %m
+  %qb = getelementptr [64 x float], [64 x float]* @B, i64 0, i64 %m
+  %va = load float, float* %qa
+  %vb = load float, float* %qb
+  %s1 = fadd float %s, %va
+  %s.next = fadd float %s1, %vb
+  %m.next = add i64 %m, 1
+  %cs = icmp ult i64 %m.next, 64
+  br i1 %cs, label %sum, label %done
+done:
+  %r = fptosi float %s.next to i32
+  %rm = urem i32 %r, 251
+  %bad = icmp ne i32 %rm, 5
+  %ret = zext i1 %bad to i32
+  ret i32 %ret
+}
+
+define void @f(i32* %a, i32* %b) {
+entry:
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %a2 = getelementptr inbounds i32, i32* %a, i64 2
+  %a3 = getelementptr inbounds i32, i32* %a, i64 3
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %b2 = getelementptr inbounds i32, i32* %b, i64 2
+  %b3 = getelementptr inbounds i32, i32* %b, i64 3
+  %x0 = load i32, i32* %a
+  %y0 = shl i32 %x0, 1
+  store i32 %y0, i32* %b
+  %x1 = load i32, i32* %a1
+  %y1 = shl i32 %x1, 1
+  store i32 %y1, i32* %b1
+  %x2 = load i32, i32* %a2
+  %y2 = shl i32 %x2, 1
+  store i32 %y2, i32* %b2
+  %x3 = load i32, i32* %a3
+  %y3 = shl i32 %x3, 1
+  store i32 %y3, i32* %b3
+  ret void
+}
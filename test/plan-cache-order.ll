@@ -0,0 +1,26 @@
+; The store pack can only be placed by sinking the first store past the second
+; sub. A second run takes the plan from the cache and must lower the pack
+; where the first run placed it, after both subs.
+; RUN: rm -rf %t.cache
+; RUN: %svopt -passes=super-vectorization -sv-cost-threshold=-100 -sv-plan-cache-dir=%t.cache %s -S -o %t.first.ll
+; RUN: %svopt -passes=super-vectorization -sv-cost-threshold=-100 -sv-plan-cache-dir=%t.cache %s -S -o %t.second.ll
+; RUN: FileCheck %s < %t.first.ll
+; RUN: FileCheck %s < %t.second.ll
+
+; CHECK-LABEL: define void @f(
+; CHECK: sub i32 %x, 1
+; CHECK: sub i32 %y, 2
+; CHECK: store <2 x i32>
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @f(i32 %x, i32 %y, i32* %a) {
+entry:
+  %v0 = sub i32 %x, 1
+  store i32 %v0, i32* %a
+  %v1 = sub i32 %y, 2
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  store i32 %v1, i32* %a1
+  ret void
+}
@@ -0,0 +1,86 @@
+; Branch conditions whose value is known where they are computed fold to
+; true or false in the predicates of the predicated SSA: the else arm of each
+; function runs under false, and its then arm under the predicate of the
+; branch alone. @known_bits branches on the low bit of x | 1, which known
+; bits fix at 1; in @dominating_branch x > 0 follows from the branch on
+; x > 10 above it; in @value_range lazy value info bounds x % 10 below 10.
+; RUN: %svopt -passes=super-vectorization -sv-dump-predicated-ssa=%t.pssa %s -disable-output
+; RUN: FileCheck %s < %t.pssa
+
+; CHECK-LABEL: function @known_bits
+; CHECK-NEXT: pred 0 true
+; CHECK-NOT: cond
+; CHECK: item i3 0
+; CHECK-NEXT: pred 1 not 0
+; CHECK-NEXT: item i5 1
+; CHECK-NOT: cond
+; CHECK: endfunction
+
+; CHECK-LABEL: function @dominating_branch
+; CHECK-NEXT: pred 0 true
+; CHECK-NEXT: item i0 0
+; CHECK-NEXT: pred 1 cond i0
+; CHECK-NEXT: item i2 1
+; CHECK-NEXT: item i4 1
+; CHECK-NEXT: pred 2 not 0
+; CHECK-NEXT: item i6 2
+; CHECK-NOT: cond
+; CHECK: endfunction
+
+; CHECK-LABEL: function @value_range
+; CHECK-NEXT: pred 0 true
+; CHECK-NOT: cond
+; CHECK: item i3 0
+; CHECK-NEXT: pred 1 not 0
+; CHECK-NEXT: item i5 1
+; CHECK-NOT: cond
+; CHECK: endfunction
+
+@g = global [4 x i32] zeroinitializer
+
+define void @known_bits(i32 %x) {
+entry:
+  %odd = or i32 %x, 1
+  %c = trunc i32 %odd to i1
+  br i1 %c, label %then, label %else
+then:
+  store i32 1, i32* getelementptr ([4 x i32], [4 x i32]* @g, i64 0, i64 0)
+  br label %exit
+else:
+  store i32 2, i32* getelementptr ([4 x i32], [4 x i32]* @g, i64 0, i64 1)
+  br label %exit
+exit:
+  ret void
+}
+
+define void @dominating_branch(i32 %x) {
+entry:
+  %big = icmp sgt i32 %x, 10
+  br i1 %big, label %check, label %exit
+check:
+  %positive = icmp sgt i32 %x, 0
+  br i1 %positive, label %then, label %else
+then:
+  store i32 1, i32* getelementptr ([4 x i32], [4 x i32]* @g, i64 0, i64 0)
+  br label %exit
+else:
+  store i32 2, i32* getelementptr ([4 x i32], [4 x i32]* @g, i64 0, i64 1)
+  br label %exit
+exit:
+  ret void
+}
+
+define void @value_range(i32 %x) {
+entry:
+  %r = urem i32 %x, 10
+  %small = icmp ult i32 %r, 10
+  br i1 %small, label %then, label %else
+then:
+  store i32 1, i32* getelementptr ([4 x i32], [4 x i32]* @g, i64 0, i64 0)
+  br label %exit
+else:
+  store i32 2, i32* getelementptr ([4 x i32], [4 x i32]* @g, i64 0, i64 1)
+  br label %exit
+exit:
+  ret void
+}
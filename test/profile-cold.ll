@@ -0,0 +1,112 @@
+; With a profile, a function whose entry count is 0 is left as it is, and
+; packs in a block the profile marks as cold stay scalar. The rare arm of
+; @rare_branch keeps its scalar muls and stores; the loads before the branch
+; and the stores of the common arm are packed. -sv-profile-guided=false
+; ignores the profile.
+; RUN: %svopt -passes=super-vectorization -pass-remarks=super-vectorization -pass-remarks-missed=super-vectorization %s -S -o %t.ll 2> %t.remarks
+; RUN: FileCheck %s < %t.ll
+; RUN: FileCheck %s --check-prefix=REMARK < %t.remarks
+; RUN: %svopt -passes=super-vectorization -sv-profile-guided=false %s -S | FileCheck %s --check-prefix=NOPROFILE
+
+; REMARK: not packed: 4 x store under %c: the profile marks the block as cold
+; REMARK: not packed: 4 x mul under %c: the profile marks the block as cold
+; REMARK: packed 4 x load under true
+; REMARK: packed 4 x store under !(%c)
+
+; CHECK-LABEL: define void @never_run(
+; CHECK-NOT: <4 x i32>
+; CHECK: %x0 = load i32, i32* %b
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+
+; CHECK-LABEL: define void @rare_branch(
+; CHECK: load <4 x i32>
+; CHECK: store <4 x i32> {{.*}}
+; CHECK-NOT: <4 x i32>
+; CHECK: mul i32
+; CHECK: mul i32
+; CHECK: mul i32
+; CHECK: mul i32
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+
+; NOPROFILE-LABEL: define void @never_run(
+; NOPROFILE: load <4 x i32>
+; NOPROFILE: store <4 x i32>
+; NOPROFILE-LABEL: define void @rare_branch(
+; NOPROFILE: store <4 x i32>
+; NOPROFILE: store <4 x i32>
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @never_run(i32* noalias %a, i32* noalias %b) !prof !15 {
+entry:
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %b2 = getelementptr inbounds i32, i32* %b, i64 2
+  %b3 = getelementptr inbounds i32, i32* %b, i64 3
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %a2 = getelementptr inbounds i32, i32* %a, i64 2
+  %a3 = getelementptr inbounds i32, i32* %a, i64 3
+  %x0 = load i32, i32* %b
+  %x1 = load i32, i32* %b1
+  %x2 = load i32, i32* %b2
+  %x3 = load i32, i32* %b3
+  store i32 %x0, i32* %a
+  store i32 %x1, i32* %a1
+  store i32 %x2, i32* %a2
+  store i32 %x3, i32* %a3
+  ret void
+}
+
+define void @rare_branch(i32* noalias %a, i32* noalias %b, i1 %c) !prof !16 {
+entry:
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %b2 = getelementptr inbounds i32, i32* %b, i64 2
+  %b3 = getelementptr inbounds i32, i32* %b, i64 3
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %a2 = getelementptr inbounds i32, i32* %a, i64 2
+  %a3 = getelementptr inbounds i32, i32* %a, i64 3
+  %x0 = load i32, i32* %b
+  %x1 = load i32, i32* %b1
+  %x2 = load i32, i32* %b2
+  %x3 = load i32, i32* %b3
+  br i1 %c, label %rare, label %common, !prof !17
+rare:
+  %y0 = mul i32 %x0, 3
+  %y1 = mul i32 %x1, 5
+  %y2 = mul i32 %x2, 7
+  %y3 = mul i32 %x3, 9
+  store i32 %y0, i32* %a
+  store i32 %y1, i32* %a1
+  store i32 %y2, i32* %a2
+  store i32 %y3, i32* %a3
+  br label %exit
+common:
+  store i32 %x0, i32* %a
+  store i32 %x1, i32* %a1
+  store i32 %x2, i32* %a2
+  store i32 %x3, i32* %a3
+  br label %exit
+exit:
+  ret void
+}
+
+!llvm.module.flags = !{!0}
+!0 = !{i32 1, !"ProfileSummary", !1}
+!1 = !{!2, !3, !4, !5, !6, !7, !8, !9}
+!2 = !{!"ProfileFormat", !"InstrProf"}
+!3 = !{!"TotalCount", i64 10000}
+!4 = !{!"MaxCount", i64 1000}
+!5 = !{!"MaxInternalCount", i64 1000}
+!6 = !{!"MaxFunctionCount", i64 1000}
+!7 = !{!"NumCounts", i64 4}
+!8 = !{!"NumFunctions", i64 2}
+!9 = !{!"DetailedSummary", !10}
+!10 = !{!11, !12, !13}
+!11 = !{i32 10000, i64 1000, i32 1}
+!12 = !{i32 999000, i64 1000, i32 3}
+!13 = !{i32 999999, i64 10, i32 4}
+!15 = !{!"function_entry_count", i64 0}
+!16 = !{!"function_entry_count", i64 1000}
+!17 = !{!"branch_weights", i32 1, i32 999}
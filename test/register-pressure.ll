@@ -0,0 +1,361 @@
+; A pack that would keep more vector registers live than the target has is
+; left scalar. Each pack of 16 x i64 loads takes 8 of the 16 xmm registers
+; and stays live until its store pack: @over loads three of them before
+; storing any, so its third pack is turned down, while the two of @fits fit.
+; RUN: %svopt -passes=super-vectorization -sv-lane-width=16 -pass-remarks=super-vectorization -pass-remarks-missed=super-vectorization %s -S -o %t.ll 2> %t.remarks
+; RUN: FileCheck %s < %t.ll
+; RUN: FileCheck %s --check-prefix=REMARK < %t.remarks
+
+; REMARK: not packed: 16 x load under true: would need 24 {{.*}} registers, more than the 16 available
+; REMARK-NOT: would need
+
+; CHECK-LABEL: define void @over(
+; CHECK: load <16 x i64>
+; CHECK: load <16 x i64>
+; CHECK-NOT: load <16 x i64>
+; CHECK: load i64
+; CHECK: store <16 x i64>
+; CHECK: store <16 x i64>
+; CHECK: store <16 x i64>
+; CHECK: ret void
+
+; CHECK-LABEL: define void @fits(
+; CHECK-NOT: load i64
+; CHECK: load <16 x i64>
+; CHECK: load <16 x i64>
+; CHECK: store <16 x i64>
+; CHECK: store <16 x i64>
+; CHECK: ret void
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @over(i64* noalias %a, i64* noalias %b) {
+entry:
+  %pa0 = getelementptr inbounds i64, i64* %a, i64 0
+  %x0 = load i64, i64* %pa0
+  %pa1 = getelementptr inbounds i64, i64* %a, i64 1
+  %x1 = load i64, i64* %pa1
+  %pa2 = getelementptr inbounds i64, i64* %a, i64 2
+  %x2 = load i64, i64* %pa2
+  %pa3 = getelementptr inbounds i64, i64* %a, i64 3
+  %x3 = load i64, i64* %pa3
+  %pa4 = getelementptr inbounds i64, i64* %a, i64 4
+  %x4 = load i64, i64* %pa4
+  %pa5 = getelementptr inbounds i64, i64* %a, i64 5
+  %x5 = load i64, i64* %pa5
+  %pa6 = getelementptr inbounds i64, i64* %a, i64 6
+  %x6 = load i64, i64* %pa6
+  %pa7 = getelementptr inbounds i64, i64* %a, i64 7
+  %x7 = load i64, i64* %pa7
+  %pa8 = getelementptr inbounds i64, i64* %a, i64 8
+  %x8 = load i64, i64* %pa8
+  %pa9 = getelementptr inbounds i64, i64* %a, i64 9
+  %x9 = load i64, i64* %pa9
+  %pa10 = getelementptr inbounds i64, i64* %a, i64 10
+  %x10 = load i64, i64* %pa10
+  %pa11 = getelementptr inbounds i64, i64* %a, i64 11
+  %x11 = load i64, i64* %pa11
+  %pa12 = getelementptr inbounds i64, i64* %a, i64 12
+  %x12 = load i64, i64* %pa12
+  %pa13 = getelementptr inbounds i64, i64* %a, i64 13
+  %x13 = load i64, i64* %pa13
+  %pa14 = getelementptr inbounds i64, i64* %a, i64 14
+  %x14 = load i64, i64* %pa14
+  %pa15 = getelementptr inbounds i64, i64* %a, i64 15
+  %x15 = load i64, i64* %pa15
+  %pa16 = getelementptr inbounds i64, i64* %a, i64 16
+  %x16 = load i64, i64* %pa16
+  %pa17 = getelementptr inbounds i64, i64* %a, i64 17
+  %x17 = load i64, i64* %pa17
+  %pa18 = getelementptr inbounds i64, i64* %a, i64 18
+  %x18 = load i64, i64* %pa18
+  %pa19 = getelementptr inbounds i64, i64* %a, i64 19
+  %x19 = load i64, i64* %pa19
+  %pa20 = getelementptr inbounds i64, i64* %a, i64 20
+  %x20 = load i64, i64* %pa20
+  %pa21 = getelementptr inbounds i64, i64* %a, i64 21
+  %x21 = load i64, i64* %pa21
+  %pa22 = getelementptr inbounds i64, i64* %a, i64 22
+  %x22 = load i64, i64* %pa22
+  %pa23 = getelementptr inbounds i64, i64* %a, i64 23
+  %x23 = load i64, i64* %pa23
+  %pa24 = getelementptr inbounds i64, i64* %a, i64 24
+  %x24 = load i64, i64* %pa24
+  %pa25 = getelementptr inbounds i64, i64* %a, i64 25
+  %x25 = load i64, i64* %pa25
+  %pa26 = getelementptr inbounds i64, i64* %a, i64 26
+  %x26 = load i64, i64* %pa26
+  %pa27 = getelementptr inbounds i64, i64* %a, i64 27
+  %x27 = load i64, i64* %pa27
+  %pa28 = getelementptr inbounds i64, i64* %a, i64 28
+  %x28 = load i64, i64* %pa28
+  %pa29 = getelementptr inbounds i64, i64* %a, i64 29
+  %x29 = load i64, i64* %pa29
+  %pa30 = getelementptr inbounds i64, i64* %a, i64 30
+  %x30 = load i64, i64* %pa30
+  %pa31 = getelementptr inbounds i64, i64* %a, i64 31
+  %x31 = load i64, i64* %pa31
+  %pa32 = getelementptr inbounds i64, i64* %a, i64 32
+  %x32 = load i64, i64* %pa32
+  %pa33 = getelementptr inbounds i64, i64* %a, i64 33
+  %x33 = load i64, i64* %pa33
+  %pa34 = getelementptr inbounds i64, i64* %a, i64 34
+  %x34 = load i64, i64* %pa34
+  %pa35 = getelementptr inbounds i64, i64* %a, i64 35
+  %x35 = load i64, i64* %pa35
+  %pa36 = getelementptr inbounds i64, i64* %a, i64 36
+  %x36 = load i64, i64* %pa36
+  %pa37 = getelementptr inbounds i64, i64* %a, i64 37
+  %x37 = load i64, i64* %pa37
+  %pa38 = getelementptr inbounds i64, i64* %a, i64 38
+  %x38 = load i64, i64* %pa38
+  %pa39 = getelementptr inbounds i64, i64* %a, i64 39
+  %x39 = load i64, i64* %pa39
+  %pa40 = getelementptr inbounds i64, i64* %a, i64 40
+  %x40 = load i64, i64* %pa40
+  %pa41 = getelementptr inbounds i64, i64* %a, i64 41
+  %x41 = load i64, i64* %pa41
+  %pa42 = getelementptr inbounds i64, i64* %a, i64 42
+  %x42 = load i64, i64* %pa42
+  %pa43 = getelementptr inbounds i64, i64* %a, i64 43
+  %x43 = load i64, i64* %pa43
+  %pa44 = getelementptr inbounds i64, i64* %a, i64 44
+  %x44 = load i64, i64* %pa44
+  %pa45 = getelementptr inbounds i64, i64* %a, i64 45
+  %x45 = load i64, i64* %pa45
+  %pa46 = getelementptr inbounds i64, i64* %a, i64 46
+  %x46 = load i64, i64* %pa46
+  %pa47 = getelementptr inbounds i64, i64* %a, i64 47
+  %x47 = load i64, i64* %pa47
+  %pb0 = getelementptr inbounds i64, i64* %b, i64 0
+  store i64 %x0, i64* %pb0
+  %pb1 = getelementptr inbounds i64, i64* %b, i64 1
+  store i64 %x1, i64* %pb1
+  %pb2 = getelementptr inbounds i64, i64* %b, i64 2
+  store i64 %x2, i64* %pb2
+  %pb3 = getelementptr inbounds i64, i64* %b, i64 3
+  store i64 %x3, i64* %pb3
+  %pb4 = getelementptr inbounds i64, i64* %b, i64 4
+  store i64 %x4, i64* %pb4
+  %pb5 = getelementptr inbounds i64, i64* %b, i64 5
+  store i64 %x5, i64* %pb5
+  %pb6 = getelementptr inbounds i64, i64* %b, i64 6
+  store i64 %x6, i64* %pb6
+  %pb7 = getelementptr inbounds i64, i64* %b, i64 7
+  store i64 %x7, i64* %pb7
+  %pb8 = getelementptr inbounds i64, i64* %b, i64 8
+  store i64 %x8, i64* %pb8
+  %pb9 = getelementptr inbounds i64, i64* %b, i64 9
+  store i64 %x9, i64* %pb9
+  %pb10 = getelementptr inbounds i64, i64* %b, i64 10
+  store i64 %x10, i64* %pb10
+  %pb11 = getelementptr inbounds i64, i64* %b, i64 11
+  store i64 %x11, i64* %pb11
+  %pb12 = getelementptr inbounds i64, i64* %b, i64 12
+  store i64 %x12, i64* %pb12
+  %pb13 = getelementptr inbounds i64, i64* %b, i64 13
+  store i64 %x13, i64* %pb13
+  %pb14 = getelementptr inbounds i64, i64* %b, i64 14
+  store i64 %x14, i64* %pb14
+  %pb15 = getelementptr inbounds i64, i64* %b, i64 15
+  store i64 %x15, i64* %pb15
+  %pb16 = getelementptr inbounds i64, i64* %b, i64 16
+  store i64 %x16, i64* %pb16
+  %pb17 = getelementptr inbounds i64, i64* %b, i64 17
+  store i64 %x17, i64* %pb17
+  %pb18 = getelementptr inbounds i64, i64* %b, i64 18
+  store i64 %x18, i64* %pb18
+  %pb19 = getelementptr inbounds i64, i64* %b, i64 19
+  store i64 %x19, i64* %pb19
+  %pb20 = getelementptr inbounds i64, i64* %b, i64 20
+  store i64 %x20, i64* %pb20
+  %pb21 = getelementptr inbounds i64, i64* %b, i64 21
+  store i64 %x21, i64* %pb21
+  %pb22 = getelementptr inbounds i64, i64* %b, i64 22
+  store i64 %x22, i64* %pb22
+  %pb23 = getelementptr inbounds i64, i64* %b, i64 23
+  store i64 %x23, i64* %pb23
+  %pb24 = getelementptr inbounds i64, i64* %b, i64 24
+  store i64 %x24, i64* %pb24
+  %pb25 = getelementptr inbounds i64, i64* %b, i64 25
+  store i64 %x25, i64* %pb25
+  %pb26 = getelementptr inbounds i64, i64* %b, i64 26
+  store i64 %x26, i64* %pb26
+  %pb27 = getelementptr inbounds i64, i64* %b, i64 27
+  store i64 %x27, i64* %pb27
+  %pb28 = getelementptr inbounds i64, i64* %b, i64 28
+  store i64 %x28, i64* %pb28
+  %pb29 = getelementptr inbounds i64, i64* %b, i64 29
+  store i64 %x29, i64* %pb29
+  %pb30 = getelementptr inbounds i64, i64* %b, i64 30
+  store i64 %x30, i64* %pb30
+  %pb31 = getelementptr inbounds i64, i64* %b, i64 31
+  store i64 %x31, i64* %pb31
+  %pb32 = getelementptr inbounds i64, i64* %b, i64 32
+  store i64 %x32, i64* %pb32
+  %pb33 = getelementptr inbounds i64, i64* %b, i64 33
+  store i64 %x33, i64* %pb33
+  %pb34 = getelementptr inbounds i64, i64* %b, i64 34
+  store i64 %x34, i64* %pb34
+  %pb35 = getelementptr inbounds i64, i64* %b, i64 35
+  store i64 %x35, i64* %pb35
+  %pb36 = getelementptr inbounds i64, i64* %b, i64 36
+  store i64 %x36, i64* %pb36
+  %pb37 = getelementptr inbounds i64, i64* %b, i64 37
+  store i64 %x37, i64* %pb37
+  %pb38 = getelementptr inbounds i64, i64* %b, i64 38
+  store i64 %x38, i64* %pb38
+  %pb39 = getelementptr inbounds i64, i64* %b, i64 39
+  store i64 %x39, i64* %pb39
+  %pb40 = getelementptr inbounds i64, i64* %b, i64 40
+  store i64 %x40, i64* %pb40
+  %pb41 = getelementptr inbounds i64, i64* %b, i64 41
+  store i64 %x41, i64* %pb41
+  %pb42 = getelementptr inbounds i64, i64* %b, i64 42
+  store i64 %x42, i64* %pb42
+  %pb43 = getelementptr inbounds i64, i64* %b, i64 43
+  store i64 %x43, i64* %pb43
+  %pb44 = getelementptr inbounds i64, i64* %b, i64 44
+  store i64 %x44, i64* %pb44
+  %pb45 = getelementptr inbounds i64, i64* %b, i64 45
+  store i64 %x45, i64* %pb45
+  %pb46 = getelementptr inbounds i64, i64* %b, i64 46
+  store i64 %x46, i64* %pb46
+  %pb47 = getelementptr inbounds i64, i64* %b, i64 47
+  store i64 %x47, i64* %pb47
+  ret void
+}
+
+define void @fits(i64* noalias %a, i64* noalias %b) {
+entry:
+  %pa0 = getelementptr inbounds i64, i64* %a, i64 0
+  %x0 = load i64, i64* %pa0
+  %pa1 = getelementptr inbounds i64, i64* %a, i64 1
+  %x1 = load i64, i64* %pa1
+  %pa2 = getelementptr inbounds i64, i64* %a, i64 2
+  %x2 = load i64, i64* %pa2
+  %pa3 = getelementptr inbounds i64, i64* %a, i64 3
+  %x3 = load i64, i64* %pa3
+  %pa4 = getelementptr inbounds i64, i64* %a, i64 4
+  %x4 = load i64, i64* %pa4
+  %pa5 = getelementptr inbounds i64, i64* %a, i64 5
+  %x5 = load i64, i64* %pa5
+  %pa6 = getelementptr inbounds i64, i64* %a, i64 6
+  %x6 = load i64, i64* %pa6
+  %pa7 = getelementptr inbounds i64, i64* %a, i64 7
+  %x7 = load i64, i64* %pa7
+  %pa8 = getelementptr inbounds i64, i64* %a, i64 8
+  %x8 = load i64, i64* %pa8
+  %pa9 = getelementptr inbounds i64, i64* %a, i64 9
+  %x9 = load i64, i64* %pa9
+  %pa10 = getelementptr inbounds i64, i64* %a, i64 10
+  %x10 = load i64, i64* %pa10
+  %pa11 = getelementptr inbounds i64, i64* %a, i64 11
+  %x11 = load i64, i64* %pa11
+  %pa12 = getelementptr inbounds i64, i64* %a, i64 12
+  %x12 = load i64, i64* %pa12
+  %pa13 = getelementptr inbounds i64, i64* %a, i64 13
+  %x13 = load i64, i64* %pa13
+  %pa14 = getelementptr inbounds i64, i64* %a, i64 14
+  %x14 = load i64, i64* %pa14
+  %pa15 = getelementptr inbounds i64, i64* %a, i64 15
+  %x15 = load i64, i64* %pa15
+  %pa16 = getelementptr inbounds i64, i64* %a, i64 16
+  %x16 = load i64, i64* %pa16
+  %pa17 = getelementptr inbounds i64, i64* %a, i64 17
+  %x17 = load i64, i64* %pa17
+  %pa18 = getelementptr inbounds i64, i64* %a, i64 18
+  %x18 = load i64, i64* %pa18
+  %pa19 = getelementptr inbounds i64, i64* %a, i64 19
+  %x19 = load i64, i64* %pa19
+  %pa20 = getelementptr inbounds i64, i64* %a, i64 20
+  %x20 = load i64, i64* %pa20
+  %pa21 = getelementptr inbounds i64, i64* %a, i64 21
+  %x21 = load i64, i64* %pa21
+  %pa22 = getelementptr inbounds i64, i64* %a, i64 22
+  %x22 = load i64, i64* %pa22
+  %pa23 = getelementptr inbounds i64, i64* %a, i64 23
+  %x23 = load i64, i64* %pa23
+  %pa24 = getelementptr inbounds i64, i64* %a, i64 24
+  %x24 = load i64, i64* %pa24
+  %pa25 = getelementptr inbounds i64, i64* %a, i64 25
+  %x25 = load i64, i64* %pa25
+  %pa26 = getelementptr inbounds i64, i64* %a, i64 26
+  %x26 = load i64, i64* %pa26
+  %pa27 = getelementptr inbounds i64, i64* %a, i64 27
+  %x27 = load i64, i64* %pa27
+  %pa28 = getelementptr inbounds i64, i64* %a, i64 28
+  %x28 = load i64, i64* %pa28
+  %pa29 = getelementptr inbounds i64, i64* %a, i64 29
+  %x29 = load i64, i64* %pa29
+  %pa30 = getelementptr inbounds i64, i64* %a, i64 30
+  %x30 = load i64, i64* %pa30
+  %pa31 = getelementptr inbounds i64, i64* %a, i64 31
+  %x31 = load i64, i64* %pa31
+  %pb0 = getelementptr inbounds i64, i64* %b, i64 0
+  store i64 %x0, i64* %pb0
+  %pb1 = getelementptr inbounds i64, i64* %b, i64 1
+  store i64 %x1, i64* %pb1
+  %pb2 = getelementptr inbounds i64, i64* %b, i64 2
+  store i64 %x2, i64* %pb2
+  %pb3 = getelementptr inbounds i64, i64* %b, i64 3
+  store i64 %x3, i64* %pb3
+  %pb4 = getelementptr inbounds i64, i64* %b, i64 4
+  store i64 %x4, i64* %pb4
+  %pb5 = getelementptr inbounds i64, i64* %b, i64 5
+  store i64 %x5, i64* %pb5
+  %pb6 = getelementptr inbounds i64, i64* %b, i64 6
+  store i64 %x6, i64* %pb6
+  %pb7 = getelementptr inbounds i64, i64* %b, i64 7
+  store i64 %x7, i64* %pb7
+  %pb8 = getelementptr inbounds i64, i64* %b, i64 8
+  store i64 %x8, i64* %pb8
+  %pb9 = getelementptr inbounds i64, i64* %b, i64 9
+  store i64 %x9, i64* %pb9
+  %pb10 = getelementptr inbounds i64, i64* %b, i64 10
+  store i64 %x10, i64* %pb10
+  %pb11 = getelementptr inbounds i64, i64* %b, i64 11
+  store i64 %x11, i64* %pb11
+  %pb12 = getelementptr inbounds i64, i64* %b, i64 12
+  store i64 %x12, i64* %pb12
+  %pb13 = getelementptr inbounds i64, i64* %b, i64 13
+  store i64 %x13, i64* %pb13
+  %pb14 = getelementptr inbounds i64, i64* %b, i64 14
+  store i64 %x14, i64* %pb14
+  %pb15 = getelementptr inbounds i64, i64* %b, i64 15
+  store i64 %x15, i64* %pb15
+  %pb16 = getelementptr inbounds i64, i64* %b, i64 16
+  store i64 %x16, i64* %pb16
+  %pb17 = getelementptr inbounds i64, i64* %b, i64 17
+  store i64 %x17, i64* %pb17
+  %pb18 = getelementptr inbounds i64, i64* %b, i64 18
+  store i64 %x18, i64* %pb18
+  %pb19 = getelementptr inbounds i64, i64* %b, i64 19
+  store i64 %x19, i64* %pb19
+  %pb20 = getelementptr inbounds i64, i64* %b, i64 20
+  store i64 %x20, i64* %pb20
+  %pb21 = getelementptr inbounds i64, i64* %b, i64 21
+  store i64 %x21, i64* %pb21
+  %pb22 = getelementptr inbounds i64, i64* %b, i64 22
+  store i64 %x22, i64* %pb22
+  %pb23 = getelementptr inbounds i64, i64* %b, i64 23
+  store i64 %x23, i64* %pb23
+  %pb24 = getelementptr inbounds i64, i64* %b, i64 24
+  store i64 %x24, i64* %pb24
+  %pb25 = getelementptr inbounds i64, i64* %b, i64 25
+  store i64 %x25, i64* %pb25
+  %pb26 = getelementptr inbounds i64, i64* %b, i64 26
+  store i64 %x26, i64* %pb26
+  %pb27 = getelementptr inbounds i64, i64* %b, i64 27
+  store i64 %x27, i64* %pb27
+  %pb28 = getelementptr inbounds i64, i64* %b, i64 28
+  store i64 %x28, i64* %pb28
+  %pb29 = getelementptr inbounds i64, i64* %b, i64 29
+  store i64 %x29, i64* %pb29
+  %pb30 = getelementptr inbounds i64, i64* %b, i64 30
+  store i64 %x30, i64* %pb30
+  %pb31 = getelementptr inbounds i64, i64* %b, i64 31
+  store i64 %x31, i64* %pb31
+  ret void
+}
@@ -0,0 +1,91 @@
+; Every candidate pack is priced while all candidates count as vectors, so
+; the fadds are priced as taking their operands from the load packs. The
+; loads cannot be placed, since each lane's address is computed between the
+; lanes, and without them the fadds would have to build both operand vectors
+; lane by lane. They are priced again when they would be committed, and left
+; scalar.
+; RUN: %svopt -passes=super-vectorization -mattr=+avx2 -pass-remarks=super-vectorization -pass-remarks-missed=super-vectorization %s -S -o %t.ll 2> %t.remarks
+; RUN: FileCheck %s < %t.ll
+; RUN: FileCheck %s --check-prefix=REMARK < %t.remarks
+
+; REMARK-NOT: packed 4 x fadd
+; REMARK: not packed: 4 x fadd under true: saves no more than the cost threshold of 0 without the packs dropped before it
+; REMARK-NOT: packed 4 x fadd
+
+; CHECK-LABEL: define void @f(
+; CHECK-NOT: fadd <4 x float>
+; CHECK: store <4 x float>
+; CHECK-NOT: fadd <4 x float>
+; CHECK: ret void
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+define void @f(float* %a, float* %b, float* %c) {
+entry:
+  %pa0 = getelementptr inbounds float, float* %a, i64 0
+  %la0 = load float, float* %pa0, !alias.scope !3, !noalias !6
+  %pb0 = getelementptr inbounds float, float* %b, i64 0
+  %lb0 = load float, float* %pb0, !alias.scope !4, !noalias !6
+  %s0 = fadd float %la0, %lb0
+  %pc0 = getelementptr inbounds float, float* %c, i64 0
+  store float %s0, float* %pc0, !alias.scope !5, !noalias !7
+  %pa1 = getelementptr inbounds float, float* %a, i64 1
+  %la1 = load float, float* %pa1, !alias.scope !3, !noalias !6
+  %pb1 = getelementptr inbounds float, float* %b, i64 1
+  %lb1 = load float, float* %pb1, !alias.scope !4, !noalias !6
+  %s1 = fadd float %la1, %lb1
+  %pc1 = getelementptr inbounds float, float* %c, i64 1
+  store float %s1, float* %pc1, !alias.scope !5, !noalias !7
+  %pa2 = getelementptr inbounds float, float* %a, i64 2
+  %la2 = load float, float* %pa2, !alias.scope !3, !noalias !6
+  %pb2 = getelementptr inbounds float, float* %b, i64 2
+  %lb2 = load float, float* %pb2, !alias.scope !4, !noalias !6
+  %s2 = fadd float %la2, %lb2
+  %pc2 = getelementptr inbounds float, float* %c, i64 2
+  store float %s2, float* %pc2, !alias.scope !5, !noalias !7
+  %pa3 = getelementptr inbounds float, float* %a, i64 3
+  %la3 = load float, float* %pa3, !alias.scope !3, !noalias !6
+  %pb3 = getelementptr inbounds float, float* %b, i64 3
+  %lb3 = load float, float* %pb3, !alias.scope !4, !noalias !6
+  %s3 = fadd float %la3, %lb3
+  %pc3 = getelementptr inbounds float, float* %c, i64 3
+  store float %s3, float* %pc3, !alias.scope !5, !noalias !7
+  %pa4 = getelementptr inbounds float, float* %a, i64 4
+  %la4 = load float, float* %pa4, !alias.scope !3, !noalias !6
+  %pb4 = getelementptr inbounds float, float* %b, i64 4
+  %lb4 = load float, float* %pb4, !alias.scope !4, !noalias !6
+  %s4 = fadd float %la4, %lb4
+  %pc4 = getelementptr inbounds float, float* %c, i64 4
+  store float %s4, float* %pc4, !alias.scope !5, !noalias !7
+  %pa5 = getelementptr inbounds float, float* %a, i64 5
+  %la5 = load float, float* %pa5, !alias.scope !3, !noalias !6
+  %pb5 = getelementptr inbounds float, float* %b, i64 5
+  %lb5 = load float, float* %pb5, !alias.scope !4, !noalias !6
+  %s5 = fadd float %la5, %lb5
+  %pc5 = getelementptr inbounds float, float* %c, i64 5
+  store float %s5, float* %pc5, !alias.scope !5, !noalias !7
+  %pa6 = getelementptr inbounds float, float* %a, i64 6
+  %la6 = load float, float* %pa6, !alias.scope !3, !noalias !6
+  %pb6 = getelementptr inbounds float, float* %b, i64 6
+  %lb6 = load float, float* %pb6, !alias.scope !4, !noalias !6
+  %s6 = fadd float %la6, %lb6
+  %pc6 = getelementptr inbounds float, float* %c, i64 6
+  store float %s6, float* %pc6, !alias.scope !5, !noalias !7
+  %pa7 = getelementptr inbounds float, float* %a, i64 7
+  %la7 = load float, float* %pa7, !alias.scope !3, !noalias !6
+  %pb7 = getelementptr inbounds float, float* %b, i64 7
+  %lb7 = load float, float* %pb7, !alias.scope !4, !noalias !6
+  %s7 = fadd float %la7, %lb7
+  %pc7 = getelementptr inbounds float, float* %c, i64 7
+  store float %s7, float* %pc7, !alias.scope !5, !noalias !7
+  ret void
+}
+!0 = distinct !{!0, !"d"}
+!1 = distinct !{!1, !0, !"a"}
+!2 = distinct !{!2, !0, !"b"}
+!8 = distinct !{!8, !0, !"c"}
+!3 = !{!1}
+!4 = !{!2}
+!5 = !{!8}
+!6 = !{!8}
+!7 = !{!1, !2}
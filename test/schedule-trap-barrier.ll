@@ -0,0 +1,48 @@
+; The scheduler clusters items under equal predicates, but a division that
+; may trap must not be hoisted above a call that may not return: here the
+; call exits the program before the division by zero.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define i32 @f(
+; CHECK: call void @may_exit(
+; CHECK: sdiv i32
+
+declare void @exit(i32)
+
+define void @may_exit(i32 %y) {
+entry:
+  %zero = icmp eq i32 %y, 0
+  br i1 %zero, label %quit, label %back
+quit:
+  call void @exit(i32 0)
+  unreachable
+back:
+  ret void
+}
+
+define i32 @f(i32 %x, i32 %y, i1 %c) {
+entry:
+  br i1 %c, label %then1, label %mid
+then1:
+  %a = add i32 %x, 1
+  br label %mid
+mid:
+  %pa = phi i32 [ %a, %then1 ], [ 0, %entry ]
+  call void @may_exit(i32 %y)
+  br i1 %c, label %then2, label %end
+then2:
+  %d = sdiv i32 %x, %y
+  br label %end
+end:
+  %pd = phi i32 [ %d, %then2 ], [ 0, %mid ]
+  %r = add i32 %pa, %pd
+  ret i32 %r
+}
+
+define i32 @main() {
+entry:
+  %r = call i32 @f(i32 5, i32 0, i1 true)
+  ret i32 1
+}
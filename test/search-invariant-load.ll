@@ -0,0 +1,73 @@
+; A search loop runs every lane of a vector iteration, also those past the
+; lane that leaves early. An invariant load behind the early exit therefore
+; runs even when the scalar loop would leave before reaching it, and may only
+; be folded when its address is known to be dereferenceable. @find, called
+; with a null %q that it never reads, stays scalar; @findg, which reads a
+; global, is folded.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define i32 @find(
+; CHECK-NOT: <4 x i32>
+; CHECK-LABEL: define i32 @findg(
+; CHECK: load i32, i32* @Bias
+; CHECK: add <4 x i32>
+; CHECK-LABEL: define i32 @main(
+
+
+@A = global [64 x i32] zeroinitializer
+@Bias = global i32 7
+
+define i32 @find(i32 %key, i32* %q) {
+entry:
+  br label %body
+body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [64 x i32], [64 x i32]* @A, i64 0, i64 %i
+  %x = load i32, i32* %p, align 4
+  %hit = icmp eq i32 %x, %key
+  br i1 %hit, label %out, label %latch
+latch:
+  %bias = load i32, i32* %q, align 4
+  %s = add i32 %x, %bias
+  %i.next = add nuw nsw i64 %i, 1
+  %more = icmp ult i64 %i.next, 61
+  br i1 %more, label %body, label %out
+out:
+  %r = phi i32 [ -1, %body ], [ %s, %latch ]
+  ret i32 %r
+}
+
+define i32 @findg(i32 %key) {
+entry:
+  br label %body
+body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [64 x i32], [64 x i32]* @A, i64 0, i64 %i
+  %x = load i32, i32* %p, align 4
+  %hit = icmp eq i32 %x, %key
+  br i1 %hit, label %out, label %latch
+latch:
+  %bias = load i32, i32* @Bias, align 4
+  %s = add i32 %x, %bias
+  %i.next = add nuw nsw i64 %i, 1
+  %more = icmp ult i64 %i.next, 61
+  br i1 %more, label %body, label %out
+out:
+  %r = phi i32 [ -1, %body ], [ %s, %latch ]
+  ret i32 %r
+}
+
+define i32 @main() {
+entry:
+  %a = call i32 @find(i32 0, i32* null)
+  %b = call i32 @findg(i32 0)
+  %c = call i32 @findg(i32 1)
+  %ab = add i32 %a, %b
+  %abc = add i32 %ab, %c
+  ; -1 - 1 + 7
+  %bad = icmp ne i32 %abc, 5
+  %ret = zext i1 %bad to i32
+  ret i32 %ret
+}
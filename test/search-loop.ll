@@ -0,0 +1,110 @@
+; A search loop leaves early in the first iteration whose key matches. The
+; folded loop tests a whole vector of lanes at once, leaves once any active
+; lane matches, and takes its live-out values from the first matching lane.
+; The keys exercise a match in the first lane, in later vector iterations,
+; in the masked tail and no match at all.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define i32 @find(
+; CHECK: call <4 x i1> @llvm.get.active.lane.mask.v4i1.i64(i64 %{{.*}}, i64 61)
+; CHECK: icmp eq <4 x i32>
+; CHECK: call i1 @llvm.vector.reduce.or.v4i1(
+; CHECK: call i4 @llvm.cttz.i4(
+; CHECK-LABEL: define i32* @findp(
+; CHECK: icmp sgt <4 x i32>
+; CHECK: call i1 @llvm.vector.reduce.or.v4i1(
+; CHECK: call i4 @llvm.cttz.i4(
+; CHECK-LABEL: define i32 @main(
+
+@A = global [64 x i32] zeroinitializer
+
+define i32 @find(i32 %key) {
+entry:
+  br label %body
+body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [64 x i32], [64 x i32]* @A, i64 0, i64 %i
+  %x = load i32, i32* %p, align 4
+  %hit = icmp eq i32 %x, %key
+  br i1 %hit, label %out, label %latch
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %more = icmp ult i64 %i.next, 61
+  br i1 %more, label %body, label %out
+out:
+  %r = phi i64 [ %i, %body ], [ -1, %latch ]
+  %r32 = trunc i64 %r to i32
+  ret i32 %r32
+}
+
+define i32* @findp(i32 %key) {
+entry:
+  br label %body
+body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr inbounds [64 x i32], [64 x i32]* @A, i64 0, i64 %i
+  %x = load i32, i32* %p, align 4
+  %hit = icmp sgt i32 %x, %key
+  br i1 %hit, label %latch, label %found
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %more = icmp ult i64 %i.next, 64
+  br i1 %more, label %body, label %none
+found:
+  %fp = phi i32* [ %p, %body ]
+  ret i32* %fp
+none:
+  %last = phi i64 [ %i.next, %latch ]
+  %lp = getelementptr inbounds [64 x i32], [64 x i32]* @A, i64 0, i64 %last
+  ret i32* %lp
+}
+
+define i32 @main() {
+entry:
+  br label %init
+init:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %init ]
+  %pp = getelementptr [64 x i32], [64 x i32]* @A, i64 0, i64 %j
+  %jt = trunc i64 %j to i32
+  %v = mul i32 %jt, 3
+  store i32 %v, i32* %pp
+  %j.next = add i64 %j, 1
+  %ci = icmp ult i64 %j.next, 64
+  br i1 %ci, label %init, label %run
+run:
+  %a = call i32 @find(i32 0)
+  %b = call i32 @find(i32 21)
+  %c = call i32 @find(i32 22)
+  %d = call i32 @find(i32 180)
+  %e = call i32 @find(i32 183)
+  %f = call i32* @findp(i32 -1)
+  %g = call i32* @findp(i32 100)
+  %h = call i32* @findp(i32 1000)
+  %base = getelementptr [64 x i32], [64 x i32]* @A, i64 0, i64 0
+  %fi = ptrtoint i32* %f to i64
+  %gi = ptrtoint i32* %g to i64
+  %hi = ptrtoint i32* %h to i64
+  %bi = ptrtoint i32* %base to i64
+  %fo = sub i64 %fi, %bi
+  %go = sub i64 %gi, %bi
+  %ho = sub i64 %hi, %bi
+  %s1 = add i32 %a, %b
+  %s2 = mul i32 %s1, 7
+  %s3 = add i32 %s2, %c
+  %s4 = mul i32 %s3, 7
+  %s5 = add i32 %s4, %d
+  %s6 = mul i32 %s5, 7
+  %s7 = add i32 %s6, %e
+  %o1 = add i64 %fo, %go
+  %o2 = mul i64 %o1, 5
+  %o3 = add i64 %o2, %ho
+  %o4 = trunc i64 %o3 to i32
+  %s8 = mul i32 %s7, 11
+  %s9 = add i32 %s8, %o4
+  %rm = urem i32 %s9, 251
+  %bad = icmp ne i32 %rm, 135
+  %ret = zext i1 %bad to i32
+  ret i32 %ret
+}
@@ -0,0 +1,112 @@
+; Small pure callees get SIMD clones, so that isomorphic calls to them pack
+; into one vector call. A clone call is priced by its widened body against
+; the scalar body run once per lane. @_ZGV_LLVM_N2v_blend is a user function
+; that merely has the name of a clone: calls of @blend must not be mapped to
+; it, and it must survive although nothing calls it.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define internal void @kernel(
+; CHECK: call <4 x i32> @_ZGV_LLVM_N4vv_scale(<4 x i32>
+; CHECK: call float @blend(
+; CHECK: call float @blend(
+; CHECK-LABEL: define <2 x float> @_ZGV_LLVM_N2v_blend(
+; CHECK: ret <2 x float> zeroinitializer
+; CHECK: define internal <4 x i32> @_ZGV_LLVM_N4vv_scale(
+; CHECK-NOT: define {{.*}}@_ZGV_LLVM_N4v_blend(
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define internal i32 @scale(i32 %x, i32 %k) noinline {
+  %y = mul nsw i32 %x, 8
+  %z = add i32 %y, %k
+  %c = icmp slt i32 %z, 100
+  %r = select i1 %c, i32 %z, i32 100
+  ret i32 %r
+}
+
+define internal float @blend(float %a) noinline {
+  %m = fmul float %a, 0.5
+  %n = fneg float %m
+  %f = fptosi float %n to i32
+  %g = sitofp i32 %f to float
+  ret float %g
+}
+
+define internal void @kernel(i32* noalias %in, i32* noalias %out, float* noalias %fo) noinline {
+  %p0 = getelementptr i32, i32* %in, i64 0
+  %p1 = getelementptr i32, i32* %in, i64 1
+  %p2 = getelementptr i32, i32* %in, i64 2
+  %p3 = getelementptr i32, i32* %in, i64 3
+  %a0 = load i32, i32* %p0
+  %a1 = load i32, i32* %p1
+  %a2 = load i32, i32* %p2
+  %a3 = load i32, i32* %p3
+  %r0 = call i32 @scale(i32 %a0, i32 1)
+  %r1 = call i32 @scale(i32 %a1, i32 2)
+  %r2 = call i32 @scale(i32 %a2, i32 3)
+  %r3 = call i32 @scale(i32 %a3, i32 4)
+  %q0 = getelementptr i32, i32* %out, i64 0
+  %q1 = getelementptr i32, i32* %out, i64 1
+  %q2 = getelementptr i32, i32* %out, i64 2
+  %q3 = getelementptr i32, i32* %out, i64 3
+  store i32 %r0, i32* %q0
+  store i32 %r1, i32* %q1
+  store i32 %r2, i32* %q2
+  store i32 %r3, i32* %q3
+  %f0 = sitofp i32 %a0 to float
+  %f1 = sitofp i32 %a1 to float
+  %b0 = call float @blend(float %f0)
+  %b1 = call float @blend(float %f1)
+  %o0 = getelementptr float, float* %fo, i64 0
+  %o1 = getelementptr float, float* %fo, i64 1
+  store float %b0, float* %o0
+  store float %b1, float* %o1
+  ret void
+}
+
+define <2 x float> @_ZGV_LLVM_N2v_blend(<2 x float> %a) {
+  ret <2 x float> zeroinitializer
+}
+
+define i32 @main() {
+  %in = alloca [4 x i32]
+  %out = alloca [4 x i32]
+  %fo = alloca [2 x float]
+  %i = getelementptr [4 x i32], [4 x i32]* %in, i64 0, i64 0
+  %o = getelementptr [4 x i32], [4 x i32]* %out, i64 0, i64 0
+  %f = getelementptr [2 x float], [2 x float]* %fo, i64 0, i64 0
+  %i1 = getelementptr i32, i32* %i, i64 1
+  %i2 = getelementptr i32, i32* %i, i64 2
+  %i3 = getelementptr i32, i32* %i, i64 3
+  store i32 3, i32* %i
+  store i32 7, i32* %i1
+  store i32 20, i32* %i2
+  store i32 -5, i32* %i3
+  call void @kernel(i32* %i, i32* %o, float* %f)
+  %o1 = getelementptr i32, i32* %o, i64 1
+  %o2 = getelementptr i32, i32* %o, i64 2
+  %o3 = getelementptr i32, i32* %o, i64 3
+  %v0 = load i32, i32* %o
+  %v1 = load i32, i32* %o1
+  %v2 = load i32, i32* %o2
+  %v3 = load i32, i32* %o3
+  %f1 = getelementptr float, float* %f, i64 1
+  %w0 = load float, float* %f
+  %w1 = load float, float* %f1
+  %x0 = fptosi float %w0 to i32
+  %x1 = fptosi float %w1 to i32
+  %s1 = add i32 %v0, %v1
+  %s2 = add i32 %s1, %v2
+  %s3 = add i32 %s2, %v3
+  %s4 = mul i32 %s3, 3
+  %s5 = add i32 %s4, %x0
+  %s6 = mul i32 %x1, 5
+  %s7 = add i32 %s5, %s6
+  %r = and i32 %s7, 255
+  %bad = icmp ne i32 %r, 169
+  %ret = zext i1 %bad to i32
+  ret i32 %ret
+}
@@ -0,0 +1,55 @@
+; Stores are chained by base and constant offset over the whole scope, not
+; by position: a[0..3] and b[0..3] are written in scrambled order and
+; interleaved with each other, and still become one store pack each, with
+; the lanes in offset order. Instructions are numbered in order, so the
+; stores to b are i12 i24 i30 i18 and those to a are i15 i27 i9 i21.
+; RUN: %svopt -passes=super-vectorization -sv-dump-predicated-ssa=%t.pssa %s -S -o %t.ll
+; RUN: %sv-ssa -pack %t.pssa | FileCheck %s
+; RUN: FileCheck %s --check-prefix=IR < %t.ll
+
+; CHECK-LABEL: function @f
+; CHECK-NEXT: pack load %x0 %x1 %x2 %x3 contiguous
+; CHECK-NEXT: pack store i12 i24 i30 i18 contiguous
+; CHECK-NEXT: pack store i15 i27 i9 i21 contiguous
+; CHECK-NOT: pack
+
+; IR-LABEL: define void @f(
+; IR: store <4 x i32>
+; IR: store <4 x i32>
+; IR-NOT: store i32
+
+define void @f(i32* noalias %a, i32* noalias %b, i32* noalias %x) {
+entry:
+  %x0 = load i32, i32* %x
+  %px1 = getelementptr inbounds i32, i32* %x, i64 1
+  %x1 = load i32, i32* %px1
+  %px2 = getelementptr inbounds i32, i32* %x, i64 2
+  %x2 = load i32, i32* %px2
+  %px3 = getelementptr inbounds i32, i32* %x, i64 3
+  %x3 = load i32, i32* %px3
+  %pa2 = getelementptr inbounds i32, i32* %a, i64 2
+  %a2 = add i32 %x2, 1
+  store i32 %a2, i32* %pa2
+  %pb0 = getelementptr inbounds i32, i32* %b, i64 0
+  %b0 = mul i32 %x0, 3
+  store i32 %b0, i32* %pb0
+  %pa0 = getelementptr inbounds i32, i32* %a, i64 0
+  %a0 = add i32 %x0, 1
+  store i32 %a0, i32* %pa0
+  %pb3 = getelementptr inbounds i32, i32* %b, i64 3
+  %b3 = mul i32 %x3, 3
+  store i32 %b3, i32* %pb3
+  %pa3 = getelementptr inbounds i32, i32* %a, i64 3
+  %a3 = add i32 %x3, 1
+  store i32 %a3, i32* %pa3
+  %pb1 = getelementptr inbounds i32, i32* %b, i64 1
+  %b1 = mul i32 %x1, 3
+  store i32 %b1, i32* %pb1
+  %pa1 = getelementptr inbounds i32, i32* %a, i64 1
+  %a1 = add i32 %x1, 1
+  store i32 %a1, i32* %pa1
+  %pb2 = getelementptr inbounds i32, i32* %b, i64 2
+  %b2 = mul i32 %x2, 3
+  store i32 %b2, i32* %pb2
+  ret void
+}
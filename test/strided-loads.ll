@@ -0,0 +1,95 @@
+; Loads of every second or third element, with the elements between them
+; never read, are packed as one wide load whose lanes are picked out with a
+; shufflevector. Both results are run with lli.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define void @stride2(
+; CHECK: [[W2:%.*]] = load <8 x i32>
+; CHECK-NEXT: [[X2:%.*]] = shufflevector <8 x i32> [[W2]], <8 x i32> poison, <4 x i32> <i32 0, i32 2, i32 4, i32 6>
+; CHECK-NEXT: [[Y2:%.*]] = mul <4 x i32> [[X2]], <i32 10, i32 10, i32 10, i32 10>
+; CHECK: store <4 x i32> [[Y2]]
+; CHECK-NOT: load i32
+
+; CHECK-LABEL: define void @stride3(
+; CHECK: [[W3:%.*]] = load <12 x i32>
+; CHECK-NEXT: [[X3:%.*]] = shufflevector <12 x i32> [[W3]], <12 x i32> poison, <4 x i32> <i32 0, i32 3, i32 6, i32 9>
+; CHECK-NEXT: [[Y3:%.*]] = mul <4 x i32> [[X3]], <i32 10, i32 10, i32 10, i32 10>
+; CHECK: store <4 x i32> [[Y3]]
+; CHECK-NOT: load i32
+; CHECK: ret void
+
+@a = global [12 x i32] [i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, i32 10, i32 11, i32 12]
+@c = global [4 x i32] zeroinitializer
+@d = global [4 x i32] zeroinitializer
+
+; c[i] = a[2 * i] * 10
+define void @stride2() {
+entry:
+  %p0 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 0
+  %p1 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 2
+  %p2 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 4
+  %p3 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 6
+  %x0 = load i32, i32* %p0
+  %x1 = load i32, i32* %p1
+  %x2 = load i32, i32* %p2
+  %x3 = load i32, i32* %p3
+  %y0 = mul i32 %x0, 10
+  %y1 = mul i32 %x1, 10
+  %y2 = mul i32 %x2, 10
+  %y3 = mul i32 %x3, 10
+  %q0 = getelementptr inbounds [4 x i32], [4 x i32]* @c, i64 0, i64 0
+  %q1 = getelementptr inbounds [4 x i32], [4 x i32]* @c, i64 0, i64 1
+  %q2 = getelementptr inbounds [4 x i32], [4 x i32]* @c, i64 0, i64 2
+  %q3 = getelementptr inbounds [4 x i32], [4 x i32]* @c, i64 0, i64 3
+  store i32 %y0, i32* %q0
+  store i32 %y1, i32* %q1
+  store i32 %y2, i32* %q2
+  store i32 %y3, i32* %q3
+  ret void
+}
+
+; d[i] = a[3 * i] * 10
+define void @stride3() {
+entry:
+  %p0 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 0
+  %p1 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 3
+  %p2 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 6
+  %p3 = getelementptr inbounds [12 x i32], [12 x i32]* @a, i64 0, i64 9
+  %x0 = load i32, i32* %p0
+  %x1 = load i32, i32* %p1
+  %x2 = load i32, i32* %p2
+  %x3 = load i32, i32* %p3
+  %y0 = mul i32 %x0, 10
+  %y1 = mul i32 %x1, 10
+  %y2 = mul i32 %x2, 10
+  %y3 = mul i32 %x3, 10
+  %q0 = getelementptr inbounds [4 x i32], [4 x i32]* @d, i64 0, i64 0
+  %q1 = getelementptr inbounds [4 x i32], [4 x i32]* @d, i64 0, i64 1
+  %q2 = getelementptr inbounds [4 x i32], [4 x i32]* @d, i64 0, i64 2
+  %q3 = getelementptr inbounds [4 x i32], [4 x i32]* @d, i64 0, i64 3
+  store i32 %y0, i32* %q0
+  store i32 %y1, i32* %q1
+  store i32 %y2, i32* %q2
+  store i32 %y3, i32* %q3
+  ret void
+}
+
+; Returns 0 if c is {10, 30, 50, 70} and d is {10, 40, 70, 100}.
+define i32 @main() {
+entry:
+  call void @stride2()
+  call void @stride3()
+  %pc = bitcast [4 x i32]* @c to <4 x i32>*
+  %c = load <4 x i32>, <4 x i32>* %pc
+  %pd = bitcast [4 x i32]* @d to <4 x i32>*
+  %d = load <4 x i32>, <4 x i32>* %pd
+  %okc = icmp eq <4 x i32> %c, <i32 10, i32 30, i32 50, i32 70>
+  %okd = icmp eq <4 x i32> %d, <i32 10, i32 40, i32 70, i32 100>
+  %ok = and <4 x i1> %okc, %okd
+  %bits = bitcast <4 x i1> %ok to i4
+  %all = icmp eq i4 %bits, -1
+  %r = select i1 %all, i32 0, i32 1
+  ret i32 %r
+}
@@ -0,0 +1,89 @@
+; A loop with an unknown trip count is folded into a single vector loop whose
+; lanes past the trip count are masked off, with no scalar remainder. The
+; invariant load of @K is broadcast once per vector iteration. The folded
+; loop must compute what the scalar one does for trip counts below, at and
+; above the vector width.
+; RUN: %svopt -passes=super-vectorization %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define void @k(
+; CHECK: call <4 x i1> @llvm.get.active.lane.mask.v4i1.i64(
+; CHECK: call <4 x float> @llvm.masked.load.v4f32.p0v4f32(
+; CHECK: call void @llvm.masked.store.v4f32.p0v4f32(
+; CHECK: call void @llvm.masked.store.v4i32.p0v4i32(
+; CHECK-LABEL: define i32 @main(
+
+@A = global [64 x float] zeroinitializer
+@B = global [64 x float] zeroinitializer
+@C = global [64 x i32] zeroinitializer
+@K = global float 3.0
+
+define void @k(float* %a, float* %b, i32* %c, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds float, float* %a, i64 %i
+  %pb = getelementptr inbounds float, float* %b, i64 %i
+  %pc = getelementptr inbounds i32, i32* %c, i64 %i
+  %x = load float, float* %pa
+  %y = load float, float* %pb
+  %k = load float, float* @K
+  %m = fmul float %x, %k
+  %s = fadd float %m, %y
+  store float %s, float* %pb
+  %it = trunc i64 %i to i32
+  %sq = mul i32 %it, %it
+  %gt = icmp sgt i32 %sq, 20
+  %v = select i1 %gt, i32 %sq, i32 7
+  store i32 %v, i32* %pc
+  %i.next = add nuw i64 %i, 1
+  %cnd = icmp ult i64 %i.next, %n
+  br i1 %cnd, label %loop, label %exit
+exit:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  br label %init
+init:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %init ]
+  %p = getelementptr [64 x float], [64 x float]* @A, i64 0, i64 %j
+  %jt = trunc i64 %j to i32
+  %jm = and i32 %jt, 7
+  %f = sitofp i32 %jm to float
+  store float %f, float* %p
+  %j.next = add i64 %j, 1
+  %ci = icmp ult i64 %j.next, 64
+  br i1 %ci, label %init, label %run
+run:
+  %a = getelementptr [64 x float], [64 x float]* @A, i64 0, i64 0
+  %b = getelementptr [64 x float], [64 x float]* @B, i64 0, i64 0
+  %c = getelementptr [64 x i32], [64 x i32]* @C, i64 0, i64 0
+  call void @k(float* %a, float* %b, i32* %c, i64 3)
+  call void @k(float* %a, float* %b, i32* %c, i64 13)
+  call void @k(float* %a, float* %b, i32* %c, i64 1)
+  br label %sum
+sum:
+  %s = phi float [ 0.0, %run ], [ %s.next, %sum ]
+  %t = phi i32 [ 0, %run ], [ %t.next, %sum ]
+  %m = phi i64 [ 0, %run ], [ %m.next, %sum ]
+  %qb = getelementptr [64 x float], [64 x float]* @B, i64 0, i64 %m
+  %qc = getelementptr [64 x i32], [64 x i32]* @C, i64 0, i64 %m
+  %vb = load float, float* %qb
+  %vc = load i32, i32* %qc
+  %s.next = fadd float %s, %vb
+  %t.next = add i32 %t, %vc
+  %m.next = add i64 %m, 1
+  %cs = icmp ult i64 %m.next, 64
+  br i1 %cs, label %sum, label %done
+done:
+  %r = fptosi float %s.next to i32
+  %r2 = add i32 %r, %t.next
+  %rm = urem i32 %r2, 251
+  %bad = icmp ne i32 %rm, 25
+  %ret = zext i1 %bad to i32
+  ret i32 %ret
+}
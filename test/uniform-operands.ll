@@ -0,0 +1,70 @@
+; Operands that are the same in every lane, or constant in every lane, are
+; not built lane by lane: the constants of the adds become one constant
+; vector, and %k, which the loop does not change, is splatted once in the
+; preheader rather than on every iteration.
+; RUN: %svopt -passes=super-vectorization -mattr=+avx2 -sv-cost-threshold=-1 %s -S -o %t.ll
+; RUN: FileCheck %s < %t.ll
+; RUN: lli %t.ll
+
+; CHECK-LABEL: define i32 @f(
+; CHECK: [[K:%.*]] = mul i32 %n, 3
+; CHECK-NEXT: [[INS:%.*]] = insertelement <4 x i32> poison, i32 [[K]], i32 0
+; CHECK-NEXT: [[SPLAT:%.*]] = shufflevector <4 x i32> [[INS]], <4 x i32> poison, <4 x i32> zeroinitializer
+; CHECK-NEXT: br label
+; CHECK-NOT: insertelement
+; CHECK: [[V:%.*]] = load <4 x i32>
+; CHECK-NEXT: [[W:%.*]] = add <4 x i32> [[V]], <i32 1, i32 2, i32 3, i32 4>
+; CHECK-NEXT: mul <4 x i32> [[W]], [[SPLAT]]
+; CHECK-NOT: insertelement
+; CHECK: ret i32
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@a = global [64 x i32] zeroinitializer
+@c = global [64 x i32] zeroinitializer
+
+define i32 @f(i32 %n) {
+entry:
+  %k = mul i32 %n, 3
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa0 = getelementptr inbounds [64 x i32], [64 x i32]* @a, i64 0, i64 %i
+  %v0 = load i32, i32* %pa0
+  %pa1 = getelementptr inbounds i32, i32* %pa0, i64 1
+  %v1 = load i32, i32* %pa1
+  %pa2 = getelementptr inbounds i32, i32* %pa0, i64 2
+  %v2 = load i32, i32* %pa2
+  %pa3 = getelementptr inbounds i32, i32* %pa0, i64 3
+  %v3 = load i32, i32* %pa3
+  %w0 = add i32 %v0, 1
+  %w1 = add i32 %v1, 2
+  %w2 = add i32 %v2, 3
+  %w3 = add i32 %v3, 4
+  %m0 = mul i32 %w0, %k
+  %m1 = mul i32 %k, %w1
+  %m2 = mul i32 %w2, %k
+  %m3 = mul i32 %k, %w3
+  %pc0 = getelementptr inbounds [64 x i32], [64 x i32]* @c, i64 0, i64 %i
+  store i32 %m0, i32* %pc0
+  %pc1 = getelementptr inbounds i32, i32* %pc0, i64 1
+  store i32 %m1, i32* %pc1
+  %pc2 = getelementptr inbounds i32, i32* %pc0, i64 2
+  store i32 %m2, i32* %pc2
+  %pc3 = getelementptr inbounds i32, i32* %pc0, i64 3
+  store i32 %m3, i32* %pc3
+  %i.next = add i64 %i, 4
+  %done = icmp eq i64 %i.next, 64
+  br i1 %done, label %exit, label %loop
+exit:
+  %p = getelementptr inbounds [64 x i32], [64 x i32]* @c, i64 0, i64 63
+  %r = load i32, i32* %p
+  ret i32 %r
+}
+; c[63] = (a[63] + 4) * 15 = 60
+define i32 @main() {
+  %r = call i32 @f(i32 5)
+  %ok = sub i32 %r, 60
+  ret i32 %ok
+}
@@ -0,0 +1,43 @@
+; Calls of a library function that TargetLibraryInfo maps to a vector
+; library function pack into one call of it at the default cost threshold:
+; the vector call is weighed against a scalar library call per lane.
+; RUN: %svopt -passes=super-vectorization -vector-library=LIBMVEC-X86 %s -S | FileCheck %s --check-prefix=LIBMVEC
+; RUN: %svopt -passes=super-vectorization -vector-library=SVML %s -S | FileCheck %s --check-prefix=SVML
+; RUN: %svopt -passes=super-vectorization %s -S | FileCheck %s --check-prefix=NONE
+
+; LIBMVEC-LABEL: define void @sines(
+; LIBMVEC: call <4 x float> @_ZGVbN4v_sinf(<4 x float>
+; LIBMVEC-NOT: call float @sinf(
+; SVML-LABEL: define void @sines(
+; SVML: call <4 x float> @__svml_sinf4(<4 x float>
+; SVML-NOT: call float @sinf(
+; NONE-LABEL: define void @sines(
+; NONE-COUNT-4: call float @sinf(
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare float @sinf(float)
+
+define void @sines(float* noalias %in, float* noalias %out) {
+entry:
+  %p1 = getelementptr inbounds float, float* %in, i64 1
+  %p2 = getelementptr inbounds float, float* %in, i64 2
+  %p3 = getelementptr inbounds float, float* %in, i64 3
+  %a0 = load float, float* %in, align 4
+  %a1 = load float, float* %p1, align 4
+  %a2 = load float, float* %p2, align 4
+  %a3 = load float, float* %p3, align 4
+  %s0 = call float @sinf(float %a0)
+  %s1 = call float @sinf(float %a1)
+  %s2 = call float @sinf(float %a2)
+  %s3 = call float @sinf(float %a3)
+  %q1 = getelementptr inbounds float, float* %out, i64 1
+  %q2 = getelementptr inbounds float, float* %out, i64 2
+  %q3 = getelementptr inbounds float, float* %out, i64 3
+  store float %s0, float* %out, align 4
+  store float %s1, float* %q1, align 4
+  store float %s2, float* %q2, align 4
+  store float %s3, float* %q3, align 4
+  ret void
+}
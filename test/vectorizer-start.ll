@@ -0,0 +1,30 @@
+; With the plugin loaded, the default -O2 pipeline runs the pass at the
+; vectorizer-start extension point: after the scalar cleanup and before the
+; loop and SLP vectorizers. -sv-enable=false keeps it out of the pipeline.
+; RUN: %svopt -O2 -debug-pass-manager %s -S -o /dev/null 2>&1 | FileCheck %s
+; RUN: %svopt -O2 -sv-enable=false -debug-pass-manager %s -S -o /dev/null 2>&1 | FileCheck %s --check-prefix=DISABLED
+
+; CHECK: Running pass: LowerConstantIntrinsicsPass on f
+; CHECK-NEXT: Running pass: LoopSimplifyPass on f
+; CHECK-NOT: Running pass
+; CHECK: Running pass: {{.*}}SuperVectorizationFunctionPass on f
+; CHECK: Running pass: LoopVectorizePass on f
+; CHECK: Running pass: SLPVectorizerPass on f
+
+; DISABLED: Running pass: LowerConstantIntrinsicsPass on f
+; DISABLED-NOT: SuperVectorization
+; DISABLED: Running pass: LoopVectorizePass on f
+; DISABLED-NOT: SuperVectorization
+
+define void @f(i32* noalias %a, i32* noalias %b) {
+entry:
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %x0 = load i32, i32* %b
+  %x1 = load i32, i32* %b1
+  %y0 = add i32 %x0, 1
+  %y1 = add i32 %x1, 2
+  store i32 %y0, i32* %a
+  store i32 %y1, i32* %a1
+  ret void
+}
@@ -0,0 +1,94 @@
+// Reads a predicated-SSA file and writes it back, or runs the packer on it,
+// so that the format and the packer can be tested without opt.
+//
+//   sv-ssa <file>          write the parsed file back to stdout
+//   sv-ssa -pack <file>    print the packs SLPPacker finds in each function
+
+#include "slpVectorizer.h"
+#include "ssaFormat.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFile(cl::Positional, cl::desc("<predicated-ssa file>"), cl::Required);
+
+static cl::opt<bool> Pack("pack", cl::desc("Print the packs found in each function instead of the file"));
+
+static cl::opt<unsigned> LaneWidth("sv-lane-width", cl::init(4), cl::desc("Maximum number of lanes in a vector pack"));
+
+// One line per pack, in the order of the first lanes in the function: the
+// opcode, the lanes and the memory layout of the pack.
+static void printPacks(Function &F, SSAFunction &function)
+{
+    DenseMap<const Instruction *, unsigned> positions;
+    for (auto &I : instructions(F))
+        positions[&I] = positions.size();
+
+    auto packs = SLPPacker().packInstructions(function, LaneWidth);
+    std::vector<const VectorPack *> ordered;
+    for (auto &pack : packs)
+        ordered.push_back(&pack);
+    std::sort(ordered.begin(), ordered.end(), [&](const VectorPack *a, const VectorPack *b)
+              { return positions.lookup(a->instructions[0]) < positions.lookup(b->instructions[0]); });
+
+    outs() << "function @" << F.getName() << "\n";
+    for (auto *pack : ordered)
+    {
+        outs() << "pack " << pack->instructions[0]->getOpcodeName();
+        // Lanes by name, or by position as in the file when unnamed.
+        for (auto *lane : pack->instructions)
+        {
+            if (lane->hasName())
+                outs() << " %" << lane->getName();
+            else
+                outs() << " i" << positions.lookup(lane);
+        }
+        if (pack->contiguous)
+            outs() << " contiguous";
+        if (pack->stride)
+            outs() << " stride " << pack->stride;
+        if (pack->padded)
+            outs() << " padded";
+        outs() << "\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, argv, "predicated-SSA reader\n");
+
+    auto buffer = MemoryBuffer::getFileOrSTDIN(InputFile);
+    if (!buffer)
+    {
+        errs() << InputFile << ": " << buffer.getError().message() << "\n";
+        return 1;
+    }
+
+    LLVMContext context;
+    std::string error;
+    auto parsed = readPredicatedSSA((*buffer)->getBuffer(), context, error);
+    if (!parsed)
+    {
+        errs() << InputFile << ": " << error << "\n";
+        return 1;
+    }
+
+    if (Pack)
+    {
+        for (auto &[F, function] : parsed->functions)
+            printPacks(*F, *function);
+        return 0;
+    }
+
+    if (!writePredicatedSSA(*parsed->module, parsed->functions, outs(), error))
+    {
+        errs() << InputFile << ": " << error << "\n";
+        return 1;
+    }
+    return 0;
+}